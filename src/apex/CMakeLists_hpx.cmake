@@ -317,6 +317,8 @@ set(apex_headers
     apex_options.hpp
     apex_policies.hpp
     apex_types.h
+    batch_stats.hpp
+    bayesian_search.hpp
     concurrency_handler.hpp
     csv_parser.h
     dependency_tree.hpp
@@ -327,18 +329,29 @@ set(apex_headers
     memory_wrapper.hpp
     policy_handler.hpp
     profile.hpp
+    profile_table.hpp
     profiler.hpp
     profile_reducer.hpp
     profiler_listener.hpp
+    quantile_sketch.hpp
     random.hpp
+    sampling_listener.hpp
     semaphore.hpp
     simulated_annealing.hpp
+    slab_pool.hpp
+    spsc_ring.hpp
+    stop_record.hpp
     thread_instance.hpp
     threadpool.h
+    timer_wheel.hpp
     task_identifier.hpp
     task_wrapper.hpp
     tau_listener.hpp
+    trace_event_binary.hpp
+    trace_file_writer.hpp
     tree.h
+    tuning_database.hpp
+    tuning_window.hpp
     utils.hpp
     ${perfetto_headers}
     ${proc_headers}
@@ -348,6 +361,7 @@ set(apex_headers
 
 set(apex_sources
     apex.cpp
+    apex_clock.cpp
     apex_dynamic.cpp
     apex_error_handling.cpp
     apex_kokkos.cpp
@@ -355,6 +369,7 @@ set(apex_sources
     ${apex_mpi_sources}
     apex_options.cpp
     apex_policies.cpp
+    bayesian_search.cpp
     concurrency_handler.cpp
     csv_parser.cpp
     dependency_tree.cpp
@@ -362,21 +377,24 @@ set(apex_sources
     event_filter.cpp
     exhaustive.cpp
     gzstream.cpp
-    handler.cpp
     memory_wrapper.cpp
     nvtx_listener.cpp
     policy_handler.cpp
     profile_reducer.cpp
     profiler_listener.cpp
     random.cpp
+    sampling_listener.cpp
     simulated_annealing.cpp
     task_identifier.cpp
     tau_listener.cpp
     tau_dummy.cpp
     thread_instance.cpp
     threadpool.cpp
+    timer_wheel.cpp
     trace_event_listener.cpp
+    trace_file_writer.cpp
     tree.cpp
+    tuning_database.cpp
     utils.cpp
     ${perfetto_sources}
     ${proc_sources}
@@ -72,11 +72,13 @@ SET(all_SOURCE
 apex_preload.cpp
 apex_dynamic.cpp
 apex.cpp
+apex_clock.cpp
 apex_error_handling.cpp
 ${APEX_KOKKOS_SOURCE}
 apex_options.cpp
 event_filter.cpp
 apex_policies.cpp
+bayesian_search.cpp
 ${bfd_SOURCE}
 ${OpenACC_SOURCE}
 ${RAJA_SOURCE}
@@ -88,7 +90,6 @@ dependency_tree.cpp
 event_listener.cpp
 exhaustive.cpp
 genetic_search.cpp
-handler.cpp
 memory_wrapper.cpp
 nvtx_listener.cpp
 ${OTF2_SOURCE}
@@ -100,6 +101,7 @@ ${PROC_SOURCE}
 profile_reducer.cpp
 profiler_listener.cpp
 random.cpp
+sampling_listener.cpp
 ${SENSOR_SOURCE}
 simulated_annealing.cpp
 task_identifier.cpp
@@ -107,8 +109,11 @@ ${TCMALLOC_SOURCE}
 ${tau_SOURCE}
 thread_instance.cpp
 threadpool.cpp
+timer_wheel.cpp
 trace_event_listener.cpp
+trace_file_writer.cpp
 tree.cpp
+tuning_database.cpp
 utils.cpp
 ${ZLIB_SOURCE}
 )
@@ -266,18 +271,21 @@ SET(APEX_PUBLIC_HEADERS apex.h
     apex_types.h
     apex_policies.h
     apex_policies.hpp
+    bayesian_search.hpp
     exhaustive.hpp
     dependency_tree.hpp
     genetic_search.hpp
     handler.hpp
     memory_wrapper.hpp
     profile.hpp
+    quantile_sketch.hpp
     random.hpp
     apex_export.h
     utils.hpp
     apex_options.hpp
     profiler.hpp
     simulated_annealing.hpp
+    slab_pool.hpp
     task_wrapper.hpp
     task_identifier.hpp)
 
@@ -7,6 +7,12 @@
  */
 
 #include "address_resolution.hpp"
+#include "thread_instance.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
 #include <sstream>
 #include <iostream>
 #include <unordered_map>
@@ -15,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
 
 #ifdef __APPLE__
 #include <dlfcn.h>
@@ -38,34 +45,11 @@ namespace apex {
   address_resolution * address_resolution::_instance = nullptr;
   shared_mutex_type address_resolution::_bfd_mutex;
 
-  /* Map a function address to a name and/or source location */
-  string * lookup_address(uintptr_t ip_in, bool withFileInfo, bool forceSourceInfo) {
-    address_resolution * ar = address_resolution::instance();
-    static uintptr_t base_addr = ar->getPieOffset();
-    uintptr_t ip = ip_in - base_addr;
-    stringstream location;
-    address_resolution::my_hash_node * node = nullptr;
-    std::unordered_map<uintptr_t, address_resolution::my_hash_node*>::const_iterator it;
-    {
-        read_lock_type l(ar->_bfd_mutex);
-        it = ar->my_hash_table.find(ip);
-    }
-    // address not found? We need to resolve it.
-    if (it == ar->my_hash_table.end()) {
-      // only one thread should resolve it.
-      write_lock_type l(ar->_bfd_mutex);
-      // now that we have the lock, did someone else resolve it?
-      const std::unordered_map<uintptr_t,
-            address_resolution::my_hash_node*>::const_iterator it2 =
-            ar->my_hash_table.find(ip);
-      if (it2 == ar->my_hash_table.end()) {
-        // ...no - so go get it!
-        node = new address_resolution::my_hash_node();
-        node->info.filename = nullptr;
-        node->info.funcname = nullptr;
-        node->info.lineno = 0;
-        node->info.demangled = nullptr;
-        node->location = nullptr;
+  /* Find the function, file and line of an address, the slow way.  This
+   * doesn't touch the hash table, so the caller needs no locks. */
+  static void resolve_info(address_resolution * ar, uintptr_t ip,
+    ApexBfdInfo & info) {
+    APEX_UNUSED(ar);
 #if defined(__APPLE__)
 #if defined(APEX_HAVE_CORESYMBOLICATION)
       static CSSymbolicatorRef symbolicator = CSSymbolicatorCreateWithPid(getpid());
@@ -73,26 +57,29 @@ namespace apex {
       if(CSIsNull(source_info)) {
       } else {
           CSSymbolRef symbol = CSSourceInfoGetSymbol(source_info);
-          node->info.probeAddr = ip;
-          node->info.filename = strdup(CSSourceInfoGetPath(source_info));
-          node->info.funcname = strdup(CSSymbolGetName(symbol));
-          node->info.lineno = CSSourceInfoGetLineNumber(source_info);
+          info.probeAddr = ip;
+          info.filename = strdup(CSSourceInfoGetPath(source_info));
+          info.funcname = strdup(CSSymbolGetName(symbol));
+          info.lineno = CSSourceInfoGetLineNumber(source_info);
       }
       //CSRelease(source_info);
 #else
-      Dl_info info;
-      int rc = dladdr((const void *)ip, &info);
+      Dl_info dl_info;
+      int rc = dladdr((const void *)ip, &dl_info);
       if (rc == 0) {
       } else {
-        node->info.probeAddr = ip;
-        node->info.filename = strdup(info.dli_fname);
-        node->info.funcname = strdup(info.dli_sname);
+        info.probeAddr = ip;
+        info.filename = strdup(dl_info.dli_fname);
+        info.funcname = dl_info.dli_sname ? strdup(dl_info.dli_sname) : nullptr;
         // Apple doesn't give us line numbers.
       }
 #endif
 #else // not __APPLE__
 #ifdef APEX_HAVE_BFD
-        Apex_bfd_resolveBfdInfo(ar->my_bfd_unit_handle, ip, node->info);
+        // libbfd isn't thread safe, even for different objects
+        static std::mutex bfd_resolve_mutex;
+        std::unique_lock<std::mutex> l(bfd_resolve_mutex);
+        Apex_bfd_resolveBfdInfo(ar->my_bfd_unit_handle, ip, info);
 #else
         /*
         void * const buffer[1] = {(void *)ip};
@@ -103,27 +90,33 @@ namespace apex {
 	    for (std::string s; iss >> s; ) {
 		    result.push_back(s);
         }
-        node->info.probeAddr = ip;
-        node->info.filename = strdup("?");
+        info.probeAddr = ip;
+        info.filename = strdup("?");
         if (result.size() > 3) {
-            node->info.funcname = strdup(result[3].c_str());
+            info.funcname = strdup(result[3].c_str());
         } else {
             stringstream ss;
             ss << "UNRESOLVED  ADDR 0x" << hex << ip;
-            node->info.funcname = strdup(ss.str().c_str());
+            info.funcname = strdup(ss.str().c_str());
         }
         */
-        Dl_info info;
-        int rc = dladdr((const void *)ip, &info);
+        Dl_info dl_info;
+        int rc = dladdr((const void *)ip, &dl_info);
         if (rc == 0) {
         } else {
-            node->info.probeAddr = ip;
-            node->info.filename = strdup(info.dli_fname);
-            node->info.funcname = strdup(info.dli_sname);
+            info.probeAddr = ip;
+            info.filename = strdup(dl_info.dli_fname);
+            info.funcname = dl_info.dli_sname ? strdup(dl_info.dli_sname) : nullptr;
         }
 #endif // no APEX_HAVE_BFD
 #endif // no __APPLE__
-        if (node->info.filename == nullptr) {
+  }
+
+  /* Fill in what we couldn't resolve, and format the location */
+  static void finish_node(address_resolution::my_hash_node * node,
+    uintptr_t ip, bool forceSourceInfo) {
+        stringstream location;
+        if (node->info.filename == nullptr || node->info.funcname == nullptr) {
             stringstream ss;
             ss << "UNRESOLVED  ADDR 0x" << hex << ip;
             node->info.funcname = strdup(ss.str().c_str());
@@ -156,15 +149,78 @@ namespace apex {
             }
         }
         node->location = new string(location.str());
-        ar->my_hash_table[ip] = node;
+        if (node->info.demangled && (strlen(node->info.demangled) == 0)) {
+            node->info.demangled = nullptr;
+        }
+  }
+
+  static address_resolution::my_hash_node * new_node(void) {
+        address_resolution::my_hash_node * node =
+            new address_resolution::my_hash_node();
+        node->info.filename = nullptr;
+        node->info.funcname = nullptr;
+        node->info.lineno = 0;
+        node->info.demangled = nullptr;
+        node->location = nullptr;
+        return node;
+  }
+
+  /* The loaded object that contains an address, and the offset of the
+   * address in it - which doesn't change from run to run, like the
+   * address itself does. */
+  static bool object_of(uintptr_t ip, std::string & object,
+    uintptr_t & offset) {
+      Dl_info dl_info;
+      if (dladdr((const void *)ip, &dl_info) == 0 ||
+          dl_info.dli_fname == nullptr || dl_info.dli_fname[0] == '\0') {
+          return false;
+      }
+      char path[PATH_MAX];
+      if (realpath(dl_info.dli_fname, path) != nullptr) {
+          object.assign(path);
       } else {
-        node = it2->second;
+          object.assign(dl_info.dli_fname);
       }
-    } else {
-      node = it->second;
+      offset = ip - (uintptr_t)(dl_info.dli_fbase);
+      return true;
+  }
+
+  /* Map a function address to a name and/or source location */
+  string * lookup_address(uintptr_t ip_in, bool withFileInfo, bool forceSourceInfo) {
+    address_resolution * ar = address_resolution::instance();
+    static uintptr_t base_addr = ar->getPieOffset();
+    uintptr_t ip = ip_in - base_addr;
+    address_resolution::my_hash_node * node = nullptr;
+    {
+        read_lock_type l(ar->_bfd_mutex);
+        auto it = ar->my_hash_table.find(ip);
+        if (it != ar->my_hash_table.end()) {
+            node = it->second;
+        }
     }
-    if (node->info.demangled && (strlen(node->info.demangled) == 0)) {
-        node->info.demangled = nullptr;
+    // address not found? We need to resolve it.
+    if (node == nullptr) {
+      std::string object;
+      uintptr_t offset{0};
+      bool cacheable = object_of(ip_in, object, offset);
+      // only one thread should resolve it.
+      write_lock_type l(ar->_bfd_mutex);
+      // now that we have the lock, did someone else resolve it?
+      auto it = ar->my_hash_table.find(ip);
+      if (it == ar->my_hash_table.end()) {
+        // ...no - so check the symbol cache, or go get it!
+        node = new_node();
+        if (!cacheable || !ar->find_cached(object, offset, node->info)) {
+            resolve_info(ar, ip, node->info);
+            if (cacheable) {
+                ar->add_cached(object, offset, node->info);
+            }
+        }
+        finish_node(node, ip, forceSourceInfo);
+        ar->my_hash_table[ip] = node;
+      } else {
+        node = it->second;
+      }
     }
     if (withFileInfo) {
       return node->location;
@@ -173,6 +229,230 @@ namespace apex {
     }
   }
 
+  /* Resolve a batch of addresses, so that looking them up afterwards is
+   * quick.  The addresses that aren't in the hash table or the symbol cache
+   * are grouped by the object that contains them, and resolved one object
+   * at a time, in address order.  The lookups all hold the BFD lock (and
+   * dladdr() the loader's), so this thread does them itself. */
+  void resolve_addresses(std::vector<uintptr_t> addresses) {
+    in_apex prevent_memory_tracking;
+    address_resolution * ar = address_resolution::instance();
+    static uintptr_t base_addr = ar->getPieOffset();
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()),
+        addresses.end());
+    class pending {
+    public:
+        uintptr_t ip;
+        uintptr_t offset;
+        bool cacheable;
+        address_resolution::my_hash_node * node;
+    };
+    // find the objects first, without holding the lock
+    std::map<std::string, std::vector<pending>> objects;
+    for (auto ip_in : addresses) {
+        std::string object;
+        pending p{ip_in - base_addr, 0, false, nullptr};
+        p.cacheable = object_of(ip_in, object, p.offset);
+        objects[object].push_back(p);
+    }
+    size_t remaining = 0;
+    {
+        write_lock_type l(ar->_bfd_mutex);
+        for (auto& o : objects) {
+            auto& group = o.second;
+            auto keep = std::remove_if(group.begin(), group.end(),
+                [&](pending& p) {
+                    if (ar->my_hash_table.count(p.ip) > 0) { return true; }
+                    if (!p.cacheable) { return false; }
+                    address_resolution::my_hash_node * node = new_node();
+                    if (!ar->find_cached(o.first, p.offset, node->info)) {
+                        delete node;
+                        return false;
+                    }
+                    finish_node(node, p.ip, false);
+                    ar->my_hash_table[p.ip] = node;
+                    return true;
+                });
+            group.erase(keep, group.end());
+            remaining += group.size();
+        }
+    }
+    if (remaining == 0) { return; }
+    for (auto& o : objects) {
+        for (auto& p : o.second) {
+            p.node = new_node();
+            resolve_info(ar, p.ip, p.node->info);
+        }
+    }
+    write_lock_type l(ar->_bfd_mutex);
+    for (auto& o : objects) {
+        for (auto& p : o.second) {
+            // another thread might have looked it up in the meantime
+            if (ar->my_hash_table.count(p.ip) > 0) {
+                delete p.node;
+                continue;
+            }
+            if (p.cacheable) {
+                ar->add_cached(o.first, p.offset, p.node->info);
+            }
+            finish_node(p.node, p.ip, false);
+            ar->my_hash_table[p.ip] = p.node;
+        }
+    }
+  }
+
+  std::string address_resolution::cache_filename(void) {
+      std::string program("apex");
+      const char * path = thread_instance::program_path();
+      if (path != nullptr) {
+          program.assign(path);
+          size_t slash = program.find_last_of("/\\");
+          if (slash != std::string::npos) { program.erase(0, slash + 1); }
+      }
+      std::stringstream filename;
+      if (strlen(apex_options::symbol_cache_path()) > 0) {
+          filename << apex_options::symbol_cache_path();
+      } else {
+          filename << apex_options::output_file_path();
+      }
+      filename << filesystem_separator() << "apex_symbols." << program
+               << ".cache";
+      return filename.str();
+  }
+
+  static std::vector<std::string> split_fields(const std::string& line) {
+      std::vector<std::string> fields;
+      size_t start = 0;
+      size_t tab;
+      while ((tab = line.find('\t', start)) != std::string::npos) {
+          fields.push_back(line.substr(start, tab - start));
+          start = tab + 1;
+      }
+      fields.push_back(line.substr(start));
+      return fields;
+  }
+
+  /* The cache file has a section for each object, which is only used if
+   * the object hasn't changed since:
+   *   object <tab> mtime <tab> size <tab> path
+   *   offset (hex) <tab> line <tab> file <tab> function <tab> demangled
+   */
+  void address_resolution::load_cache(void) {
+      cache_loaded = true;
+      if (!apex_options::use_symbol_cache()) { return; }
+      std::ifstream in(cache_filename());
+      std::string line;
+      std::unordered_map<uintptr_t, cached_symbol> * symbols = nullptr;
+      while (std::getline(in, line)) {
+          if (line.empty() || line[0] == '#') { continue; }
+          std::vector<std::string> fields = split_fields(line);
+          if (fields[0] == "object") {
+              symbols = nullptr;
+              struct stat st;
+              if (fields.size() == 4 &&
+                  stat(fields[3].c_str(), &st) == 0 &&
+                  std::to_string((long long)(st.st_mtime)) == fields[1] &&
+                  std::to_string((long long)(st.st_size)) == fields[2]) {
+                  symbols = &(symbol_cache[fields[3]]);
+              }
+              continue;
+          }
+          if (symbols == nullptr || fields.size() != 5) { continue; }
+          // skip lines that were damaged, rather than trust them
+          char * end = nullptr;
+          errno = 0;
+          unsigned long long offset = strtoull(fields[0].c_str(), &end, 16);
+          if (errno != 0 || end == fields[0].c_str() || *end != '\0') {
+              continue;
+          }
+          long lineno = strtol(fields[1].c_str(), &end, 10);
+          if (end == fields[1].c_str() || *end != '\0' ||
+              lineno < 0 || lineno > INT_MAX) {
+              continue;
+          }
+          cached_symbol& s = (*symbols)[(uintptr_t)(offset)];
+          s.lineno = (int)(lineno);
+          s.filename = fields[2];
+          s.funcname = fields[3];
+          s.demangled = fields[4];
+      }
+  }
+
+  bool address_resolution::find_cached(const std::string& object,
+      uintptr_t offset, ApexBfdInfo & info) {
+      if (!cache_loaded) { load_cache(); }
+      auto o = symbol_cache.find(object);
+      if (o == symbol_cache.end()) { return false; }
+      auto s = o->second.find(offset);
+      if (s == o->second.end()) { return false; }
+      const cached_symbol& symbol = s->second;
+      info.lineno = symbol.lineno;
+      info.filename = symbol.filename.empty() ? nullptr :
+          strdup(symbol.filename.c_str());
+      info.funcname = symbol.funcname.empty() ? nullptr :
+          strdup(symbol.funcname.c_str());
+      info.demangled = symbol.demangled.empty() ? nullptr :
+          strdup(symbol.demangled.c_str());
+      return true;
+  }
+
+  void address_resolution::add_cached(const std::string& object,
+      uintptr_t offset, const ApexBfdInfo & info) {
+      if (!apex_options::use_symbol_cache()) { return; }
+      // tabs and newlines separate the fields and the lines
+      auto field = [](const char * value) {
+          std::string tmp(value == nullptr ? "" : value);
+          std::replace(tmp.begin(), tmp.end(), '\t', ' ');
+          std::replace(tmp.begin(), tmp.end(), '\n', ' ');
+          return tmp;
+      };
+      cached_symbol& s = symbol_cache[object][offset];
+      s.lineno = info.lineno;
+      s.filename = field(info.filename);
+      s.funcname = field(info.funcname);
+      s.demangled = field(info.demangled);
+      cache_dirty = true;
+  }
+
+  /* Write the cache to a temporary file, and rename it, so that other
+   * processes never read half of it.  When several processes write it,
+   * the last one wins. */
+  void address_resolution::save_cache(void) {
+      if (!cache_dirty || !apex_options::use_symbol_cache()) { return; }
+      std::string filename(cache_filename());
+      // ranks on other hosts can write the same file
+      char host[256] = {0};
+      gethostname(host, sizeof(host) - 1);
+      std::stringstream tmpname;
+      tmpname << filename << ".tmp." << host << "." << getpid();
+      std::ofstream out(tmpname.str());
+      out << "# APEX symbol cache" << std::endl;
+      for (auto& o : symbol_cache) {
+          struct stat st;
+          if (stat(o.first.c_str(), &st) != 0) { continue; }
+          out << "object\t" << (long long)(st.st_mtime) << "\t"
+              << (long long)(st.st_size) << "\t" << o.first << "\n";
+          for (auto& s : o.second) {
+              out << std::hex << s.first << std::dec << "\t"
+                  << s.second.lineno << "\t" << s.second.filename << "\t"
+                  << s.second.funcname << "\t" << s.second.demangled << "\n";
+          }
+      }
+      out.close();
+      if (out.fail() || rename(tmpname.str().c_str(), filename.c_str()) != 0) {
+          remove(tmpname.str().c_str());
+          return;
+      }
+      cache_dirty = false;
+  }
+
+  void address_resolution::save_symbol_cache(void) {
+      if (_instance == nullptr) { return; }
+      write_lock_type l(_bfd_mutex);
+      _instance->save_cache();
+  }
+
     // gives us the -pie offset in the executable.
     uintptr_t address_resolution::getPieOffset() {
 #if defined(__APPLE__)
@@ -23,6 +23,7 @@
 #include <mutex>
 #include "apex_cxx_shared_lock.hpp"
 #include <unordered_map>
+#include <vector>
 
 namespace apex {
 
@@ -33,11 +34,28 @@ namespace apex {
 #ifdef APEX_HAVE_BFD
           my_bfd_unit_handle = Apex_bfd_registerUnit();
 #endif
+          cache_loaded = false;
+          cache_dirty = false;
         };
         // copy constructor is private
         address_resolution(address_resolution const&);
         // assignment operator is private
         address_resolution& operator=(address_resolution const& a);
+        /* A resolved symbol, as kept in the persistent symbol cache */
+        class cached_symbol {
+          public:
+            int lineno;
+            std::string filename;
+            std::string funcname;
+            std::string demangled;
+        };
+        // symbols by object path, then by offset in the object
+        std::unordered_map<std::string,
+            std::unordered_map<uintptr_t, cached_symbol>> symbol_cache;
+        bool cache_loaded;
+        bool cache_dirty;
+        void load_cache(void);
+        void save_cache(void);
       public:
         uintptr_t getPieOffset();
         static shared_mutex_type _bfd_mutex;
@@ -60,9 +78,19 @@ namespace apex {
           }
           return _instance;
       }
+      /* The caller has to hold the write lock */
+      bool find_cached(const std::string& object, uintptr_t offset,
+          ApexBfdInfo & info);
+      void add_cached(const std::string& object, uintptr_t offset,
+          const ApexBfdInfo & info);
+      /* Write the symbols we resolved to the cache file, for the next run */
+      static void save_symbol_cache(void);
+      /* The symbol cache file of this program */
+      static std::string cache_filename(void);
       static void delete_instance() {
           disable_memory_wrapper();
           delete(_instance);
+          _instance = nullptr;
       }
       ~address_resolution(void) {
         // call apex::finalize() just in case!
@@ -86,6 +114,8 @@ namespace apex {
   };
 
   std::string * lookup_address(uintptr_t ip, bool withFileInfo, bool forceSourceInfo = false);
+  /* Resolve many addresses at once, before looking them up one at a time */
+  void resolve_addresses(std::vector<uintptr_t> addresses);
 
 }
 
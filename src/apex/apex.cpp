@@ -27,6 +27,7 @@
 #include <atomic>
 #include <set>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #if APEX_WITH_PLUGINS
 #include <dlfcn.h>
@@ -39,11 +40,13 @@
 #include "utils.hpp"
 #include "apex_assert.h"
 #include "event_filter.hpp"
+#include "slab_pool.hpp"
 
 #include "tau_listener.hpp"
 #include "profiler_listener.hpp"
 #include "nvtx_listener.hpp"
 #include "trace_event_listener.hpp"
+#include "sampling_listener.hpp"
 #if defined(APEX_WITH_PERFETTO)
 #include "perfetto_listener.hpp"
 #endif
@@ -145,6 +148,10 @@ apex::~apex()
         listeners.pop_back();
         delete el;
     }
+    for (auto table : m_old_listener_tables) {
+        delete table;
+    }
+    delete m_listener_table.load();
 #if APEX_HAVE_PROC
     if (pd_reader != nullptr) {
         delete pd_reader;
@@ -347,7 +354,6 @@ void apex::_initialize()
         tau_loaded = tau_listener::initialize_tau(argc, argv);
     }
     {
-        //write_lock_type l(listener_mutex);
         this->the_profiler_listener = new profiler_listener();
         // this is always the first listener!
         listeners.push_back(the_profiler_listener);
@@ -375,6 +381,9 @@ void apex::_initialize()
             the_trace_event_listener = new trace_event_listener();
             listeners.push_back(the_trace_event_listener);
         }
+        if (apex_options::sampling_period() > 0) {
+            listeners.push_back(new sampling_listener());
+        }
 
 /* For the Jupyter support, always enable the concurrency handler. */
         if (apex_options::use_jupyter_support() ||
@@ -390,6 +399,7 @@ void apex::_initialize()
             this->m_policy_handler = new policy_handler();
             listeners.push_back(this->m_policy_handler);
         }
+        update_listeners();
     }
     this->resize_state(1);
     this->set_state(0, APEX_BUSY);
@@ -438,12 +448,47 @@ policy_handler * apex::get_policy_handler(uint64_t const& period)
     if(apex_options::use_policy() && period_handlers.count(period) == 0)
     {
         period_handlers[period] = new policy_handler(period);
-        //write_lock_type l(listener_mutex);
-        listeners.push_back(period_handlers[period]);
+        add_listener(period_handlers[period]);
     }
     return period_handlers[period];
 }
 
+void apex::add_listener(event_listener * listener)
+{
+    std::unique_lock<std::mutex> l(m_listener_table_mutex);
+    listeners.push_back(listener);
+    // publish the new table
+    l.unlock();
+    update_listeners();
+}
+
+void apex::update_listeners(void)
+{
+    std::unique_lock<std::mutex> l(m_listener_table_mutex);
+    listener_table * current = m_listener_table.load();
+    std::vector<listener_mask> masks;
+    masks.reserve(listeners.size());
+    for (auto listener : listeners) {
+        masks.push_back(listener->subscriptions());
+    }
+    // nothing changed, keep the current table
+    if (masks == current->masks) { return; }
+    listener_table * table = new listener_table();
+    table->masks = masks;
+    for (size_t i = 0 ; i < listeners.size() ; i++) {
+        for (int e = 0 ; e < NUM_LISTENER_EVENTS ; e++) {
+            if (masks[i] & APEX_LISTEN(e)) {
+                table->subscribers[e].push_back(listeners[i]);
+            }
+        }
+    }
+    m_listener_table.store(table, std::memory_order_release);
+    /* Other threads may still be dispatching events with the old table,
+     * so keep it until we are destroyed.  Subscriptions rarely change,
+     * so there aren't many of them. */
+    m_old_listener_tables.push_back(current);
+}
+
 #ifdef APEX_HAVE_HPX
 void apex::set_hpx_runtime(hpx::runtime * hpx_runtime) {
     m_hpx_runtime = hpx_runtime;
@@ -488,6 +533,9 @@ uint64_t init(const char * thread_name, uint64_t comm_rank,
     }
     /* register the finalization function, for program exit */
     std::atexit(do_atexit);
+    /* select the clock before anything is timed */
+    our_clock::set_source(apex_options::clock_source(),
+        apex_options::use_verbose());
     //thread_instance::set_worker(true);
     _registered = true;
     apex* instance = apex::instance(); // get/create the Apex static instance
@@ -506,9 +554,8 @@ uint64_t init(const char * thread_name, uint64_t comm_rank,
     init_plugins();
     startup_event_data data(comm_rank, comm_size);
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_startup(data);
+        for (auto listener : instance->subscribers(LISTEN_STARTUP)) {
+            listener->on_startup(data);
         }
     }
     handle_delayed_start();
@@ -573,9 +620,8 @@ uint64_t init(const char * thread_name, uint64_t comm_rank,
     // this code should be absorbed from "new node" event to "on_startup" event.
     node_event_data node_data(comm_rank, thread_instance::get_id());
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_new_node(node_data);
+        for (auto listener : instance->subscribers(LISTEN_NEW_NODE)) {
+            listener->on_new_node(node_data);
         }
     }
 #ifdef APEX_HAVE_TCMALLOC
@@ -595,6 +641,7 @@ uint64_t init(const char * thread_name, uint64_t comm_rank,
         }
         controlMemoryWrapper(true);
     }
+    start_heap_snapshots();
 
     // It's now safe to initialize CUDA and/or HIP and/or Level0
     dynamic::cuda::init();
@@ -626,6 +673,13 @@ string& version() {
     return instance->version_string;
 }
 
+/* Wrap a profiler in a shared pointer for the listeners.  The control
+ * block comes from the same per-thread pools as the profiler. */
+inline std::shared_ptr<profiler> _share_profiler(profiler * p) {
+    return std::shared_ptr<profiler>(p, std::default_delete<profiler>(),
+        pool_allocator<profiler>());
+}
+
 /* Populate the new task_wrapper object, and notify listeners. */
 inline std::shared_ptr<task_wrapper> _new_task(
     task_identifier * id,
@@ -633,7 +687,8 @@ inline std::shared_ptr<task_wrapper> _new_task(
     const std::shared_ptr<task_wrapper> parent_task, apex* instance) {
     in_apex prevent_deadlocks;
     APEX_UNUSED(instance);
-    std::shared_ptr<task_wrapper> tt_ptr = make_shared<task_wrapper>();
+    std::shared_ptr<task_wrapper> tt_ptr =
+        std::allocate_shared<task_wrapper>(pool_allocator<task_wrapper>());
     tt_ptr->task_id = id;
     // get the thread id that is creating this task
     tt_ptr->thread_id = thread_instance::instance().get_id();
@@ -727,17 +782,16 @@ profiler* start(const std::string &timer_name)
         if (apex_options::use_verbose()) { debug_print("Start", tt_ptr); }
 #endif
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
-        //read_lock_type l(instance->listener_mutex);
         /*
         std::stringstream dbg;
         dbg << thread_instance::get_id() << " Start : " << id->get_name() << endl;
             printf("%s\n",dbg.str().c_str());
         fflush(stdout);
         */
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
+        for (auto listener : instance->subscribers(LISTEN_START)) {
+            success = listener->on_start(tt_ptr);
             tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
+            if (!success && listener == instance->the_profiler_listener) {
                 //cout << thread_instance::get_id() << " *** Not success! " <<
                 //id->get_name() << endl; fflush(stdout);
                 APEX_UTIL_REF_COUNT_FAILED_START
@@ -798,11 +852,10 @@ profiler* start(const apex_function_address function_address) {
             printf("%s\n",dbg.str().c_str());
         fflush(stdout);
         */
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
+        for (auto listener : instance->subscribers(LISTEN_START)) {
+            success = listener->on_start(tt_ptr);
             tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
+            if (!success && listener == instance->the_profiler_listener) {
                 //cout << thread_instance::get_id() << " *** Not success! " <<
                 //id->get_name() << endl; fflush(stdout);
                 APEX_UTIL_REF_COUNT_FAILED_START
@@ -838,7 +891,7 @@ void start(std::shared_ptr<task_wrapper> tt_ptr) {
         return;
     }
     // don't time filtered events
-    if (event_filter::instance().have_filter && event_filter::exclude(tt_ptr->task_id->get_name())) {
+    if (event_filter::instance().have_filter && event_filter::exclude(tt_ptr->task_id)) {
         tt_ptr->prof = nullptr;
         return;
     }
@@ -865,11 +918,10 @@ void start(std::shared_ptr<task_wrapper> tt_ptr) {
         printf("%s\n",dbg.str().c_str());
         fflush(stdout);
         */
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            success = instance->listeners[i]->on_start(tt_ptr);
+        for (auto listener : instance->subscribers(LISTEN_START)) {
+            success = listener->on_start(tt_ptr);
             tt_ptr->prof = thread_instance::instance().get_current_profiler();
-            if (!success && i == 0) {
+            if (!success && listener == instance->the_profiler_listener) {
                 //cout << thread_instance::get_id() << " *** Not success! " <<
                 //id->get_name() << endl; fflush(stdout);
                 APEX_UTIL_REF_COUNT_FAILED_START
@@ -920,9 +972,8 @@ profiler* resume(const std::string &timer_name) {
         tt_ptr = _new_task(id, UINTMAX_MAX, null_task_wrapper, instance);
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
         try {
-            //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(tt_ptr);
+            for (auto listener : instance->subscribers(LISTEN_RESUME)) {
+                listener->on_resume(tt_ptr);
             }
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
@@ -964,9 +1015,8 @@ profiler* resume(const apex_function_address function_address) {
         tt_ptr = _new_task(id, UINTMAX_MAX, null_task_wrapper, instance);
         APEX_UTIL_REF_COUNT_TASK_WRAPPER
         try {
-            //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(tt_ptr);
+            for (auto listener : instance->subscribers(LISTEN_RESUME)) {
+                listener->on_resume(tt_ptr);
             }
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
@@ -1004,8 +1054,9 @@ profiler* resume(profiler * p) {
         try {
             // skip the profiler_listener - we are restoring a child timer
             // for a parent that was yielded.
-            for (unsigned int i = 1 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_resume(p->tt_ptr);
+            for (auto listener : instance->subscribers(LISTEN_RESUME)) {
+                if (listener == instance->the_profiler_listener) { continue; }
+                listener->on_resume(p->tt_ptr);
             }
         } catch (disabled_profiler_exception &e) {
             APEX_UTIL_REF_COUNT_FAILED_RESUME
@@ -1033,8 +1084,8 @@ void reset(const std::string &timer_name) {
     task_identifier * id = task_identifier::get_task_id(timer_name);
     //instance->the_profiler_listener->reset(id);
     if (_notify_listeners) {
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_reset(id);
+        for (auto listener : instance->subscribers(LISTEN_RESET)) {
+            listener->on_reset(id);
         }
     }
 }
@@ -1051,8 +1102,8 @@ void reset(apex_function_address function_address) {
     }
     //instance->the_profiler_listener->reset(id);
     if (_notify_listeners) {
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_reset(id);
+        for (auto listener : instance->subscribers(LISTEN_RESET)) {
+            listener->on_reset(id);
         }
     }
 }
@@ -1068,8 +1119,8 @@ void set_state(apex_thread_state state) {
 void apex::complete_task(std::shared_ptr<task_wrapper> task_wrapper_ptr) {
     apex* instance = apex::instance(); // get the Apex static instance
     if (_notify_listeners) {
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_task_complete(task_wrapper_ptr);
+        for (auto listener : instance->subscribers(LISTEN_TASK_COMPLETE)) {
+            listener->on_task_complete(task_wrapper_ptr);
         }
     }
 }
@@ -1102,11 +1153,10 @@ void apex::stop_internal(profiler* the_profiler) {
         APEX_UTIL_REF_COUNT_STOP_AFTER_FINALIZE
         return;
     }
-    std::shared_ptr<profiler> p{the_profiler};
+    std::shared_ptr<profiler> p{_share_profiler(the_profiler)};
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
+        for (auto listener : instance->subscribers(LISTEN_STOP)) {
+            listener->on_stop(p);
         }
     }
 #if defined(APEX_DEBUG)
@@ -1157,11 +1207,10 @@ void stop(profiler* the_profiler, bool cleanup) {
         APEX_UTIL_REF_COUNT_STOP_AFTER_FINALIZE
         return;
     }
-    std::shared_ptr<profiler> p{the_profiler};
+    std::shared_ptr<profiler> p{_share_profiler(the_profiler)};
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
+        for (auto listener : instance->subscribers(LISTEN_STOP)) {
+            listener->on_stop(p);
         }
     }
     /*
@@ -1223,11 +1272,10 @@ void stop(std::shared_ptr<task_wrapper> tt_ptr) {
         APEX_UTIL_REF_COUNT_STOP_AFTER_FINALIZE
         return;
     }
-    std::shared_ptr<profiler> p{tt_ptr->prof};
+    std::shared_ptr<profiler> p{_share_profiler(tt_ptr->prof)};
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_stop(p);
+        for (auto listener : instance->subscribers(LISTEN_STOP)) {
+            listener->on_stop(p);
         }
     }
     /*
@@ -1277,11 +1325,10 @@ void yield(profiler* the_profiler)
     }
     thread_instance::instance().clear_current_profiler(the_profiler, false,
         null_task_wrapper);
-    std::shared_ptr<profiler> p{the_profiler};
+    std::shared_ptr<profiler> p{_share_profiler(the_profiler)};
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_yield(p);
+        for (auto listener : instance->subscribers(LISTEN_YIELD)) {
+            listener->on_yield(p);
         }
     }
     //cout << thread_instance::get_id() << " Yield : " <<
@@ -1328,11 +1375,10 @@ void yield(std::shared_ptr<task_wrapper> tt_ptr)
     }
     thread_instance::instance().clear_current_profiler(tt_ptr->prof,
         true, tt_ptr);
-    std::shared_ptr<profiler> p{tt_ptr->prof};
+    std::shared_ptr<profiler> p{_share_profiler(tt_ptr->prof)};
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_yield(p);
+        for (auto listener : instance->subscribers(LISTEN_YIELD)) {
+            listener->on_yield(p);
         }
     }
     //cout << thread_instance::get_id() << " Yield : " <<
@@ -1349,23 +1395,13 @@ void yield(std::shared_ptr<task_wrapper> tt_ptr)
     tt_ptr->prof = nullptr;
 }
 
-void sample_value(const std::string &name, double value, bool threaded)
-{
-    in_apex prevent_deadlocks;
-    // check these before checking the options, because if we have already
-    // cleaned up, checking the options can cause deadlock. This can
-    // happen if we are tracking memory.
-    if (_exited || _measurement_stopped) return; // protect against calls after finalization
-    // if APEX is disabled, do nothing.
-    if (apex_options::disable() == true) { return; }
-    // if APEX is suspended, do nothing.
-    if (apex_options::suspend() == true) { return; }
-    apex* instance = apex::instance(); // get the Apex static instance
-    if (!instance) return; // protect against calls after finalization
-    // parse the counter name
-    // either /threadqueue{locality#0/total}/length
-    // or     /threadqueue{locality#0/worker-thread#0}/length
-    int tid = 0;
+/* Counter names of the form
+ *   /threadqueue{locality#0/worker-thread#0}/length
+ * are sampled as a value of that worker thread, everything else as a
+ * value of thread 0.  Returns the name of the worker thread, if any. */
+static std::string counter_thread_name(apex* instance,
+    const std::string &name) {
+    std::string thread_name;
     if (name.find(instance->m_my_locality) != name.npos)
     {
         if (name.find("worker-thread") != name.npos)
@@ -1380,18 +1416,125 @@ void sample_value(const std::string &name, double value, bool threaded)
             if (token != nullptr) {
               // strip the trailing close bracket
               token = strtok(token, "}");
-              tid = thread_instance::map_name_to_id(token);
-            }
-            if (tid == -1) {
-                tid = 0;
+              if (token != nullptr) { thread_name = token; }
             }
         }
     }
+    return thread_name;
+}
+
+static int counter_thread_id(apex* instance, const std::string &name) {
+    std::string thread_name = counter_thread_name(instance, name);
+    if (thread_name.empty()) { return 0; }
+    int tid = thread_instance::map_name_to_id(thread_name);
+    return tid == -1 ? 0 : tid;
+}
+
+void sample_value(const std::string &name, double value, bool threaded)
+{
+    in_apex prevent_deadlocks;
+    // check these before checking the options, because if we have already
+    // cleaned up, checking the options can cause deadlock. This can
+    // happen if we are tracking memory.
+    if (_exited || _measurement_stopped) return; // protect against calls after finalization
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return; }
+    // if APEX is suspended, do nothing.
+    if (apex_options::suspend() == true) { return; }
+    apex* instance = apex::instance(); // get the Apex static instance
+    if (!instance) return; // protect against calls after finalization
+    // parse the counter name
+    int tid = counter_thread_id(instance, name);
     sample_value_event_data data(tid, name, value, threaded);
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_sample_value(data);
+        for (auto listener : instance->subscribers(LISTEN_SAMPLE_VALUE)) {
+            listener->on_sample_value(data);
+        }
+    }
+}
+
+/* The registered counters.  The name is parsed and interned once, when
+ * the counter is registered.  The entries are stored in chunks that are
+ * never moved or freed, so sampling a handle doesn't take a lock. */
+class registered_counter {
+public:
+    std::string name;
+    task_identifier * id;
+    // the worker thread in the name, which might not be registered yet
+    std::string thread_name;
+    std::atomic<int> tid; // -1 until the thread is found
+};
+
+static constexpr size_t counter_chunk_size = 1024;
+static constexpr size_t max_counter_chunks = 1024;
+static std::atomic<registered_counter*> counter_chunks[max_counter_chunks];
+
+apex_counter_handle register_counter(const std::string &name)
+{
+    in_apex prevent_deadlocks;
+    static std::mutex counter_mutex;
+    static std::unordered_map<std::string, apex_counter_handle> handles;
+    std::unique_lock<std::mutex> lock(counter_mutex);
+    auto got = handles.find(name);
+    if (got != handles.end()) {
+        return got->second;
+    }
+    apex_counter_handle handle = handles.size();
+    size_t chunk = handle / counter_chunk_size;
+    if (chunk >= max_counter_chunks) {
+        std::cerr << "APEX: too many registered counters, "
+                  << "can't register " << name << std::endl;
+        return UINT32_MAX;
+    }
+    registered_counter * entries = counter_chunks[chunk].load();
+    if (entries == nullptr) {
+        entries = new registered_counter[counter_chunk_size];
+    }
+    registered_counter& entry = entries[handle % counter_chunk_size];
+    entry.name = name;
+    entry.id = task_identifier::get_task_id(name);
+    apex* instance = apex::instance();
+    if (instance != nullptr) {
+        entry.thread_name = counter_thread_name(instance, name);
+    }
+    entry.tid = entry.thread_name.empty() ? 0 : -1;
+    // publish the entry, before the handle is returned
+    counter_chunks[chunk].store(entries, std::memory_order_release);
+    handles[name] = handle;
+    return handle;
+}
+
+void sample_value(apex_counter_handle handle, double value, bool threaded)
+{
+    in_apex prevent_deadlocks;
+    if (_exited || _measurement_stopped) return; // protect against calls after finalization
+    // if APEX is disabled, do nothing.
+    if (apex_options::disable() == true) { return; }
+    // if APEX is suspended, do nothing.
+    if (apex_options::suspend() == true) { return; }
+    apex* instance = apex::instance(); // get the Apex static instance
+    if (!instance) return; // protect against calls after finalization
+    size_t chunk = handle / counter_chunk_size;
+    if (chunk >= max_counter_chunks) { return; }
+    registered_counter * entries =
+        counter_chunks[chunk].load(std::memory_order_acquire);
+    if (entries == nullptr) { return; }
+    registered_counter& entry = entries[handle % counter_chunk_size];
+    int tid = entry.tid.load(std::memory_order_relaxed);
+    if (tid == -1) {
+        // the thread is looked up until it has been registered
+        tid = thread_instance::map_name_to_id(entry.thread_name);
+        if (tid == -1) {
+            tid = 0;
+        } else {
+            entry.tid.store(tid, std::memory_order_relaxed);
+        }
+    }
+    sample_value_event_data data(tid, &entry.name, entry.id, value,
+        threaded);
+    if (_notify_listeners) {
+        for (auto listener : instance->subscribers(LISTEN_SAMPLE_VALUE)) {
+            listener->on_sample_value(data);
         }
     }
 }
@@ -1568,9 +1711,8 @@ void custom_event(apex_event_type event_type, void * custom_data) {
     if (!instance || _exited) { return; }
     custom_event_data data(event_type, custom_data);
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_custom_event(data);
+        for (auto listener : instance->subscribers(LISTEN_CUSTOM_EVENT)) {
+            listener->on_custom_event(data);
         }
     }
 }
@@ -1703,12 +1845,14 @@ std::string dump(bool reset, bool finalizing) {
         }
         controlMemoryWrapper(true);
     }
+    our_clock::check_drift(apex_options::use_verbose() &&
+        instance->get_node_id() == 0);
     if (_notify_listeners) {
         //apex_get_leak_symbols();
         dump_event_data data(instance->get_node_id(),
             thread_instance::get_id(), reset);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_dump(data);
+        for (auto listener : instance->subscribers(LISTEN_DUMP)) {
+            listener->on_dump(data);
         }
         if (apex_options::use_jupyter_support()) {
             apex_options::use_screen_output(old_screen_output);
@@ -1780,8 +1924,8 @@ void finalize(void)
      * to terminate some OMPT events. */
     dynamic::ompt::do_shutdown();
     // notify all listeners that we are going to stop soon
-    for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-        instance->listeners[i]->on_pre_shutdown();
+    for (auto listener : instance->subscribers(LISTEN_PRE_SHUTDOWN)) {
+        listener->on_pre_shutdown();
     }
     stop_all_async_threads(); // stop OS/HW monitoring, including PAPI
 
@@ -1813,9 +1957,8 @@ void finalize(void)
 #endif
         _notify_listeners = false;
         {
-            //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_shutdown(data);
+            for (auto listener : instance->subscribers(LISTEN_SHUTDOWN)) {
+                listener->on_shutdown(data);
             }
         }
     }
@@ -1823,7 +1966,9 @@ void finalize(void)
     //tcmalloc::destroy_hook();
 #endif
     disable_memory_wrapper();
+    stop_heap_snapshots();
     apex_report_leaks();
+    address_resolution::save_symbol_cache();
 #if APEX_HAVE_BFD
     address_resolution::delete_instance();
 #endif
@@ -1897,9 +2042,8 @@ void register_thread(const std::string &name,
     instance->set_state(thread_instance::get_id(), APEX_BUSY);
     new_thread_event_data data(name);
     if (_notify_listeners) {
-        //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_new_thread(data);
+        for (auto listener : instance->subscribers(LISTEN_NEW_THREAD)) {
+            listener->on_new_thread(data);
         }
     }
     if (apex_options::top_level_os_threads()) {
@@ -1978,9 +2122,8 @@ void exit_thread(void)
     _exited = true;
     event_data data;
     if (_notify_listeners) {
-            //read_lock_type l(instance->listener_mutex);
-        for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-            instance->listeners[i]->on_exit_thread(data);
+        for (auto listener : instance->subscribers(LISTEN_EXIT_THREAD)) {
+            listener->on_exit_thread(data);
         }
     }
 }
@@ -2019,6 +2162,8 @@ apex_policy_handle* register_policy(const apex_event_type when,
     {
         id = handler->register_policy(when, f);
     }
+    // the handler may have subscribed to (or dropped) an event
+    apex::instance()->update_listeners();
     apex_policy_handle * handle = new apex_policy_handle();
     handle->id = id;
     handle->event_type = when;
@@ -2065,6 +2210,8 @@ apex_policy_handle* register_periodic_policy(unsigned long period_microseconds,
     {
         id = handler->register_policy(APEX_PERIODIC, f);
     }
+    // the handler may have subscribed to (or dropped) an event
+    apex::instance()->update_listeners();
     apex_policy_handle * handle = new apex_policy_handle();
     handle->id = id;
     handle->event_type = APEX_PERIODIC;
@@ -2180,6 +2327,8 @@ void deregister_policy(apex_policy_handle * handle) {
     if(handler != nullptr) {
         handler->deregister_policy(handle);
     }
+    // the handler may have subscribed to (or dropped) an event
+    apex::instance()->update_listeners();
     //_notify_listeners = true;
     apex::instance()->pop_policy_handle(handle);
     delete(handle);
@@ -2300,9 +2449,8 @@ void send (uint64_t tag, uint64_t size, uint64_t target) {
         //thread_instance::get_id(), target);
         message_event_data data(tag, size, instance->get_node_id(), 0, target);
         if (_notify_listeners) {
-            //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_send(data);
+            for (auto listener : instance->subscribers(LISTEN_SEND)) {
+                listener->on_send(data);
             }
         }
     }
@@ -2330,9 +2478,8 @@ void recv (uint64_t tag, uint64_t size, uint64_t source_rank, uint64_t
         message_event_data data(tag, size, source_rank, 0,
             instance->get_node_id());
         if (_notify_listeners) {
-            //read_lock_type l(instance->listener_mutex);
-            for (unsigned int i = 0 ; i < instance->listeners.size() ; i++) {
-                instance->listeners[i]->on_recv(data);
+            for (auto listener : instance->subscribers(LISTEN_RECV)) {
+                listener->on_recv(data);
             }
         }
     }
@@ -2453,6 +2600,15 @@ extern "C" {
         sample_value(tmp, value, threaded);
     }
 
+    apex_counter_handle apex_register_counter(const char * name) {
+        string tmp(name);
+        return register_counter(tmp);
+    }
+
+    void apex_sample_counter(apex_counter_handle handle, double value) {
+        sample_value(handle, value);
+    }
+
     void apex_new_task(apex_profiler_type type, const void * identifier,
                        unsigned long long task_id) {
         if (type == APEX_FUNCTION_ADDRESS) {
@@ -268,6 +268,26 @@ APEX_EXPORT void apex_set_state(apex_thread_state state);
  */
 APEX_EXPORT void apex_sample_value(const char * name, double value);
 
+/**
+ \brief Register a counter, for sampling with a handle.
+
+ The counter name is parsed and looked up once, so that the counter can
+ be sampled with apex_sample_counter() without any string work.
+
+ \param name The name of the sampled value
+ \return The handle for the counter.
+ */
+APEX_EXPORT apex_counter_handle apex_register_counter(const char * name);
+
+/**
+ \brief Sample a registered counter.
+
+ \param handle The handle returned by apex_register_counter()
+ \param value The sampled value
+ \return No return value.
+ */
+APEX_EXPORT void apex_sample_counter(apex_counter_handle handle, double value);
+
 /**
  \brief Create a new task (dependency).
 
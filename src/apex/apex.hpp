@@ -32,6 +32,7 @@
 #include <vector>
 #include <stdint.h>
 #include <atomic>
+#include <mutex>
 #include <list>
 #include <map>
 #include "apex_types.h"
@@ -84,6 +85,7 @@ private:
     apex() :
         m_node_id(0),
         m_num_ranks(1),
+        m_listener_table(new listener_table()),
 #if APEX_HAVE_PROC
         pd_reader(nullptr),
 #endif
@@ -106,6 +108,10 @@ private:
 #ifdef APEX_HAVE_HPX
     hpx::runtime * m_hpx_runtime;
 #endif
+    std::atomic<listener_table*> m_listener_table;
+    // replaced tables, which other threads may still be reading
+    std::vector<listener_table*> m_old_listener_tables;
+    std::mutex m_listener_table_mutex;
 public:
     static bool& get_program_over();
     profiler_listener * the_profiler_listener;
@@ -117,11 +123,19 @@ public:
 #endif
     std::string version_string;
     std::vector<event_listener*> listeners;
+    /* The listeners that subscribe to an event */
+    const std::vector<event_listener*>& subscribers(listener_event event) {
+        return m_listener_table.load(std::memory_order_acquire)->
+            subscribers[event];
+    }
+    void add_listener(event_listener * listener);
+    /* Rebuild the subscriber lists, after a listener's subscriptions
+     * have changed */
+    void update_listeners(void);
     std::vector<int (*)()> finalize_functions;
     std::string m_my_locality;
     std::unordered_map<int, std::string> custom_event_names;
     shared_mutex_type custom_event_mutex;
-    shared_mutex_type listener_mutex;
     std::mutex thread_instance_mutex;
     std::list<apex_policy_handle*> apex_policy_handles;
     std::set<thread_instance*> known_threads;
@@ -338,6 +338,32 @@ APEX_EXPORT void set_state(apex_thread_state state);
  */
 APEX_EXPORT void sample_value(const std::string &name, double value, bool threaded = false);
 
+/**
+ \brief Register a counter, for sampling with a handle.
+
+ The counter name is parsed and looked up once, so that the counter can
+ be sampled with sample_value(apex_counter_handle,...) without any string
+ work. Registering the same name again returns the same handle.
+
+ \param name The name of the sampled value
+ \return The handle for the counter.
+ */
+APEX_EXPORT apex_counter_handle register_counter(const std::string &name);
+
+/**
+ \brief Sample a registered counter.
+
+ The same as sample_value(const std::string&,...), for a counter that
+ was registered with register_counter().
+
+ \param handle The handle returned by register_counter()
+ \param value The sampled value
+ \param threaded Whether this is a per-thread value, or process-wide
+ \return No return value.
+ */
+APEX_EXPORT void sample_value(apex_counter_handle handle, double value,
+    bool threaded = false);
+
 /**
  \brief Create a new task (dependency).
 
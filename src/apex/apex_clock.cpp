@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "apex_clock.hpp"
+#include "apex_types.h"
+#include <iostream>
+#include <mutex>
+#if defined(APEX_HAVE_TSC_CLOCK) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace apex {
+
+std::atomic<const tsc_calibration*> our_clock::_tsc{nullptr};
+
+#if defined(APEX_HAVE_TSC_CLOCK)
+
+namespace {
+
+/* The first calibration, kept so the drift check can measure the rate
+ * over the whole run. */
+tsc_calibration initial_calibration;
+std::mutex calibration_mutex;
+
+/* The TSC is only usable as a clock if it runs at a constant rate in all
+ * power states, and is synchronized across cores. */
+bool have_invariant_tsc(void) {
+    unsigned int regs[4] = {0,0,0,0};
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned int)info[0] < 0x80000007) { return false; }
+    __cpuid(info, 0x80000007);
+    regs[3] = (unsigned int)info[3];
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007) { return false; }
+    __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+    return (regs[3] & (1u << 8)) != 0;
+}
+
+/* Read the TSC and MYCLOCK as close together as we can.  Take the
+ * tightest of a few tries, and use the midpoint of the TSC reads. */
+void read_pair(uint64_t& ticks, uint64_t& ns) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0 ; i < 5 ; i++) {
+        uint64_t before = __rdtsc();
+        uint64_t now = our_clock::chrono_now_ns();
+        uint64_t after = __rdtsc();
+        if (after - before < best) {
+            best = after - before;
+            ticks = before + ((after - before) / 2);
+            ns = now;
+        }
+    }
+}
+
+} // namespace
+
+bool our_clock::set_source(const std::string& name, bool verbose) {
+    if (name.compare("tsc") != 0) {
+        if (name.compare("chrono") != 0 && name.size() > 0) {
+            std::cerr << "APEX: unknown clock source '" << name
+                      << "', using chrono." << std::endl;
+        }
+        _tsc.store(nullptr, std::memory_order_release);
+        return name.compare("chrono") == 0 || name.size() == 0;
+    }
+    if (!have_invariant_tsc()) {
+        std::cerr << "APEX: no invariant TSC on this CPU, using chrono "
+                  << "clock source." << std::endl;
+        return false;
+    }
+    std::unique_lock<std::mutex> l(calibration_mutex);
+    uint64_t start_ticks, start_ns, end_ticks, end_ns;
+    read_pair(start_ticks, start_ns);
+    // spin for 10ms, sleeping could take much longer than that
+    while (chrono_now_ns() - start_ns < 10000000) {}
+    read_pair(end_ticks, end_ns);
+    if (end_ticks <= start_ticks) {
+        std::cerr << "APEX: TSC calibration failed, using chrono "
+                  << "clock source." << std::endl;
+        return false;
+    }
+    initial_calibration.base_ticks = end_ticks;
+    initial_calibration.base_ns = end_ns;
+    initial_calibration.ns_per_tick = (double)(end_ns - start_ns) /
+        (double)(end_ticks - start_ticks);
+    _tsc.store(new tsc_calibration(initial_calibration),
+        std::memory_order_release);
+    if (verbose) {
+        std::cout << "APEX: TSC clock source, "
+                  << 1.0 / initial_calibration.ns_per_tick
+                  << " GHz" << std::endl;
+    }
+    return true;
+}
+
+void our_clock::check_drift(bool verbose) {
+    const tsc_calibration * c = _tsc.load(std::memory_order_acquire);
+    if (c == nullptr) { return; }
+    std::unique_lock<std::mutex> l(calibration_mutex);
+    uint64_t ticks, ns;
+    read_pair(ticks, ns);
+    uint64_t tsc_ns = c->base_ns +
+        (int64_t)((double)(int64_t)(ticks - c->base_ticks) * c->ns_per_tick);
+    int64_t drift = (int64_t)(tsc_ns - ns);
+    if (ticks <= initial_calibration.base_ticks ||
+        ns <= initial_calibration.base_ns) {
+        return;
+    }
+    /* Refine the rate over the whole run so far, and start again from
+     * the current time.  Never step backwards, the timers in flight
+     * would get negative durations. */
+    tsc_calibration * refined = new tsc_calibration();
+    refined->base_ticks = ticks;
+    refined->base_ns = tsc_ns > ns ? tsc_ns : ns;
+    refined->ns_per_tick = (double)(ns - initial_calibration.base_ns) /
+        (double)(ticks - initial_calibration.base_ticks);
+    _tsc.store(refined, std::memory_order_release);
+    if (verbose) {
+        std::cout << "APEX: TSC clock drift " << (double)drift / 1000.0
+                  << " us, " << 1.0 / refined->ns_per_tick << " GHz"
+                  << std::endl;
+    }
+}
+
+#else // no TSC
+
+bool our_clock::set_source(const std::string& name, bool verbose) {
+    APEX_UNUSED(verbose);
+    if (name.compare("tsc") == 0) {
+        std::cerr << "APEX: the TSC clock source isn't supported on this "
+                  << "platform, using chrono." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void our_clock::check_drift(bool verbose) {
+    APEX_UNUSED(verbose);
+}
+
+#endif
+
+const char * our_clock::source_name(void) {
+    return _tsc.load(std::memory_order_relaxed) == nullptr ? "chrono" : "tsc";
+}
+
+} // namespace
+
@@ -8,16 +8,44 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <string>
+#include "apex_export.h"
 #if defined(APEX_WITH_LEVEL0) // needed to map to GPU time
 #define MYCLOCK std::chrono::steady_clock
 #else
 #define MYCLOCK std::chrono::system_clock
 #endif
 
+/* The time stamp counter is only used on x86 hosts. */
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+    defined(_M_IX86)) && !defined(__CUDA_ARCH__)
+#define APEX_HAVE_TSC_CLOCK
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 namespace apex {
 
+/* The conversion from time stamp counter ticks to nanoseconds, anchored
+ * to a point in time read from MYCLOCK, so both sources share an epoch. */
+struct tsc_calibration {
+    uint64_t base_ticks;
+    uint64_t base_ns;
+    double ns_per_tick;
+};
+
 class our_clock {
+private:
+    /* Null unless the TSC source is selected.  A calibration is never
+     * modified after it is published, and never freed, because other
+     * threads may be reading it. */
+    APEX_EXPORT static std::atomic<const tsc_calibration*> _tsc;
 public:
     // need this before the task_wrapper uses it.
     static uint64_t time_point_to_nanoseconds(std::chrono::time_point<MYCLOCK> tp) {
@@ -26,9 +54,32 @@ public:
             std::chrono::duration_cast<std::chrono::nanoseconds>(value).count();
         return duration;
     }
-    static uint64_t now_ns() {
+    static uint64_t chrono_now_ns() {
         return time_point_to_nanoseconds(MYCLOCK::now());
     }
+#if defined(APEX_HAVE_TSC_CLOCK)
+    static uint64_t tsc_now_ns(const tsc_calibration * c) {
+        int64_t ticks = (int64_t)(__rdtsc() - c->base_ticks);
+        return c->base_ns + (int64_t)((double)ticks * c->ns_per_tick);
+    }
+#endif
+    static uint64_t now_ns() {
+#if defined(APEX_HAVE_TSC_CLOCK)
+        const tsc_calibration * c = _tsc.load(std::memory_order_acquire);
+        if (c != nullptr) {
+            return tsc_now_ns(c);
+        }
+#endif
+        return chrono_now_ns();
+    }
+    /* Select the clock source, "chrono" or "tsc".  The TSC source needs an
+     * invariant TSC, and is calibrated against MYCLOCK.  Returns false
+     * (and keeps the chrono source) if the source isn't available. */
+    APEX_EXPORT static bool set_source(const std::string& name, bool verbose);
+    /* With the TSC source, measure how far it has drifted from MYCLOCK,
+     * and refine the calibration over the longer interval. */
+    APEX_EXPORT static void check_drift(bool verbose);
+    APEX_EXPORT static const char * source_name(void);
 };
 
 } // namespace
@@ -25,11 +25,15 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
+#include <cmath>
 #include <stdlib.h>
 #include "apex.hpp"
 #include "Kokkos_Profiling_C_Interface.h"
 #include "apex_api.hpp"
 #include "apex_policies.hpp"
+#include "tuning_database.hpp"
+#include "tuning_window.hpp"
 
 std::string pVT(Kokkos_Tools_VariableInfo_ValueType t) {
     if (t == kokkos_value_double) {
@@ -270,6 +274,9 @@ private:
             } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
                     "genetic_search", strlen("genetic_search")) == 0) {
                 strategy = apex_ah_tuning_strategy::GENETIC_SEARCH;
+            } else if (strncmp(apex::apex_options::kokkos_tuning_policy(),
+                    "bayesian_search", strlen("bayesian_search")) == 0) {
+                strategy = apex_ah_tuning_strategy::BAYESIAN_SEARCH;
             } else {
                 strategy = apex_ah_tuning_strategy::NELDER_MEAD;
             }
@@ -301,23 +308,27 @@ public:
     std::stack<TreeNode*> contextStack;
     void writeCache();
     bool checkForCache();
-    void readCache();
     void saveInputVar(size_t id, Variable * var);
     void saveOutputVar(size_t id, Variable * var);
-    void parseVariableCache(std::ifstream& results);
-    void parseContextCache(std::ifstream& results);
-    //std::stringstream cachedResults;
     std::string cacheFilename;
-    // Map from cached variables to variable values
-    std::map<std::string, struct Kokkos_Tools_VariableInfo> cachedVariables;
-    // map from cached variable IDs to cached variable names
-    std::map<size_t, std::string> cachedVariableNames;
-    // map from cached variable names to cached variable IDs
-    std::map<std::string, size_t> cachedVariableIDs;
-    std::map<std::string, std::map<size_t, struct Kokkos_Tools_VariableValue> > cachedTunings;
+    // the results of this and previous runs
+    std::unique_ptr<apex::tuning_database> database;
+    // the database context of each tuning context
+    std::unordered_map<std::string, apex::tuning_database::context> contexts;
+    // how many samples each candidate of each tuning context gets
+    std::unordered_map<std::string, apex::tuning_window> windows;
+    apex::tuning_window& getWindow(const std::string& name) {
+        auto w = windows.find(name);
+        if (w == windows.end()) {
+            w = windows.insert(std::make_pair(name, apex::tuning_window(window,
+                apex::apex_options::kokkos_tuning_max_window(),
+                apex::apex_options::kokkos_tuning_confidence()))).first;
+        }
+        return w->second;
+    }
 };
 
-/* If we've cached values, we can bypass a lot. */
+/* If we've tuned these contexts before, we can bypass a lot. */
 bool KokkosSession::checkForCache() {
     static bool once{false};
     if (once) { return use_history; }
@@ -326,15 +337,24 @@ bool KokkosSession::checkForCache() {
     if (strlen(apex::apex_options::kokkos_tuning_cache()) > 0) {
         cacheFilename = std::string(apex::apex_options::kokkos_tuning_cache());
     } else {
-        cacheFilename = std::string("./apex_converged_tuning.yaml");
+        cacheFilename = std::string("./apex_tuning.db");
+        /* Older versions kept a YAML cache instead.  It can't be
+         * converted, because it is keyed by the bins of one run. */
+        std::ifstream legacy("./apex_converged_tuning.yaml");
+        if (legacy.good() && saveCache) {
+            std::cerr << "APEX: ./apex_converged_tuning.yaml is no longer "
+                      << "read, Kokkos tuning results are kept in "
+                      << cacheFilename << " now." << std::endl;
+        }
     }
-    std::ifstream f(cacheFilename);
-    if (f.good()) {
+    database.reset(new apex::tuning_database(cacheFilename));
+    if (database->read()) {
         use_history = true;
         if(verbose) {
-            std::cout << "Cache found" << std::endl;
+            std::cout << "Read " << database->size()
+                      << " Kokkos tuning results from: '" << cacheFilename
+                      << "'" << std::endl;
         }
-        readCache();
     } else {
         if(verbose) {
             std::cout << "Cache not found" << std::endl;
@@ -354,211 +374,51 @@ void KokkosSession::saveOutputVar(size_t id, Variable * var) {
     all_vars.insert(std::make_pair(id, var));
 }
 
+/* Merge our results into the database.  Contexts that haven't converged
+ * are saved too, with their best values so far, so the next run can
+ * continue from them. */
 void KokkosSession::writeCache(void) {
-    if(use_history) { return; }
     if(!saveCache) { return; }
-    // did the user specify a file?
-    if (strlen(apex::apex_options::kokkos_tuning_cache()) > 0) {
-        cacheFilename = std::string(apex::apex_options::kokkos_tuning_cache());
-    } else {
-        cacheFilename = std::string("./apex_converged_tuning.yaml");
-    }
-    std::ofstream results(cacheFilename);
-    std::cout << "Writing cache of Kokkos tuning results to: '" << cacheFilename << "'" << std::endl;
-    for (auto i : inputs) {
-        size_t id = i.first;
-        Variable* v = i.second;
-        results << "Input_" << id << ":" << std::endl;
-        results << v->toString();
-    }
-    for (auto o : outputs) {
-        size_t id = o.first;
-        Variable* v = o.second;
-        results << "Output_" << id << ":" << std::endl;
-        results << v->toString();
-    }
-    size_t count = 0;
+    if(database == nullptr) { return; }
     for (const auto &req : requests) {
-        results << "Context_" << count++ << ":" << std::endl;
-        results << "  Name: \"" << req.first << "\"" << std::endl;
+        auto ctx = contexts.find(req.first);
+        if (ctx == contexts.end()) { continue; }
         std::shared_ptr<apex_tuning_request> request = req.second;
         // always write the random search out
         bool converged = request->has_converged() ||
             strategy == apex_ah_tuning_strategy::APEX_RANDOM;
-        results << "  Converged: " <<
-            (converged ? "true" : "false") << std::endl;
-        if (converged) {
-            results << "  Results:" << std::endl;
-            results << "    NumVars: " << var_ids[req.first].size() << std::endl;
-            for (const auto &id : var_ids[req.first]) {
-                results << "    id: " << id << std::endl;
-                Variable* var{KokkosSession::getSession().outputs[id]};
-                if (var->info.valueQuantity == kokkos_value_set) {
-                    auto param = std::static_pointer_cast<apex_param_enum>(
+        if (!converged) {
+            request->get_best_values();
+        }
+        std::map<std::string, std::string> values;
+        for (const auto &id : var_ids[req.first]) {
+            Variable* var{outputs[id]};
+            if (var->info.valueQuantity == kokkos_value_set) {
+                auto param = std::static_pointer_cast<apex_param_enum>(
+                    request->get_param(var->name));
+                values[var->name] = param->get_value();
+            } else if (var->info.valueQuantity == kokkos_value_range) {
+                std::stringstream ss;
+                ss.precision(17);
+                if (var->info.type == kokkos_value_double) {
+                    auto param = std::static_pointer_cast<apex_param_double>(
                         request->get_param(var->name));
-                    results << "    value: " << param->get_value() << std::endl;
-                } else if (var->info.valueQuantity == kokkos_value_range) {
-                    if (var->info.type == kokkos_value_double) {
-                        auto param = std::static_pointer_cast<apex_param_double>(
-                            request->get_param(var->name));
-                        results << "    value: " << param->get_value() << std::endl;
-                    } else if (var->info.type == kokkos_value_int64) {
-                        auto param = std::static_pointer_cast<apex_param_long>(
-                            request->get_param(var->name));
-                        results << "    value: " << param->get_value() << std::endl;
-                    }
+                    ss << param->get_value();
+                } else if (var->info.type == kokkos_value_int64) {
+                    auto param = std::static_pointer_cast<apex_param_long>(
+                        request->get_param(var->name));
+                    ss << param->get_value();
                 }
+                values[var->name] = ss.str();
             }
         }
-        // if not converged, need to get the "best so far" values for the parameters.
-    }
-    results.close();
-}
-
-void KokkosSession::parseVariableCache(std::ifstream& results) {
-    std::string line;
-    std::string delimiter = ": ";
-    struct Kokkos_Tools_VariableInfo info;
-    memset(&info, 0, sizeof(struct Kokkos_Tools_VariableInfo));
-    // name
-    std::getline(results, line);
-    std::string name = line.substr(line.find(delimiter)+2);
-    // id
-    std::getline(results, line);
-    size_t id = atol(line.substr(line.find(delimiter)+2).c_str());
-    // info.type
-    std::getline(results, line);
-    std::string type = line.substr(line.find(delimiter)+2);
-    if (type.find("double") != std::string::npos) {
-        info.type = kokkos_value_double;
-    } else if (type.find("int64") != std::string::npos) {
-        info.type = kokkos_value_int64;
-    } else if (type.find("string") != std::string::npos) {
-        info.type = kokkos_value_string;
-    }
-    // info.category
-    std::getline(results, line);
-    std::string category = line.substr(line.find(delimiter)+2);
-    if (category.find("categorical") != std::string::npos) {
-        info.category = kokkos_value_categorical;
-    } else if (category.find("ordinal") != std::string::npos) {
-        info.category = kokkos_value_ordinal;
-    } else if (category.find("interval") != std::string::npos) {
-        info.category = kokkos_value_interval;
-    } else if (category.find("ratio") != std::string::npos) {
-        info.category = kokkos_value_ratio;
-    }
-    // info.valueQuantity
-    std::getline(results, line);
-    std::string valueQuantity = line.substr(line.find(delimiter)+2);
-    if (valueQuantity.find("set") != std::string::npos) {
-        info.valueQuantity = kokkos_value_set;
-        info.candidates.set.size = 0;
-    } else if (valueQuantity.find("range") != std::string::npos) {
-        info.valueQuantity = kokkos_value_range;
-        info.candidates.set.size = 0;
-    } else if (valueQuantity.find("unbounded") != std::string::npos) {
-        info.valueQuantity = kokkos_value_unbounded;
-    }
-    // info.candidates
-    std::getline(results, line);
-    std::string candidates = line.substr(line.find(delimiter)+2);
-    // ...eh, who cares.  We don't need the candidate values.
-    // map the name to the variable
-    cachedVariables.insert(std::make_pair(name, std::move(info)));
-    // map the old id to the name
-    cachedVariableNames.insert(std::make_pair(id, name));
-    // map the name to the old id
-    cachedVariableIDs.insert(std::make_pair(name, id));
-    /*
-    if (candidates.find("unbounded") != std::string::npos) {
-        info.candidates = kokkos_value_unbounded;
-        // bin_*: - can be skipped
-        std::getline(results, line);
-        //min: 3751.000000
-        std::getline(results, line);
-        std::string min = line.substr(line.find(delimiter)+2);
-        //mean: 4094.721536
-        std::getline(results, line);
-        std::string mean = line.substr(line.find(delimiter)+2);
-        //max: 4480.000000
-        std::getline(results, line);
-        std::string max = line.substr(line.find(delimiter)+2);
-        //count: 729
-        std::getline(results, line);
-        std::string count = line.substr(line.find(delimiter)+2);
-    }
-    */
-}
-
-void KokkosSession::parseContextCache(std::ifstream& results) {
-    std::string line;
-    std::string delimiter = ": ";
-    // name
-    std::getline(results, line);
-    std::string name = line.substr(line.find(delimiter)+2);
-    name.erase(std::remove(name.begin(),name.end(),'\"'),name.end());
-    // converged?
-    std::getline(results, line);
-    std::string converged = line.substr(line.find(delimiter)+2);
-    if (converged.find("true") != std::string::npos) {
-        std::map<size_t, struct Kokkos_Tools_VariableValue> vars;
-        // Results
-        std::getline(results, line);
-        // NumVars
-        std::getline(results, line);
-        size_t numvars = atol(line.substr(line.find(delimiter)+2).c_str());
-        for (size_t i = 0 ; i < numvars ; i++) {
-            struct Kokkos_Tools_VariableValue var;
-            memset(&var, 0, sizeof(struct Kokkos_Tools_VariableValue));
-            // id
-            std::getline(results, line);
-            size_t id = atol(line.substr(line.find(delimiter)+2).c_str());
-            var.type_id = id;
-            // value
-            std::getline(results, line);
-            std::string value = line.substr(line.find(delimiter)+2);
-            // get the variable name
-            std::string varName = cachedVariableNames.find(id)->second;
-            // look it up in the cached variables
-            auto info = cachedVariables.find(varName);
-            if (info->second.type == kokkos_value_double) {
-                var.value.double_value = atof(value.c_str());
-            } else if (info->second.type == kokkos_value_int64) {
-                var.value.int_value = atol(value.c_str());
-            } else {
-                strcpy(var.value.string_value, value.c_str());
-            }
-            var.metadata = &(info->second);
-            vars.insert(std::make_pair(id, std::move(var)));
-        }
-        cachedTunings.insert(std::make_pair(name, std::move(vars)));
+        database->update(ctx->second, values, converged);
     }
-}
-
-void KokkosSession::readCache(void) {
-    std::ifstream results(cacheFilename);
-    std::cout << "Reading cache of Kokkos tuning results from: '" << cacheFilename << "'" << std::endl;
-    std::string line;
-    while (std::getline(results, line))
-    {
-        std::istringstream iss(line);
-        if (line.find("Input_", 0) != std::string::npos) {
-            //std::cout << line << std::endl;
-            parseVariableCache(results);
-            continue;
-        }
-        if (line.find("Output_", 0) != std::string::npos) {
-            //std::cout << line << std::endl;
-            parseVariableCache(results);
-            continue;
-        }
-        if (line.find("Context_", 0) != std::string::npos) {
-            //std::cout << line << std::endl;
-            parseContextCache(results);
-            continue;
-        }
+    if(verbose) {
+        std::cout << "Writing Kokkos tuning results to: '" << cacheFilename
+                  << "'" << std::endl;
     }
+    database->write();
 }
 
 KokkosSession& KokkosSession::getSession() {
@@ -825,6 +685,56 @@ std::string hashContext(size_t numVars,
     return tmp;
 }
 
+/* The bins of unbounded variables depend on the order the values were seen
+ * in, so the database uses its own bins, a quarter of an octave wide. */
+std::string stableBin(double value) {
+    if (value == 0.0) { return std::string("0"); }
+    std::stringstream ss;
+    ss << (value < 0.0 ? "-" : "") << "2^"
+       << (std::floor(std::log2(std::fabs(value)) * 4.0) / 4.0);
+    return ss.str();
+}
+
+/* The database context of a tuning context: the timer it is in, and the
+ * values of the input variables, sorted by name. */
+apex::tuning_database::context makeContext(size_t numVars,
+    const Kokkos_Tools_VariableValue* values,
+    std::map<size_t, Variable*>& varmap, std::string tree_node) {
+    apex::tuning_database::context ctx;
+    ctx.region = tree_node;
+    for (size_t i = 0 ; i < numVars ; i++) {
+        Variable* var{varmap[values[i].type_id]};
+        bool unbounded = (var->info.valueQuantity == kokkos_value_unbounded);
+        switch (var->info.type) {
+            case kokkos_value_double: {
+                double value = values[i].value.double_value;
+                ctx.inputs.emplace_back(var->name, unbounded ?
+                    stableBin(value) : std::to_string(value), value);
+                break;
+            }
+            case kokkos_value_int64: {
+                double value = (double)(values[i].value.int_value);
+                ctx.inputs.emplace_back(var->name, unbounded ?
+                    stableBin(value) :
+                    std::to_string(values[i].value.int_value), value);
+                break;
+            }
+            case kokkos_value_string:
+                ctx.inputs.emplace_back(var->name,
+                    std::string(values[i].value.string_value));
+                break;
+            default:
+                break;
+        }
+    }
+    std::sort(ctx.inputs.begin(), ctx.inputs.end(),
+        [](const apex::tuning_database::input& lhs,
+           const apex::tuning_database::input& rhs) {
+            return lhs.name < rhs.name;
+        });
+    return ctx;
+}
+
 void printContext(size_t numVars, std::string name) {
     std::cout << "-cv: " << numVars << name;
     std::cout << std::endl;
@@ -837,37 +747,62 @@ void printTuning(const size_t numVars, Kokkos_Tools_VariableValue* values,
     std::cout << std::endl;
 }
 
+/* The values in the tuning database are shared with other processes, and
+ * can be edited by hand, so don't trust that they are numbers. */
+bool parseNumber(const std::string& text, double& value) {
+    char * end;
+    double tmp = strtod(text.c_str(), &end);
+    if (end == text.c_str() || *end != '\0') { return false; }
+    value = tmp;
+    return true;
+}
+
+bool parseNumber(const std::string& text, int64_t& value) {
+    char * end;
+    long long tmp = strtoll(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0') { return false; }
+    value = tmp;
+    return true;
+}
+
 bool getCachedTunings(std::string name,
+    const apex::tuning_database::context& ctx,
     const size_t vars,
     Kokkos_Tools_VariableValue* values) {
     KokkosSession& session = KokkosSession::getSession();
-    auto result = session.cachedTunings.find(name);
-    // don't have a tuning for this context?
-    if (result == session.cachedTunings.end()) { return false; }
+    auto result = session.database->find(ctx);
+    // don't have a converged tuning for this context?
+    if (result == nullptr || !result->converged) { return false; }
+    // check that we have all of the values, before changing any of them
     for (size_t i = 0 ; i < vars ; i++) {
-        auto id = values[i].type_id;
-        // look up the variable in the outputs, by id - may not match the cached ID
-        auto outputVar = session.outputs.find(id);
-        // look up the variable in the cache, by name - the name will always match
-        std::string varname{outputVar->second->name};
-        // look up the cached ID (it might not match the current variable id from Kokkos)
-        size_t varID = session.cachedVariableIDs.find(varname)->second;
-        auto variter = result->second.find(varID);
-        //auto nameiter = session.cachedVariableNames.find(id);
-        if (variter == result->second.end()) { return false; }
-        //if (nameiter == session.cachedVariableNames.end()) { return false; }
-        auto var = variter->second;
-        //auto varname = nameiter->second;
-        if (var.metadata->type == kokkos_value_double) {
-            values[i].value.double_value = var.value.double_value;
-            std::string tmp(name+":"+varname);
-            apex::sample_value(tmp, var.value.double_value);
-        } else if (var.metadata->type == kokkos_value_int64) {
-            values[i].value.int_value = var.value.int_value;
-            std::string tmp(name+":"+varname);
-            apex::sample_value(tmp, var.value.int_value);
-        } else if (var.metadata->type == kokkos_value_string) {
-            strncpy(values[i].value.string_value, var.value.string_value, KOKKOS_TOOLS_TUNING_STRING_LENGTH);
+        auto outputVar = session.outputs.find(values[i].type_id);
+        if (outputVar == session.outputs.end()) { return false; }
+        // look up the variable by name - the ids can change between runs
+        auto value = result->outputs.find(outputVar->second->name);
+        if (value == result->outputs.end()) {
+            return false;
+        }
+        double dtmp;
+        int64_t ltmp;
+        if ((outputVar->second->info.type == kokkos_value_double &&
+             !parseNumber(value->second, dtmp)) ||
+            (outputVar->second->info.type == kokkos_value_int64 &&
+             !parseNumber(value->second, ltmp))) {
+            return false;
+        }
+    }
+    for (size_t i = 0 ; i < vars ; i++) {
+        Variable* var{session.outputs.find(values[i].type_id)->second};
+        const std::string& value = result->outputs.find(var->name)->second;
+        std::string tmp(name+":"+var->name);
+        if (var->info.type == kokkos_value_double) {
+            parseNumber(value, values[i].value.double_value);
+            apex::sample_value(tmp, values[i].value.double_value);
+        } else if (var->info.type == kokkos_value_int64) {
+            parseNumber(value, values[i].value.int_value);
+            apex::sample_value(tmp, values[i].value.int_value);
+        } else if (var->info.type == kokkos_value_string) {
+            strncpy(values[i].value.string_value, value.c_str(), KOKKOS_TOOLS_TUNING_STRING_LENGTH);
         }
     }
     return true;
@@ -915,7 +850,8 @@ void set_params(std::shared_ptr<apex_tuning_request> request,
     }
 }
 
-bool handle_start(const std::string & name, const size_t vars,
+bool handle_start(const std::string & name,
+    const apex::tuning_database::context& ctx, const size_t vars,
     Kokkos_Tools_VariableValue* values, uint64_t& delta, bool& converged) {
     KokkosSession& session = KokkosSession::getSession();
     auto search = session.requests.find(name);
@@ -942,6 +878,9 @@ bool handle_start(const std::string & name, const size_t vars,
 
         // need this in the lambda
         bool verbose = session.verbose;
+        /* With a confidence level, candidates are compared by their mean,
+         * because the minimum depends on how many samples were taken. */
+        bool adaptive = session.getWindow(name).adaptive();
         // Create a metric
         std::function<double(void)> metric = [=]()->double{
             apex_profile * profile = apex::get_profile(name);
@@ -955,7 +894,7 @@ bool handle_start(const std::string & name, const size_t vars,
                 //abort();
                 return 0.0;
             }
-            double result = profile->minimum;
+            double result = adaptive ? 0.0 : profile->minimum;
             if (result == 0.0) result = profile->accumulated/profile->calls;
             if(verbose) {
                 std::cout << std::string(getDepth(), ' ');
@@ -965,6 +904,24 @@ bool handle_start(const std::string & name, const size_t vars,
         };
         request->set_metric(metric);
 
+        /* If we have tuned a similar context before, start the search
+         * from its best values instead of the defaults. */
+        const apex::tuning_database::record* neighbor{nullptr};
+        if (session.database != nullptr) {
+            neighbor = session.database->nearest(ctx);
+        }
+        auto stored = [&](const std::string& var_name) -> const std::string* {
+            if (neighbor == nullptr) { return nullptr; }
+            auto value = neighbor->outputs.find(var_name);
+            if (value == neighbor->outputs.end()) { return nullptr; }
+            return &(value->second);
+        };
+        if(session.verbose && neighbor != nullptr) {
+            std::cout << std::string(getDepth(), ' ');
+            std::cout << "Starting from a previous tuning of "
+                      << neighbor->ctx.region << std::endl;
+        }
+
         // Set apex_openmp_policy_tuning_strategy
         request->set_strategy(session.strategy);
         request->set_radius(0.5);
@@ -987,21 +944,33 @@ bool handle_start(const std::string & name, const size_t vars,
                 } else if (var->info.type == kokkos_value_int64) {
                     front = std::string(values[i].value.string_value);
                 }
+                const std::string* value = stored(session.outputs[id]->name);
+                if (value != nullptr) {
+                    front = *value;
+                    request->set_warm_start(true);
+                }
                 //printf("Initial value: %s\n", front.c_str()); fflush(stdout);
                 auto tmp = request->add_param_enum(
                     session.outputs[id]->name, front, space);
             } else {
+                const std::string* value = stored(session.outputs[id]->name);
                 if (var->info.type == kokkos_value_double) {
+                    double init = values[i].value.double_value;
+                    if (value != nullptr && parseNumber(*value, init)) {
+                        request->set_warm_start(true);
+                    }
                     auto tmp = request->add_param_double(
-                        session.outputs[id]->name,
-                        values[i].value.double_value,
+                        session.outputs[id]->name, init,
                         session.outputs[id]->dmin,
                         session.outputs[id]->dmax,
                         session.outputs[id]->dstep);
                 } else if (var->info.type == kokkos_value_int64) {
+                    int64_t init = values[i].value.int_value;
+                    if (value != nullptr && parseNumber(*value, init)) {
+                        request->set_warm_start(true);
+                    }
                     auto tmp = request->add_param_long(
-                        session.outputs[id]->name,
-                        values[i].value.int_value,
+                        session.outputs[id]->name, init,
                         session.outputs[id]->lmin,
                         session.outputs[id]->lmax,
                         session.outputs[id]->lstep);
@@ -1037,9 +1006,9 @@ void handle_stop(const std::string & name) {
         std::cerr << "ERROR: No data for " << name << std::endl;
     } else {
         apex_profile * profile = apex::get_profile(name);
-        if(session.window == 1 ||
-           (profile != nullptr &&
-            profile->calls >= session.window)) {
+        apex::tuning_window& window = session.getWindow(name);
+        if((session.window == 1 && !window.adaptive()) ||
+           (profile != nullptr && window.ready(*profile))) {
             //std::cout << "Num calls: " << profile->calls << std::endl;
             std::shared_ptr<apex_tuning_request> request = search->second;
             /* If we are in a nested context, and this is the outermost
@@ -1047,6 +1016,7 @@ void handle_stop(const std::string & name) {
              * the inner contexts have also converged! */
             // Evaluate the results
             apex::custom_event(request->get_trigger(), &childrenConverged);
+            if (profile != nullptr) { window.evaluated(*profile); }
             // Reset counter so each measurement is fresh.
             apex::reset(name);
         }
@@ -1145,6 +1115,12 @@ void kokkosp_request_values(
     // create a unique name for this combination of input vars
     std::string name{hashContext(numContextVariables, contextVariableValues,
         session.all_vars, tree_node)};
+    auto ctx = session.contexts.find(name);
+    if (ctx == session.contexts.end()) {
+        ctx = session.contexts.insert(std::make_pair(name,
+            makeContext(numContextVariables, contextVariableValues,
+                session.all_vars, tree_node))).first;
+    }
     if (session.verbose) {
         std::cout << std::string(getDepth(), ' ');
         std::cout << __APEX_FUNCTION__ << " ctx: " << contextId << std::endl;
@@ -1160,14 +1136,16 @@ void kokkosp_request_values(
     // check if we have a cached result
     bool success{false};
     if (session.use_history) {
-        success = getCachedTunings(name, numTuningVariables, tuningVariableValues);
+        success = getCachedTunings(name, ctx->second, numTuningVariables,
+            tuningVariableValues);
     }
     if (success) {
         session.used_history.insert(contextId);
     } else {
         uint64_t delta = 0;
         bool converged = false;
-        if (handle_start(name, numTuningVariables, tuningVariableValues, delta, converged)) {
+        if (handle_start(name, ctx->second, numTuningVariables,
+            tuningVariableValues, delta, converged)) {
             // throw away the time spent setting up tuning
             //session.context_starts[contextId] = session.context_starts[contextId] + delta;
         }
@@ -27,6 +27,8 @@
 #include <atomic>
 #include <utility>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include "apex_cxx_shared_lock.hpp"
 #include "apex_assert.h"
 #include <unistd.h>
@@ -950,6 +952,42 @@ int apex_genetic_policy(shared_ptr<apex_tuning_session> tuning_session,
     return APEX_NOERROR;
 }
 
+int apex_bayesian_policy(shared_ptr<apex_tuning_session> tuning_session,
+    apex_context const context) {
+    APEX_UNUSED(context);
+    if (apex_final) return APEX_NOERROR; // we terminated
+    std::unique_lock<std::mutex> l{shutdown_mutex};
+    /* If we are doing nested search contexts, allow us to keep searching
+     * on outer contexts until all inner contexts have converged! */
+    bool force{true};
+    if (context.data != nullptr) {
+        // the context data is a pointer to a boolean value
+        force = *((bool*)(context.data));
+    }
+    if (tuning_session->bayesian_session.converged() && force) {
+        if (!tuning_session->converged_message) {
+            tuning_session->converged_message = true;
+            cout << "APEX: Tuning has converged for session " << tuning_session->id
+            << "." << endl;
+            tuning_session->bayesian_session.saveBestSettings();
+            tuning_session->bayesian_session.printBestSettings();
+        }
+        tuning_session->bayesian_session.saveBestSettings();
+        return APEX_NOERROR;
+    }
+
+    // get a measurement of our current setting
+    double new_value = tuning_session->metric_of_interest();
+
+    /* Report the performance we've just measured. */
+    tuning_session->bayesian_session.evaluate(new_value);
+
+    /* Request new settings for next time */
+    tuning_session->bayesian_session.getNewSettings();
+
+    return APEX_NOERROR;
+}
+
 int apex_exhaustive_policy(shared_ptr<apex_tuning_session> tuning_session,
     apex_context const context) {
     APEX_UNUSED(context);
@@ -1508,6 +1546,62 @@ inline int __active_harmony_custom_setup(shared_ptr<apex_tuning_session>
 inline void __apex_active_harmony_shutdown(void) { }
 #endif
 
+/* The index of the value closest to a parameter's initial value */
+template<typename V>
+size_t __initial_index(V& v, const std::string& init) {
+    size_t index = 0;
+    char * end;
+    if (v.lvalues.size() > 0) {
+        long value = strtol(init.c_str(), &end, 10);
+        // not a number?  Then start from the first value.
+        if (end == init.c_str() || *end != '\0') { return index; }
+        for (size_t i = 1 ; i < v.lvalues.size() ; i++) {
+            if (std::labs(v.lvalues[i] - value) <
+                std::labs(v.lvalues[index] - value)) { index = i; }
+        }
+    } else if (v.dvalues.size() > 0) {
+        double value = strtod(init.c_str(), &end);
+        if (end == init.c_str() || *end != '\0') { return index; }
+        for (size_t i = 1 ; i < v.dvalues.size() ; i++) {
+            if (std::fabs(v.dvalues[i] - value) <
+                std::fabs(v.dvalues[index] - value)) { index = i; }
+        }
+    } else {
+        auto found = std::find(v.svalues.begin(), v.svalues.end(), init);
+        if (found != v.svalues.end()) {
+            index = found - v.svalues.begin();
+        }
+    }
+    return index;
+}
+
+/* Make a variable's value at the index the next one to evaluate */
+template<typename V>
+void __warm_start_value(V& v, size_t index) {
+    v.current_index = index;
+    v.set_current_value();
+}
+
+/* Simulated annealing evaluates the neighbor of its current setting */
+inline void __warm_start_value(apex::simulated_annealing::Variable& v,
+    size_t index) {
+    v.neighbor_index = index;
+    v.set_neighbor_value();
+}
+
+/* If requested, make the initial values the first setting to evaluate.
+ * The exhaustive search then continues from there, and still visits every
+ * setting once. */
+template<typename S>
+void __warm_start(S& session, apex_tuning_request & request) {
+    if (!request.get_warm_start()) { return; }
+    for (auto& v : session.get_vars()) {
+        auto param = request.get_param(v.first);
+        __warm_start_value(v.second, param ?
+            __initial_index(v.second, param->get_init()) : 0);
+    }
+}
+
 inline int __sa_setup(shared_ptr<apex_tuning_session>
     tuning_session, apex_tuning_request & request) {
   APEX_UNUSED(tuning_session);
@@ -1565,6 +1659,7 @@ inline int __sa_setup(shared_ptr<apex_tuning_session>
   }
   /* request initial settings */
   tuning_session->sa_session.getNewSettings();
+  __warm_start(tuning_session->sa_session, request);
 
   return APEX_NOERROR;
 }
@@ -1626,6 +1721,69 @@ inline int __genetic_setup(shared_ptr<apex_tuning_session>
   }
   /* request initial settings */
   tuning_session->genetic_session.getNewSettings();
+  __warm_start(tuning_session->genetic_session, request);
+
+  return APEX_NOERROR;
+}
+
+inline int __bayesian_setup(shared_ptr<apex_tuning_session>
+    tuning_session, apex_tuning_request & request) {
+  APEX_UNUSED(tuning_session);
+  // set up the Bayesian search!
+  // iterate over the parameters, and create variables.
+  using namespace apex::bayesian;
+  for(auto & kv : request.params) {
+      auto & param = kv.second;
+      const char * param_name = param->get_name().c_str();
+      switch(param->get_type()) {
+          case apex_param_type::LONG: {
+              auto param_long =
+              std::static_pointer_cast<apex_param_long>(param);
+              Variable v(VariableType::longtype, param_long->value.get());
+              long lvalue = param_long->min;
+              do {
+                  v.lvalues.push_back(lvalue);
+                  lvalue = lvalue + param_long->step;
+              } while (lvalue <= param_long->max);
+              v.set_init();
+              tuning_session->bayesian_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::DOUBLE: {
+              auto param_double =
+              std::static_pointer_cast<apex_param_double>(param);
+              Variable v(VariableType::doubletype, param_double->value.get());
+              double dvalue = param_double->min;
+              do {
+                  v.dvalues.push_back(dvalue);
+                  dvalue = dvalue + param_double->step;
+              } while (dvalue <= param_double->max);
+              v.set_init();
+              tuning_session->bayesian_session.add_var(param_name, std::move(v));
+          }
+          break;
+          case apex_param_type::ENUM: {
+              auto param_enum =
+              std::static_pointer_cast<apex_param_enum>(param);
+              Variable v(VariableType::stringtype, param_enum->value.get());
+              for(const std::string & possible_value :
+                             param_enum->possible_values) {
+                  v.svalues.push_back(possible_value);
+              }
+              v.set_init();
+              tuning_session->bayesian_session.add_var(param_name, std::move(v));
+          }
+          break;
+          default:
+              cerr <<
+              "ERROR: Attempted to register tuning parameter with unknown type."
+              << endl;
+              return APEX_ERROR;
+      }
+  }
+  /* request initial settings */
+  tuning_session->bayesian_session.getNewSettings();
+  __warm_start(tuning_session->bayesian_session, request);
 
   return APEX_NOERROR;
 }
@@ -1687,6 +1845,7 @@ inline int __exhaustive_setup(shared_ptr<apex_tuning_session>
   }
   /* request initial settings */
   tuning_session->exhaustive_session.getNewSettings();
+  __warm_start(tuning_session->exhaustive_session, request);
 
   return APEX_NOERROR;
 }
@@ -1748,6 +1907,7 @@ inline int __random_setup(shared_ptr<apex_tuning_session>
   }
   /* request initial settings */
   tuning_session->random_session.getNewSettings();
+  __warm_start(tuning_session->random_session, request);
 
   return APEX_NOERROR;
 }
@@ -1834,6 +1994,7 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
     tuning_session, apex_tuning_request & request) {
     __read_common_variables(tuning_session);
     int status = APEX_NOERROR;
+    tuning_session->strategy = request.strategy;
     // if using the simulated annealing strategy, don't use AH!
     if (request.strategy == apex_ah_tuning_strategy::SIMULATED_ANNEALING) {
         status = __sa_setup(tuning_session, request);
@@ -1855,6 +2016,16 @@ inline int __common_setup_custom_tuning(shared_ptr<apex_tuning_session>
             }
             );
         }
+    } else if (request.strategy == apex_ah_tuning_strategy::BAYESIAN_SEARCH) {
+        status = __bayesian_setup(tuning_session, request);
+        if(status == APEX_NOERROR) {
+            apex::register_policy(
+            request.trigger,
+            [=](apex_context const & context)->int {
+                return apex_bayesian_policy(tuning_session, context);
+            }
+            );
+        }
     } else if (request.strategy == apex_ah_tuning_strategy::APEX_EXHAUSTIVE) {
         status = __exhaustive_setup(tuning_session, request);
         if(status == APEX_NOERROR) {
@@ -2103,8 +2274,27 @@ APEX_EXPORT void get_best_values(apex_tuning_session_handle h) {
 #ifdef APEX_HAVE_ACTIVEHARMONY
         ah_best(tuning_session->htask);
 #endif
-    } else {
-        return;
+    } else if (tuning_session) {
+        std::unique_lock<std::mutex> l{shutdown_mutex};
+        switch (tuning_session->strategy) {
+            case apex_ah_tuning_strategy::SIMULATED_ANNEALING:
+                tuning_session->sa_session.saveBestSettings();
+                break;
+            case apex_ah_tuning_strategy::GENETIC_SEARCH:
+                tuning_session->genetic_session.saveBestSettings();
+                break;
+            case apex_ah_tuning_strategy::APEX_EXHAUSTIVE:
+                tuning_session->exhaustive_session.saveBestSettings();
+                break;
+            case apex_ah_tuning_strategy::APEX_RANDOM:
+                tuning_session->random_session.saveBestSettings();
+                break;
+            case apex_ah_tuning_strategy::BAYESIAN_SEARCH:
+                tuning_session->bayesian_session.saveBestSettings();
+                break;
+            default:
+                break;
+        }
     }
 }
 
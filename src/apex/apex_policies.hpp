@@ -35,13 +35,15 @@
 #include "random.hpp"
 // include the genetic_search class
 #include "genetic_search.hpp"
+// include the bayesian_search class
+#include "bayesian_search.hpp"
 
 enum class apex_param_type : int {NONE, LONG, DOUBLE, ENUM};
 enum class apex_ah_tuning_strategy : int {
     EXHAUSTIVE, RANDOM, NELDER_MEAD,
     PARALLEL_RANK_ORDER, SIMULATED_ANNEALING,
     APEX_EXHAUSTIVE, APEX_RANDOM,
-    GENETIC_SEARCH};
+    GENETIC_SEARCH, BAYESIAN_SEARCH};
 
 struct apex_tuning_session;
 class apex_tuning_request;
@@ -82,6 +84,8 @@ class apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __genetic_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __bayesian_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_long : public apex_param {
@@ -121,6 +125,8 @@ class apex_param_long : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __genetic_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __bayesian_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_double : public apex_param {
@@ -160,6 +166,8 @@ class apex_param_double : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __genetic_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __bayesian_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 class apex_param_enum : public apex_param {
@@ -198,6 +206,8 @@ class apex_param_enum : public apex_param {
             tuning_session, apex_tuning_request & request);
         friend int __genetic_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __bayesian_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 
@@ -213,6 +223,7 @@ class apex_tuning_request {
         double radius;
         int aggregation_times;
         std::string aggregation_function;
+        bool warm_start;
 
     public:
         apex_tuning_request(const std::string & name, std::function<double()>
@@ -220,12 +231,14 @@ class apex_tuning_request {
             : name{name}, metric{metric}, trigger{trigger},
             tuning_session_handle{0},
             running{false},
-            strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER}  {};
+            strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER},
+            warm_start{false}  {};
         apex_tuning_request(const std::string & name) : name{name},
         trigger{APEX_INVALID_EVENT},
             tuning_session_handle{0}, running{false},
             strategy{apex_ah_tuning_strategy::PARALLEL_RANK_ORDER},
-            radius(0.5), aggregation_times(3), aggregation_function("min")
+            radius(0.5), aggregation_times(3), aggregation_function("min"),
+            warm_start(false)
             {};
         virtual ~apex_tuning_request()  {};
 
@@ -324,6 +337,16 @@ class apex_tuning_request {
             aggregation_function = f;
         };
 
+        /* Evaluate the initial values of the parameters first, for
+         * example the best values from a previous run. */
+        void set_warm_start(bool w) {
+            warm_start = w;
+        };
+
+        bool get_warm_start() const {
+            return warm_start;
+        };
+
         friend apex_tuning_session_handle
         __setup_custom_tuning(apex_tuning_request & request);
         friend int
@@ -340,6 +363,8 @@ class apex_tuning_request {
             tuning_session, apex_tuning_request & request);
         friend int __genetic_setup(std::shared_ptr<apex_tuning_session>
             tuning_session, apex_tuning_request & request);
+        friend int __bayesian_setup(std::shared_ptr<apex_tuning_session>
+            tuning_session, apex_tuning_request & request);
 };
 
 
@@ -368,6 +393,8 @@ struct apex_tuning_session {
     apex::random::Random random_session;
     // if using genetic, this is the request.
     apex::genetic::GeneticSearch genetic_session;
+    // if using bayesian, this is the request.
+    apex::bayesian::BayesianSearch bayesian_session;
     bool converged_message = false;
 
     // variables related to power throttling
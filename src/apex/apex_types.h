@@ -219,6 +219,11 @@ typedef int (*apex_policy_function)(apex_context const context);
  */
 typedef uint32_t apex_tuning_session_handle;
 
+/**
+ *  A handle to a counter, from register_counter().
+ */
+typedef uint32_t apex_counter_handle;
+
 /** A null pointer representing an APEX function address.
  * Used when a null APEX function address is to be passed in to
  * any apex functions to represent "all functions".
@@ -270,11 +275,17 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_SUSPEND, suspend, bool, false, "Suspend APEX timers and counters during the application execution") \
     macro (APEX_PAPI_SUSPEND, papi_suspend, bool, false, "Suspend PAPI counters during the application execution") \
     macro (APEX_PROCESS_ASYNC_STATE, process_async_state, bool, true, "Enable/disable asynchronous processing of statistics (useful when only collecting trace data)") \
+    macro (APEX_ASYNC_PROCESSING, async_processing, bool, false, "Update the profiles from a consumer thread, instead of on the application thread when each timer stops.") \
     macro (APEX_UNTIED_TIMERS, untied_timers, bool, false, "Disable callstack state maintenance for specific OS threads. This allows APEX timers to start on one thread and stop on another. This is not compatible with tracing.") \
     macro (APEX_TAU, use_tau, bool, false, "Enable TAU profiling (if application is executed with tau_exec).") \
     macro (APEX_OTF2, use_otf2, bool, false, "Enable OTF2 trace output.") \
     macro (APEX_OTF2_COLLECTIVE_SIZE, otf2_collective_size, int, 1, "") \
     macro (APEX_TRACE_EVENT, use_trace_event, bool, false, "Enable Google Trace Event output. (deprecated, please use APEX_PERFETTO)") \
+    macro (APEX_TRACE_EVENT_BINARY, trace_event_binary, bool, false, "With APEX_TRACE_EVENT, write a compact binary event log instead of JSON, to be converted with apex_trace_convert.") \
+    macro (APEX_TRACE_EVENT_COMPRESSION_THREADS, trace_event_compression_threads, int, 2, "Number of threads compressing the trace event output.") \
+    macro (APEX_TRACE_EVENT_BUFFER_SIZE, trace_event_buffer_size, int, 256, "Maximum trace event data (in MB) buffered in memory, before the application threads wait for it to be written.") \
+    macro (APEX_TRACE_EVENT_MAX_FILE_SIZE, trace_event_max_file_size, int, 0, "Maximum size (in MB) of a trace event file.  When set, the output is rotated through numbered files.  0 is unlimited.") \
+    macro (APEX_TRACE_EVENT_MAX_FILES, trace_event_max_files, int, 10, "With APEX_TRACE_EVENT_MAX_FILE_SIZE, the number of most recent trace event files to keep.  0 keeps them all.") \
     macro (APEX_PERFETTO, use_perfetto, bool, false, "Enable Perfetto Trace output.") \
     macro (APEX_POLICY, use_policy, bool, true, "Enable APEX policy listener and execute registered policies.") \
     macro (APEX_MEASURE_CONCURRENCY, use_concurrency, int, 0, "Periodically sample thread activity and output report at exit.") \
@@ -290,6 +301,7 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_TASKTREE_OUTPUT, use_tasktree_output, bool, false, "Output CSV task tree (no cycles, unique callpaths).") \
     macro (APEX_HATCHET_OUTPUT, use_hatchet_output, bool, false, "Output json/Hatchet task tree (no cycles, unique callpaths).") \
     macro (APEX_SOURCE_LOCATION, use_source_location, bool, false, "When resolving instruction addresses with binutils, include filename and line number.") \
+    macro (APEX_SYMBOL_CACHE, use_symbol_cache, bool, false, "Keep resolved instruction addresses in a cache file for each program, and reuse them in the next run.") \
     macro (APEX_PROC_CPUINFO, use_proc_cpuinfo, bool, false, "Periodically sample data from /proc/cpuinfo.") \
     macro (APEX_PROC_LOADAVG, use_proc_loadavg, bool, true, "Periodically sample data from /proc/loadavg.") \
     macro (APEX_PROC_MEMINFO, use_proc_meminfo, bool, false, "Periodically sample data from /proc/meminfo.") \
@@ -327,10 +339,15 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_OMPT_HIGH_OVERHEAD_EVENTS, ompt_high_overhead_events, \
         bool, false, "Disable high-frequency, high-overhead OMPT events.") \
     macro (APEX_PIN_APEX_THREADS, pin_apex_threads, bool, true, "Pin APEX asynchronous threads to the last core/PU on the system.") \
+    macro (APEX_TIMER_SLACK, timer_slack, int, 1000, "Granularity (in microseconds) of the thread that runs the periodic APEX activities.  Activities that are due within the same interval share one wakeup.") \
     macro (APEX_TRACK_CPU_MEMORY, track_cpu_memory, bool, false, "Track all malloc/free/new/delete calls to CPU memory and report leaks.") \
     macro (APEX_TRACK_GPU_MEMORY, track_gpu_memory, bool, false, "Track all malloc/free/new/delete calls to GPU memory and report leaks.") \
+    macro (APEX_MEMORY_SAMPLE_BYTES, memory_sample_bytes, int, 1, "When tracking memory, capture the call stack of about one allocation per this many bytes allocated (e.g. 524288), which is much cheaper than capturing all of them.  1 captures every call stack, 0 none.  Leaks without a call stack are reported, but not counted as actual leaks.") \
+    macro (APEX_HEAP_SNAPSHOT_PERIOD, heap_snapshot_period, int, 0, "When tracking memory, write a snapshot of the live heap by allocation site every N seconds.  0 disables the snapshots.") \
     macro (APEX_DELAY_MEMORY_TRACKING, delay_memory_tracking, bool, false, "Delay memory tracking until explicitly enabled.") \
     macro (APEX_DELAY_MEMORY_ITERATIONS, delay_memory_iterations, int, 1, "Delay memory tracking until after N calls to apex::dump().") \
+    macro (APEX_SAMPLING_PERIOD, sampling_period, int, 0, "Interrupt each registered thread every N microseconds of its CPU time, and sample its call stack and current task (Linux only).  0 disables the sampling profiler.") \
+    macro (APEX_SAMPLING_DEPTH, sampling_depth, int, 8, "The number of call stack frames to keep in each sample (at most 32).  The stacks are walked with the frame pointers, so code built with -fomit-frame-pointer (the default of -O2 on x86_64) ends them early.") \
     macro (APEX_TASK_SCATTERPLOT, task_scatterplot, bool, false, "Periodically sample APEX tasks, generating a scatterplot of time distributions.") \
     macro (APEX_TIME_TOP_LEVEL_OS_THREADS, top_level_os_threads, bool, false, "When registering threads, measure their lifetimes.") \
     macro (APEX_POLICY_DRAIN_TIMEOUT, policy_drain_timeout, int, 1000, "Internal usage only.") \
@@ -359,6 +376,7 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_KOKKOS_COUNTERS, use_kokkos_counters, bool, false, "Enable Kokkos counters.") \
     macro (APEX_KOKKOS_TUNING, use_kokkos_tuning, bool, false, "Enable Kokkos autotuning.") \
     macro (APEX_KOKKOS_TUNING_WINDOW, kokkos_tuning_window, int, 5, "Minimum number of tests per candidate while autotuning.") \
+    macro (APEX_KOKKOS_TUNING_MAX_WINDOW, kokkos_tuning_max_window, int, 50, "Maximum number of tests per candidate while autotuning, when APEX_KOKKOS_TUNING_CONFIDENCE is set.") \
     macro (APEX_KOKKOS_PROFILING_FENCES, use_kokkos_profiling_fences, bool, false, "Force Kokkos to fence after all Kokkos kernel launches (recommended, but not required).") \
     macro (APEX_START_DELAY_SECONDS, start_delay_seconds, int, 0, "Delay collection of APEX data for N seconds.") \
     macro (APEX_MAX_DURATION_SECONDS, max_duration_seconds, int, 0, "Collect APEX data for only N seconds.") \
@@ -367,6 +385,7 @@ inline unsigned int sc_nprocessors_onln(void)
 
 #define FOREACH_APEX_FLOAT_OPTION(macro) \
     macro (APEX_SCATTERPLOT_FRACTION, scatterplot_fraction, double, 0.01, "Fraction of kernel executions to include on scatterplot.") \
+    macro (APEX_KOKKOS_TUNING_CONFIDENCE, kokkos_tuning_confidence, double, 0.0, "Confidence level (e.g. 0.95) for comparing autotuning candidates.  If set, each candidate is tested until it is significantly better or worse than the best so far (or equivalent to it), and candidates are compared by their mean time.  If 0, each candidate is tested APEX_KOKKOS_TUNING_WINDOW times.") \
     macro (APEX_VALIDATE_MPI_MEMORY_USAGE_FRACTION, validate_mpi_memory_usage_fraction, double, 1.0, "") \
 
 #define FOREACH_APEX_STRING_OPTION(macro) \
@@ -381,10 +400,13 @@ inline unsigned int sc_nprocessors_onln(void)
     macro (APEX_OTF2_ARCHIVE_NAME, otf2_archive_name, char*, \
         APEX_DEFAULT_OTF2_ARCHIVE_NAME, "OTF2 trace filename.") \
     macro (APEX_EVENT_FILTER_FILE, task_event_filter_file, char*, "", "File containing names of timers to include/exclude during data collection.") \
-    macro (APEX_KOKKOS_TUNING_CACHE, kokkos_tuning_cache, char*, "", "Filename contining Kokkos autotuned results, tuned offline.") \
-    macro (APEX_KOKKOS_TUNING_POLICY, kokkos_tuning_policy, char*, "simulated_annealing", "Kokkos autotuning policy: random, exhaustive, simulated_annealing, nelder_mead.") \
+    macro (APEX_KOKKOS_TUNING_CACHE, kokkos_tuning_cache, char*, "", "Filename of the database of Kokkos autotuning results, shared by all runs and updated by each one (default: ./apex_tuning.db).") \
+    macro (APEX_KOKKOS_TUNING_POLICY, kokkos_tuning_policy, char*, "simulated_annealing", "Kokkos autotuning policy: random, exhaustive, simulated_annealing, genetic_search, bayesian_search, nelder_mead.") \
     macro (APEX_ROCPROF_METRICS, rocprof_metrics, char*, "", "List of metrics to periodically sample with the Rocprofiler library (see /opt/rocm/rocprofiler/lib/metrics.xml).") \
-    macro (APEX_NVTX_LIBRARY, nvtx_library, char*, "libnvToolsExt.so", "With NVTX listener, specify the location of libnvToolsExt.so.")
+    macro (APEX_NVTX_LIBRARY, nvtx_library, char*, "libnvToolsExt.so", "With NVTX listener, specify the location of libnvToolsExt.so.") \
+    macro (APEX_CLOCK_SOURCE, clock_source, char*, "chrono", "Clock source for timestamps: chrono, or tsc (x86 invariant time stamp counter, calibrated at startup).") \
+    macro (APEX_HEAP_SNAPSHOT_FORMAT, heap_snapshot_format, char*, "folded", "Format of the heap snapshots: folded (call stacks of live bytes, for flamegraph.pl), or pprof (a gperftools heap profile).") \
+    macro (APEX_SYMBOL_CACHE_PATH, symbol_cache_path, char*, "", "Path to the symbol cache files (default: APEX_OUTPUT_FILE_PATH).")
     // macro (APEX_ROCPROF_METRICS, rocprof_metrics, char*, "MemUnitBusy,MemUnitStalled,VALUUtilization,VALUBusy,SALUBusy,L2CacheHit,WriteUnitStalled,ALUStalledByLDS,LDSBankConflict", "")
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace apex {
+
+/* The sum, sum of squares, minimum and maximum of a batch of
+ * measurements, for folding a batch into a profile in one update. */
+struct batch_stats {
+    double sum;
+    double sum_squares;
+    double minimum;
+    double maximum;
+};
+
+inline void compute_batch_stats(const double * values, size_t n,
+    batch_stats& out) {
+    size_t i = 0;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    double minimum = std::numeric_limits<double>::max();
+    double maximum = std::numeric_limits<double>::lowest();
+#if defined(__AVX__)
+    if (n >= 4) {
+        __m256d vsum = _mm256_setzero_pd();
+        __m256d vsq = _mm256_setzero_pd();
+        __m256d vmin = _mm256_set1_pd(minimum);
+        __m256d vmax = _mm256_set1_pd(maximum);
+        for ( ; i + 4 <= n ; i += 4) {
+            __m256d v = _mm256_loadu_pd(values + i);
+            vsum = _mm256_add_pd(vsum, v);
+            vsq = _mm256_add_pd(vsq, _mm256_mul_pd(v, v));
+            vmin = _mm256_min_pd(vmin, v);
+            vmax = _mm256_max_pd(vmax, v);
+        }
+        double tmp[4];
+        _mm256_storeu_pd(tmp, vsum);
+        sum = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm256_storeu_pd(tmp, vsq);
+        sum_squares = (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+        _mm256_storeu_pd(tmp, vmin);
+        for (int j = 0 ; j < 4 ; j++) {
+            minimum = tmp[j] < minimum ? tmp[j] : minimum;
+        }
+        _mm256_storeu_pd(tmp, vmax);
+        for (int j = 0 ; j < 4 ; j++) {
+            maximum = tmp[j] > maximum ? tmp[j] : maximum;
+        }
+    }
+#elif defined(__SSE2__)
+    if (n >= 2) {
+        __m128d vsum = _mm_setzero_pd();
+        __m128d vsq = _mm_setzero_pd();
+        __m128d vmin = _mm_set1_pd(minimum);
+        __m128d vmax = _mm_set1_pd(maximum);
+        for ( ; i + 2 <= n ; i += 2) {
+            __m128d v = _mm_loadu_pd(values + i);
+            vsum = _mm_add_pd(vsum, v);
+            vsq = _mm_add_pd(vsq, _mm_mul_pd(v, v));
+            vmin = _mm_min_pd(vmin, v);
+            vmax = _mm_max_pd(vmax, v);
+        }
+        double tmp[2];
+        _mm_storeu_pd(tmp, vsum);
+        sum = tmp[0] + tmp[1];
+        _mm_storeu_pd(tmp, vsq);
+        sum_squares = tmp[0] + tmp[1];
+        _mm_storeu_pd(tmp, vmin);
+        minimum = tmp[0] < tmp[1] ? tmp[0] : tmp[1];
+        _mm_storeu_pd(tmp, vmax);
+        maximum = tmp[0] > tmp[1] ? tmp[0] : tmp[1];
+    }
+#endif
+    // the remainder (or everything, without SIMD support)
+    for ( ; i < n ; i++) {
+        double v = values[i];
+        sum += v;
+        sum_squares += v * v;
+        minimum = v < minimum ? v : minimum;
+        maximum = v > maximum ? v : maximum;
+    }
+    out.sum = sum;
+    out.sum_squares = sum_squares;
+    out.minimum = minimum;
+    out.maximum = maximum;
+}
+
+}
+
@@ -0,0 +1,216 @@
+#include "bayesian_search.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <iterator>
+
+namespace apex {
+
+namespace bayesian {
+
+double inline myrand() {
+    return ((double) rand() / (RAND_MAX));
+}
+
+size_t BayesianSearch::get_max_iterations() {
+    size_t max_iter{1};
+    for (auto& v : vars) {
+        switch (v.second.vtype) {
+            case VariableType::doubletype: {
+                max_iter = max_iter * v.second.dvalues.size();
+                break;
+            }
+            case VariableType::longtype: {
+                max_iter = max_iter * v.second.lvalues.size();
+                break;
+            }
+            case VariableType::stringtype: {
+                max_iter = max_iter * v.second.svalues.size();
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+    // settings are never repeated, so don't look for more than there are
+    return std::min(max_iterations, max_iter);
+}
+
+/* Sample an index from a discrete density */
+size_t sample(const std::vector<double>& p) {
+    double r = myrand();
+    for (size_t i = 0 ; i < p.size() ; i++) {
+        if (r < p[i]) { return i; }
+        r = r - p[i];
+    }
+    return p.size() - 1;
+}
+
+/* The Parzen estimator of one variable, over the observations from begin
+   to end.  Each observation contributes a kernel - a discretized Gaussian
+   for ordered values, or all of its weight to its own value for categories.
+   A uniform prior, weighted like one more observation, keeps every value
+   possible. */
+std::vector<double> BayesianSearch::density(const Variable& v, size_t index,
+    std::vector<candidate>::const_iterator begin,
+    std::vector<candidate>::const_iterator end) {
+    const size_t n = end - begin;
+    std::vector<double> p(v.maxlen, 1.0 / (double)(v.maxlen));
+    if (v.is_ordinal()) {
+        // narrower kernels as we learn more
+        const double sigma = std::max(1.0,
+            (double)(v.maxlen) / (double)(1 + n));
+        std::vector<double> kernel(v.maxlen);
+        for (auto it = begin ; it != end ; it++) {
+            const double center = (double)(it->indexes[index]);
+            double total = 0.0;
+            for (size_t x = 0 ; x < v.maxlen ; x++) {
+                const double z = ((double)(x) - center) / sigma;
+                kernel[x] = exp(-0.5 * z * z);
+                total += kernel[x];
+            }
+            for (size_t x = 0 ; x < v.maxlen ; x++) {
+                p[x] += kernel[x] / total;
+            }
+        }
+    } else {
+        for (auto it = begin ; it != end ; it++) {
+            p[it->indexes[index]] += 1.0;
+        }
+    }
+    for (auto& x : p) { x = x / (double)(n + 1); }
+    return p;
+}
+
+/* Has this setting been evaluated already? */
+bool BayesianSearch::is_new(const candidate& c) {
+    return std::none_of(history.begin(), history.end(),
+        [&](const candidate& other) { return other.indexes == c.indexes; });
+}
+
+/* The model treats the variables independently, so a value that was only
+   tried along with bad values of the other variables looks bad, too.
+   Changing one variable of the best setting so far catches those. */
+bool BayesianSearch::perturb_best(candidate& c) {
+    size_t i = 0;
+    for (auto& v : vars) { c.indexes[i++] = v.second.best_index; }
+    const size_t max_tries{16};
+    for (size_t tries = 0 ; tries < max_tries ; tries++) {
+        candidate s(c);
+        size_t index = rand() % vars.size();
+        auto v = vars.begin();
+        std::advance(v, index);
+        s.indexes[index] = v->second.get_random_index();
+        if (is_new(s)) {
+            c = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+candidate BayesianSearch::propose(void) {
+    candidate c;
+    c.cost = std::numeric_limits<double>::max();
+    c.indexes.resize(vars.size());
+    if (history.size() >= startup()) {
+        if (myrand() < local && perturb_best(c)) { return c; }
+        std::vector<candidate> sorted(history);
+        std::sort(sorted.begin(), sorted.end(),
+            [](const candidate& lhs, const candidate& rhs) {
+                return lhs.cost < rhs.cost;
+            });
+        const size_t num_good = std::max(size_t(1),
+            (size_t)(std::ceil(gamma * sorted.size())));
+        auto split = sorted.cbegin() + num_good;
+        std::vector<std::vector<double>> good;
+        std::vector<std::vector<double>> bad;
+        size_t i = 0;
+        for (auto& v : vars) {
+            good.push_back(density(v.second, i, sorted.cbegin(), split));
+            bad.push_back(density(v.second, i, split, sorted.cend()));
+            i++;
+        }
+        /* Draw from the "good" densities, and keep the setting with the
+           best ratio of good to bad - the expected improvement is
+           proportional to it.  Some values are drawn uniformly instead,
+           otherwise values that haven't been tried yet are hardly ever
+           drawn, even though their ratio is high. */
+        double best_score = -std::numeric_limits<double>::max();
+        bool found = false;
+        for (size_t j = 0 ; j < num_samples ; j++) {
+            candidate s;
+            s.cost = c.cost;
+            double score = 0.0;
+            i = 0;
+            for (auto& v : vars) {
+                size_t x = (myrand() < explore) ?
+                    v.second.get_random_index() : sample(good[i]);
+                s.indexes.push_back(x);
+                score += log(good[i][x]) - log(bad[i][x]);
+                i++;
+            }
+            if (score > best_score && is_new(s)) {
+                best_score = score;
+                c = s;
+                found = true;
+            }
+        }
+        if (found) { return c; }
+    }
+    // random settings while starting up, or if the model only suggests
+    // settings that we have already seen.
+    const size_t max_tries{100};
+    for (size_t tries = 0 ; tries < max_tries ; tries++) {
+        c.indexes.clear();
+        for (auto& v : vars) {
+            c.indexes.push_back(v.second.get_random_index());
+        }
+        if (is_new(c)) { break; }
+    }
+    return c;
+}
+
+void BayesianSearch::getNewSettings() {
+    candidate c = propose();
+    size_t i = 0;
+    for (auto& v : vars) {
+        v.second.current_index = c.indexes[i++];
+        v.second.set_current_value();
+    }
+}
+
+void BayesianSearch::record(const candidate& c) {
+    if (c.cost < best_cost) {
+        best_cost = c.cost;
+        std::cout << "New best! " << c.cost << " k: " << k
+                  << " kmax: " << kmax;
+        size_t i = 0;
+        for (auto& v : vars) {
+            v.second.best_index = c.indexes[i++];
+            std::cout  << ", " << v.first << ": "
+                       << v.second.toString(v.second.best_index);
+        }
+        std::cout << std::endl;
+        num_stable_iterations = 0;
+    } else if (history.size() >= startup()) {
+        num_stable_iterations++;
+    }
+    history.push_back(c);
+    k++;
+}
+
+void BayesianSearch::evaluate(double new_cost) {
+    candidate c;
+    c.cost = new_cost;
+    for (auto& v : vars) { c.indexes.push_back(v.second.current_index); }
+    record(c);
+    return;
+}
+
+} // bayesian
+
+} // apex
+
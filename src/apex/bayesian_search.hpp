@@ -0,0 +1,167 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <limits>
+#include <map>
+#include "apex_types.h"
+#include "apex_assert.h"
+
+namespace apex {
+
+namespace bayesian {
+
+enum class VariableType { doubletype, longtype, stringtype } ;
+
+class Variable {
+public:
+    std::vector<double> dvalues;
+    std::vector<long> lvalues;
+    std::vector<std::string> svalues;
+    VariableType vtype;
+    size_t current_index;
+    size_t best_index;
+    void * value; // for the client to get the values
+    size_t maxlen;
+    Variable () = delete;
+    Variable (VariableType vtype, void * ptr) : vtype(vtype), current_index(0),
+        best_index(0), value(ptr), maxlen(0) { }
+    void set_current_value() {
+        if (vtype == VariableType::doubletype) {
+            *((double*)(value)) = dvalues[current_index];
+        }
+        else if (vtype == VariableType::longtype) {
+            *((long*)(value)) = lvalues[current_index];
+        }
+        else {
+            *((const char**)(value)) = svalues[current_index].c_str();
+        }
+    }
+    size_t get_random_index() {
+        return (rand() % maxlen);
+    }
+    /* Numeric values are ordered, so nearby values have similar costs.
+     * Strings are just categories. */
+    bool is_ordinal() const {
+        return vtype != VariableType::stringtype;
+    }
+    void save_best() { best_index = current_index; }
+    void set_init() {
+        maxlen = (std::max(std::max(dvalues.size(),
+            lvalues.size()), svalues.size()));
+        current_index = 0;
+        set_current_value();
+    }
+    std::string getBest() {
+        if (vtype == VariableType::doubletype) {
+            *((double*)(value)) = dvalues[best_index];
+            return std::to_string(dvalues[best_index]);
+        }
+        else if (vtype == VariableType::longtype) {
+            *((long*)(value)) = lvalues[best_index];
+            return std::to_string(lvalues[best_index]);
+        }
+        //else if (vtype == VariableType::stringtype) {
+        *((const char**)(value)) = svalues[best_index].c_str();
+        return svalues[best_index];
+    }
+    std::string toString() { return toString(current_index); }
+    std::string toString(size_t index) {
+        if (vtype == VariableType::doubletype) {
+            return std::to_string(dvalues[index]);
+        }
+        else if (vtype == VariableType::longtype) {
+            return std::to_string(lvalues[index]);
+        }
+        //else if (vtype == VariableType::stringtype) {
+        return svalues[index];
+        //}
+    }
+};
+
+/* One setting of all of the variables, in the order of the variable map,
+ * and its cost once it has been evaluated. */
+struct candidate {
+    std::vector<size_t> indexes;
+    double cost;
+};
+
+/* A Tree-structured Parzen Estimator (Bergstra et al., 2011).  After a few
+ * random settings, the evaluated settings are split into the best quarter
+ * and the rest, and each variable gets a density for each group.  New
+ * settings are sampled from the "good" densities, and the one that is the
+ * most likely to be good instead of bad is evaluated next.  The model
+ * learns which values matter, so it needs far fewer evaluations than
+ * the other searches - tens instead of hundreds. */
+class BayesianSearch {
+private:
+    double best_cost;
+    size_t kmax;
+    size_t k;
+    std::map<std::string, Variable> vars;
+    const size_t max_iterations{50};
+    const size_t startup_iterations{10};
+    const size_t num_samples{24};
+    const double gamma{0.25}; // fraction of the history that is "good"
+    const double explore{0.25}; // fraction of values sampled uniformly
+    const double local{0.25}; // fraction of settings near the best one
+    const size_t max_stable_iterations{20};
+    size_t num_stable_iterations;
+    std::vector<candidate> history;
+    bool is_new(const candidate& c);
+    size_t startup(void) {
+        // we need a few observations before the model is worth anything
+        return std::max(size_t(2), std::min(startup_iterations, kmax / 2));
+    }
+    candidate propose(void);
+    bool perturb_best(candidate& c);
+    std::vector<double> density(const Variable& v, size_t index,
+        std::vector<candidate>::const_iterator begin,
+        std::vector<candidate>::const_iterator end);
+    void record(const candidate& c);
+public:
+    void evaluate(double new_cost);
+    BayesianSearch() :
+        kmax(0), k(1), num_stable_iterations(0) {
+        best_cost = std::numeric_limits<double>::max();
+        //std::cout << "New Session!" << std::endl;
+        //srand (1);
+        srand (time(NULL));
+    }
+    bool converged() {
+        // if we haven't improved for a while, quit
+        if (num_stable_iterations >= max_stable_iterations) {
+            return true;
+        }
+        return (k > kmax);
+    }
+    void getNewSettings();
+    void saveBestSettings() {
+        for (auto& v : vars) { v.second.getBest(); }
+    }
+    void printBestSettings() {
+        std::string d("[");
+        for (auto v : vars) {
+            std::cout << d << v.second.getBest();
+            d = ",";
+        }
+        std::cout << "]" << std::endl;
+    }
+    size_t get_max_iterations();
+    std::map<std::string, Variable>& get_vars() { return vars; }
+    void add_var(std::string name, Variable var) {
+        vars.insert(std::make_pair(name, var));
+        kmax = get_max_iterations();
+        /* get max iterations */
+        //std::cout << "Max iterations : " << kmax << std::endl;
+    }
+};
+
+} // bayesian
+
+} // apex
@@ -58,6 +58,13 @@ public:
   concurrency_handler (unsigned int period);
   concurrency_handler (unsigned int period, int option);
   ~concurrency_handler (void);
+  listener_mask subscriptions(void) const {
+    return APEX_LISTEN(LISTEN_SHUTDOWN) | APEX_LISTEN(LISTEN_DUMP) |
+        APEX_LISTEN(LISTEN_RESET) | APEX_LISTEN(LISTEN_NEW_THREAD) |
+        APEX_LISTEN(LISTEN_EXIT_THREAD) | APEX_LISTEN(LISTEN_START) |
+        APEX_LISTEN(LISTEN_STOP) | APEX_LISTEN(LISTEN_YIELD) |
+        APEX_LISTEN(LISTEN_RESUME);
+  }
   void on_startup(startup_event_data &data) { APEX_UNUSED(data); };
   void on_dump(dump_event_data &data);
   void on_reset(task_identifier * id);
@@ -10,6 +10,7 @@
 #include "utils.hpp"
 #include <iomanip>
 #include <sstream>
+#include <bitset>
 #include <math.h>
 #include "apex_assert.h"
 #include "apex.hpp"
@@ -19,52 +20,164 @@ namespace apex {
 namespace dependency {
 
 // declare an instance of the statics
-std::mutex Node::treeMutex;
+std::mutex Node::metricMutex;
 std::atomic<size_t> Node::nodeCount{0};
+std::atomic<size_t> Node::nextIndex{0};
 std::set<std::string> Node::known_metrics;
 
-Node* Node::appendChild(task_identifier* c) {
-    treeMutex.lock();
-    auto iter = children.find(*c);
-    if (iter == children.end()) {
-        auto n = new Node(c,this);
-        //std::cout << "Inserting " << c->get_name() << std::endl;
-        children.insert(std::make_pair(*c,n));
-        treeMutex.unlock();
+/* std::atomic<double> has no fetch_add before C++20 */
+static inline void atomic_add(std::atomic<double>& a, double value) {
+    double old = a.load(std::memory_order_relaxed);
+    while (!a.compare_exchange_weak(old, old + value,
+        std::memory_order_relaxed)) {}
+}
+
+std::mutex thread_bitmap::overflowMutex;
+
+void thread_bitmap::insert(uint64_t id) {
+    if (id >= words * 64 * max_blocks) {
+        std::unique_lock<std::mutex> l(overflowMutex);
+        if (overflow.load(std::memory_order_relaxed) == nullptr) {
+            overflow.store(new std::set<uint64_t>(), std::memory_order_relaxed);
+        }
+        overflow.load(std::memory_order_relaxed)->insert(id);
+        return;
+    }
+    block * b = &head;
+    while (id >= words * 64) {
+        block * next = b->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            block * tmp = new block();
+            if (b->next.compare_exchange_strong(next, tmp,
+                std::memory_order_acq_rel)) {
+                next = tmp;
+            } else {
+                delete tmp;
+            }
+        }
+        b = next;
+        id -= words * 64;
+    }
+    std::atomic<uint64_t>& word = b->bits[id / 64];
+    uint64_t mask = 1ULL << (id % 64);
+    // the bit is almost always set already, don't write the cache line
+    if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+        word.fetch_or(mask, std::memory_order_relaxed);
+    }
+}
+
+size_t thread_bitmap::size() const {
+    size_t total = 0;
+    const block * b = &head;
+    while (b != nullptr) {
+        for (size_t i = 0 ; i < words ; i++) {
+            total += std::bitset<64>(
+                b->bits[i].load(std::memory_order_relaxed)).count();
+        }
+        b = b->next.load(std::memory_order_acquire);
+    }
+    std::unique_lock<std::mutex> l(overflowMutex);
+    if (overflow.load(std::memory_order_relaxed) != nullptr) {
+        total += overflow.load(std::memory_order_relaxed)->size();
+    }
+    return total;
+}
+
+Node::~Node() {
+    std::atomic<Node*>* buckets = children.load();
+    if (buckets == nullptr) { return; }
+    for (size_t i = 0 ; i < child_buckets ; i++) {
+        Node * c = buckets[i].load();
+        while (c != nullptr) {
+            Node * tmp = c->next_sibling;
+            delete c;
+            c = tmp;
+        }
+    }
+    delete[] buckets;
+}
+
+std::atomic<Node*>& Node::getBucket(uint32_t id) {
+    std::atomic<Node*>* buckets = children.load(std::memory_order_acquire);
+    if (buckets == nullptr) {
+        std::atomic<Node*>* tmp = new std::atomic<Node*>[child_buckets];
+        for (size_t i = 0 ; i < child_buckets ; i++) {
+            tmp[i].store(nullptr, std::memory_order_relaxed);
+        }
+        if (children.compare_exchange_strong(buckets, tmp,
+            std::memory_order_acq_rel)) {
+            buckets = tmp;
+        } else {
+            delete[] tmp;
+        }
+    }
+    return buckets[id % child_buckets];
+}
+
+Node* Node::findChild(Node* first, uint32_t id) {
+    for (Node * c = first ; c != nullptr ; c = c->next_sibling) {
+        if (c->data->id == id) { return c; }
+    }
+    return nullptr;
+}
+
+Node* Node::findOrAppendChild(task_identifier* c, bool increment) {
+    std::atomic<Node*>& bucket = getBucket(c->id);
+    Node * first = bucket.load(std::memory_order_acquire);
+    Node * n = findChild(first, c->id);
+    if (n != nullptr) {
+        if (increment) { n->count++; }
         return n;
     }
-    iter->second->count++;
-    treeMutex.unlock();
-    return iter->second;
+    n = new Node(c,this);
+    // the index has to be set before the node is published
+    n->index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+        n->next_sibling = first;
+        if (bucket.compare_exchange_weak(first, n,
+            std::memory_order_release, std::memory_order_acquire)) {
+            nodeCount.fetch_add(1, std::memory_order_relaxed);
+            return n;
+        }
+        // another thread added a child to this bucket, is it this one?
+        Node * other = findChild(first, c->id);
+        if (other != nullptr) {
+            delete n;
+            if (increment) { other->count++; }
+            return other;
+        }
+    }
+}
+
+Node* Node::appendChild(task_identifier* c) {
+    return findOrAppendChild(c, true);
 }
 
+/* Children are never unlinked, because other threads may be walking the
+ * list.  A child with no more references is left out of the output, the
+ * same as if it had been removed. */
 Node* Node::replaceChild(task_identifier* old_child, task_identifier* new_child) {
-    treeMutex.lock();
-    auto olditer = children.find(*old_child);
-    // not found? shouldn't happen...
-    if (olditer == children.end()) {
-        auto n = new Node(new_child,this);
-        //std::cout << "Inserting " << new_child->get_name() << std::endl;
-        children.insert(std::make_pair(*new_child,n));
-        treeMutex.unlock();
-        return n;
+    std::atomic<Node*>& bucket = getBucket(old_child->id);
+    Node * old = findChild(bucket.load(std::memory_order_acquire),
+        old_child->id);
+    if (old != nullptr && old->count > 0) {
+        old->count--;
     }
-    olditer->second->count--;
-    // if no more references to this node, delete it.
-    if (olditer->second->count == 0) {
-        children.erase(*old_child);
-    }
-    auto newiter = children.find(*new_child);
-    // not found? shouldn't happen...
-    if (newiter == children.end()) {
-        auto n = new Node(new_child,this);
-        //std::cout << "Inserting " << new_child->get_name() << std::endl;
-        children.insert(std::make_pair(*new_child,n));
-        treeMutex.unlock();
-        return n;
+    return findOrAppendChild(new_child, false);
+}
+
+/* The children that are still referenced, for the output. */
+std::vector<Node*> Node::getChildren() {
+    std::vector<Node*> out;
+    std::atomic<Node*>* buckets = children.load(std::memory_order_acquire);
+    if (buckets == nullptr) { return out; }
+    for (size_t i = 0 ; i < child_buckets ; i++) {
+        for (Node * c = buckets[i].load(std::memory_order_acquire) ;
+             c != nullptr ; c = c->next_sibling) {
+            if (c->count > 0) { out.push_back(c); }
+        }
     }
-    treeMutex.unlock();
-    return newiter->second;
+    return out;
 }
 
 void Node::writeNode(std::ofstream& outfile, double total) {
@@ -109,14 +222,14 @@ void Node::writeNode(std::ofstream& outfile, double total) {
 
     // do all the children
     depth++;
-    for (auto c : children) {
-        c.second->writeNode(outfile, total);
+    for (auto c : getChildren()) {
+        c->writeNode(outfile, total);
     }
     depth--;
 }
 
-bool cmp(std::pair<task_identifier, Node*>& a, std::pair<task_identifier, Node*>& b) {
-    return a.second->getAccumulated() > b.second->getAccumulated();
+bool cmp(Node* a, Node* b) {
+    return a->getAccumulated() > b->getAccumulated();
 }
 
 double Node::writeNodeASCII(std::ofstream& outfile, double total, size_t indent) {
@@ -152,19 +265,16 @@ double Node::writeNodeASCII(std::ofstream& outfile, double total, size_t indent)
     outfile << std::endl;
 
     // sort the children by accumulated time
-    std::vector<std::pair<task_identifier, Node*> > sorted;
-    for (auto& it : children) {
-        sorted.push_back(it);
-    }
+    std::vector<Node*> sorted(getChildren());
     sort(sorted.begin(), sorted.end(), cmp);
 
     // do all the children
     double remainder = acc;
     for (auto c : sorted) {
-        double tmp = c.second->writeNodeASCII(outfile, total, indent);
+        double tmp = c->writeNodeASCII(outfile, total, indent);
         remainder = remainder - tmp;
     }
-    if (children.size() > 0 && remainder > 0.0) {
+    if (sorted.size() > 0 && remainder > 0.0) {
         for (size_t i = 0 ; i < indent ; i++) {
             outfile << "| ";
         }
@@ -196,9 +306,10 @@ double Node::writeNodeJSON(std::ofstream& outfile, double total, size_t indent)
         total : std::min(total, getAccumulated());
 
     // solve for the exclusive
+    std::vector<Node*> kids(getChildren());
     double excl = acc;
-    for (auto c : children) {
-        excl = excl - c.second->getAccumulated();
+    for (auto c : kids) {
+        excl = excl - c->getAccumulated();
     }
     if (excl < 0.0) {
         excl = 0.0;
@@ -215,10 +326,18 @@ double Node::writeNodeJSON(std::ofstream& outfile, double total, size_t indent)
             << ", \"min (inc)\": " << getMinimum()
             << ", \"max (inc)\": " << getMaximum()
             << ", \"sumsqr (inc)\": " << getSumSquares()
-            << ", \"calls\": " << ncalls << "}";
+            << ", \"calls\": " << ncalls;
+    for (auto& x : metric_map) {
+        const auto& d = x.second.distribution;
+        outfile << ", \"" << x.first << "\": " << x.second.prof.accumulated
+                << ", \"" << x.first << " (p50)\": " << d.quantile(0.5)
+                << ", \"" << x.first << " (p90)\": " << d.quantile(0.9)
+                << ", \"" << x.first << " (p99)\": " << d.quantile(0.99);
+    }
+    outfile << "}";
 
     // if no children, we are done
-    if (children.size() == 0) {
+    if (kids.size() == 0) {
         outfile << " }";
         return acc;
     }
@@ -229,10 +348,10 @@ double Node::writeNodeJSON(std::ofstream& outfile, double total, size_t indent)
     // do all the children
     double children_total = 0.0;
     bool first = true;
-    for (auto c : children) {
+    for (auto c : kids) {
         if (!first) { outfile << ",\n"; }
         first = false;
-        double tmp = c.second->writeNodeJSON(outfile, total, indent);
+        double tmp = c->writeNodeJSON(outfile, total, indent);
         children_total = children_total + tmp;
     }
     // close the list
@@ -249,7 +368,8 @@ void Node::writeTAUCallpath(std::ofstream& outfile, std::string prefix) {
     static size_t depth = 0;
 
     // if we have no children, and there's no prefix, do nothing.
-    if (prefix.size() == 0 && children.size() == 0) { return ; }
+    std::vector<Node*> kids(getChildren());
+    if (prefix.size() == 0 && kids.size() == 0) { return ; }
 
     // get the inclusive amount for this timer
     double acc = (getAccumulated() * 1000000) / getThreads(); // stored in seconds, we need to convert to microseconds
@@ -266,10 +386,10 @@ void Node::writeTAUCallpath(std::ofstream& outfile, std::string prefix) {
         // compute our exclusive time
         double child_time = 0;
         double child_calls = 0;
-        for (auto c : children) {
-            double tmp = (c.second->getAccumulated() * 1000000) / c.second->getThreads();
+        for (auto c : kids) {
+            double tmp = (c->getAccumulated() * 1000000) / c->getThreads();
             child_time = child_time + tmp;
-            tmp = c.second->getCalls() / c.second->getThreads();
+            tmp = c->getCalls() / c->getThreads();
             child_calls = child_calls + tmp;
         }
         double remainder = 0;
@@ -308,8 +428,8 @@ void Node::writeTAUCallpath(std::ofstream& outfile, std::string prefix) {
 
     // recursively do a depth-first writing of all the children and subchildren...
     depth++;
-    for (auto c : children) {
-        c.second->writeTAUCallpath(outfile, child_prefix);
+    for (auto c : kids) {
+        c->writeTAUCallpath(outfile, child_prefix);
     }
     depth--;
 
@@ -318,23 +438,23 @@ void Node::writeTAUCallpath(std::ofstream& outfile, std::string prefix) {
 
 void Node::addAccumulated(double value, double incl, bool is_resume, uint64_t thread_id,
     double values[8], int num_papi_counters) {
-    static std::mutex m;
-    m.lock();
     if (!is_resume) {
-        getCalls()+=1;
-        inclusive = inclusive + incl;
+        atomic_add(calls, 1.0);
+        atomic_add(inclusive, incl);
     }
-    getAccumulated() = getAccumulated() + value;
-    if (getMinimum() == 0.0 || value < getMinimum()) { getMinimum() = value; }
-    if (value > getMaximum()) { getMaximum() = value; }
-    getSumSquares() = getSumSquares() + (value*value);
+    atomic_add(accumulated, value);
+    double tmp = minimum.load(std::memory_order_relaxed);
+    while ((tmp == 0.0 || value < tmp) &&
+        !minimum.compare_exchange_weak(tmp, value, std::memory_order_relaxed)) {}
+    tmp = maximum.load(std::memory_order_relaxed);
+    while (value > tmp &&
+        !maximum.compare_exchange_weak(tmp, value, std::memory_order_relaxed)) {}
+    atomic_add(sum_squares, value*value);
     thread_ids.insert(thread_id);
     /* Add the papi measurements */
     for (int i = 0 ; i < num_papi_counters ; i++) {
-        prof.papi_metrics[i] += values[i];
+        atomic_add(papi_metrics[i], values[i]);
     }
-
-    m.unlock();
 }
 
 double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id, int num_papi_counters) {
@@ -366,13 +486,13 @@ double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id,
     outfile << stddev;
     // write the papi metrics
     for (int m = 0 ; m < num_papi_counters ; m++) {
-        outfile << "," << prof.papi_metrics[m];
+        outfile << "," << papi_metrics[m].load();
     }
 
     // write any available metrics
     for (auto& x : known_metrics) {
         if (metric_map.find(x) == metric_map.end()) {
-            outfile << ",,,,,,,";
+            outfile << ",,,,,,,,,";
         } else {
             const auto& value = metric_map.find(x);
             const auto& p = value->second.prof;
@@ -388,33 +508,19 @@ double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id,
             variance = std::max(0.0,(t3));
             stddev = sqrt(variance);
             outfile << "," << stddev;
-            // find the median
-            auto& d = value->second.distribution;
-            // how many do we have?
-            size_t total = 0;
-            double mode = 0;
-            double median = 0;
-            size_t half = (size_t)(ncalls/2.0);
-            size_t most = 0;
-            for (auto& node : d) {
-                total += node.second;
-                if (total >= half) { median = node.first; break; }
-            }
-            for (auto& node : d) {
-                if (node.second > most) { mode = node.first; }
-            }
-            outfile << "," << median;
-            outfile << "," << mode;
+            // the median, mode and tail, from the sketch
+            const auto& d = value->second.distribution;
+            outfile << "," << d.quantile(0.5);
+            outfile << "," << d.mode();
+            outfile << "," << d.quantile(0.9);
+            outfile << "," << d.quantile(0.99);
         }
     }
     // end the line
     outfile << std::endl;
 
     // sort the children by name to make tree merging easier (I hope)
-    std::vector<Node*> sorted;
-    for (auto& it : children) {
-        sorted.push_back(it.second);
-    }
+    std::vector<Node*> sorted(getChildren());
     sort(sorted.begin(), sorted.end(), Node::compareNodeByParentName);
 
     // do all the children
@@ -431,16 +537,12 @@ double Node::writeNodeCSV(std::stringstream& outfile, double total, int node_id,
 }
 
 void Node::addMetrics(std::map<std::string, double>& _metric_map) {
-    static std::mutex m;
+    // only timers with extra metrics get here, they can take a lock
+    std::unique_lock<std::mutex> l(metricMutex);
     for (auto& x: _metric_map) {
         std::string name{x.first};
         double value{x.second};
-        if (known_metrics.find(name) == known_metrics.end()) {
-            m.lock();
-            known_metrics.insert(name);
-            m.unlock();
-        }
-        m.lock();
+        known_metrics.insert(name);
         if (metric_map.find(name) == metric_map.end()) {
             metricStorage newval(value);
             metric_map.emplace(name, std::move(newval));
@@ -448,7 +550,6 @@ void Node::addMetrics(std::map<std::string, double>& _metric_map) {
             auto element = metric_map.find(name);
             element->second.increment(value);
         }
-        m.unlock();
     }
 }
 
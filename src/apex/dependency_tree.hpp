@@ -14,8 +14,10 @@
 #include <atomic>
 #include <set>
 #include <map>
+#include <vector>
 #include "apex_types.h"
 #include "task_identifier.hpp"
+#include "quantile_sketch.hpp"
 
 namespace apex {
 
@@ -24,76 +26,118 @@ namespace dependency {
 class metricStorage {
 public:
     apex_profile prof;
-    std::map<double, size_t> distribution;
+    /* bounded, unlike a map of every distinct value */
+    quantile_sketch distribution;
     metricStorage(double value) {
         prof.accumulated = value;
         prof.maximum = value;
         prof.minimum = value;
         prof.sum_squares = value*value;
-        distribution[value] = 1;
+        distribution.add(value);
     }
     void increment(double value) {
         prof.accumulated += value;
         prof.maximum = std::max<double>(prof.maximum, value);
         prof.minimum = std::min<double>(prof.minimum, value);
         prof.sum_squares += value*value;
-        if (distribution.find(value) == distribution.end()) {
-            distribution[value] = 1;
-        } else {
-            distribution[value] += 1;
-        }
+        distribution.add(value);
     }
 };
 
+/* The set of threads that have executed a node, as a bitmap indexed by
+ * the APEX thread id.  Blocks are added as higher ids are seen, without
+ * locking.  Ids past the last block (like UINT_MAX, for a thread APEX
+ * doesn't know) go in a set, under a lock. */
+class thread_bitmap {
+    private:
+        static constexpr size_t words = 4; // 256 threads per block
+        static constexpr size_t max_blocks = 64;
+        struct block {
+            std::atomic<uint64_t> bits[words];
+            std::atomic<block*> next;
+            block() : next(nullptr) {
+                for (auto& b : bits) { b.store(0, std::memory_order_relaxed); }
+            }
+        };
+        block head;
+        std::atomic<std::set<uint64_t>*> overflow;
+        static std::mutex overflowMutex;
+    public:
+        thread_bitmap() : overflow(nullptr) {}
+        ~thread_bitmap() {
+            block * b = head.next.load();
+            while (b != nullptr) {
+                block * tmp = b->next.load();
+                delete b;
+                b = tmp;
+            }
+            delete overflow.load();
+        }
+        void insert(uint64_t id);
+        size_t size() const;
+};
+
 class Node {
     private:
         task_identifier* data;
         Node* parent;
-        size_t count;
-        apex_profile prof;
-        //double calls;
-        //double accumulated;
-        //double min;
-        //double max;
-        //double sumsqr;
-        double inclusive;
+        std::atomic<size_t> count;
+        /* The statistics are updated by any thread without locking, so
+         * the tree costs about the same as a flat profile.  The output
+         * reads them when the processing is done. */
+        std::atomic<double> calls;
+        std::atomic<double> accumulated;
+        std::atomic<double> minimum;
+        std::atomic<double> maximum;
+        std::atomic<double> sum_squares;
+        std::atomic<double> inclusive;
+        std::atomic<double> papi_metrics[8];
         size_t index;
-        std::set<uint64_t> thread_ids;
-        std::unordered_map<task_identifier, Node*> children;
+        thread_bitmap thread_ids;
+        /* The children are in a small hash table of lock-free lists,
+         * keyed by the interned task id.  The table is allocated with
+         * the first child, and children are never removed while the
+         * tree is in use - see replaceChild(). */
+        static constexpr size_t child_buckets = 64;
+        std::atomic<std::atomic<Node*>*> children;
+        Node* next_sibling;
         // map for arbitrary metrics
         std::map<std::string, metricStorage> metric_map;
-        static std::mutex treeMutex;
+        static std::mutex metricMutex;
         static std::atomic<size_t> nodeCount;
+        // unlike nodeCount, this skips the index of a node that loses a race
+        static std::atomic<size_t> nextIndex;
         static std::set<std::string> known_metrics;
+        std::atomic<Node*>& getBucket(uint32_t id);
+        Node* findChild(Node* first, uint32_t id);
+        Node* findOrAppendChild(task_identifier* c, bool increment);
+        std::vector<Node*> getChildren();
     public:
         Node(task_identifier* id, Node* p) :
-            data(id), parent(p), count(1), inclusive(0),
-            index(nodeCount.fetch_add(1, std::memory_order_relaxed)) {
-            prof.calls = 0.0;
-            prof.accumulated = 0.0;
-            prof.minimum = 0.0;
-            prof.maximum = 0.0;
-            prof.sum_squares = 0.0;
-            memset(prof.papi_metrics, 0, sizeof(double)*8);
-        }
-        ~Node() {
-            treeMutex.lock();
-            for (auto c : children) {
-                delete c.second;
+            data(id), parent(p), count(1), calls(0.0), accumulated(0.0),
+            minimum(0.0), maximum(0.0), sum_squares(0.0), inclusive(0.0),
+            index(0), children(nullptr), next_sibling(nullptr) {
+            for (auto& m : papi_metrics) {
+                m.store(0.0, std::memory_order_relaxed);
+            }
+            // children are counted when they are added to the tree
+            if (p == nullptr) {
+                index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+                nodeCount.fetch_add(1, std::memory_order_relaxed);
             }
-            treeMutex.unlock();
         }
+        ~Node();
         Node* appendChild(task_identifier* c);
         Node* replaceChild(task_identifier* old_child, task_identifier* new_child);
         task_identifier* getData() { return data; }
         Node* getParent() { return parent; }
         size_t getCount() { return count; }
-        inline double& getCalls() { return prof.calls; }
-        inline double& getAccumulated() { return prof.accumulated; }
+        inline double getCalls() { return calls; }
+        inline double getAccumulated() { return accumulated; }
         inline double getThreads() { return (double)thread_ids.size(); }
-        inline double& getMinimum() { return prof.minimum; }
-        inline double& getMaximum() { return prof.maximum; }
-        inline double& getSumSquares() { return prof.sum_squares; }
+        inline double getMinimum() { return minimum; }
+        inline double getMaximum() { return maximum; }
+        inline double getSumSquares() { return sum_squares; }
         void addAccumulated(double value, double incl, bool is_resume, uint64_t thread_id,
             double values[8], int num_papi_counters);
         size_t getIndex() { return index; };
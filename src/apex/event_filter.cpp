@@ -10,11 +10,12 @@
 #include "event_filter.hpp"
 #include <regex>
 #include <iostream>
+#include <algorithm>
 #include <rapidjson/istreamwrapper.h>
 
 namespace apex {
 
-event_filter::event_filter() : have_filter(false) {
+event_filter::event_filter() : have_filter(false), have_include(false) {
     try {
         std::ifstream cfg(apex_options::task_event_filter_file());
         if (!cfg.good()) {
@@ -24,6 +25,10 @@ event_filter::event_filter() : have_filter(false) {
         rapidjson::IStreamWrapper file_wrapper(cfg);
         configuration.ParseStream(file_wrapper);
         cfg.close();
+        if (!configuration.IsObject()) { return; }
+        exclude_patterns = compile("exclude");
+        include_patterns = compile("include");
+        have_include = configuration.HasMember("include");
         have_filter = true;
     } catch (...) {
         // fail silently, nothing to do but use defaults
@@ -78,54 +83,96 @@ void handle_error(std::regex_error& e) {
     }
 }
 
-bool event_filter::_exclude(const std::string &name) {
-    // check if this timer should be explicitly ignored
-    if (configuration.HasMember("exclude")) {
-        auto & exclude_filter = configuration["exclude"];
-        for(auto itr = exclude_filter.Begin(); itr != exclude_filter.End(); ++itr) {
-            std::string needle(itr->GetString());
-            needle.erase(std::remove(needle.begin(),needle.end(),'\"'),needle.end());
-            try {
-                std::regex re(needle);
-                std::string haystack(name);
-                if (std::regex_search(haystack, re)) {
-                    return true;
-                }
-            } catch (std::regex_error& e) {
-                std::cerr << "Error: '" << e.what() << "' in regular expression: "
-                          << needle << std::endl;
-                handle_error(e);
+/* Compile the patterns in one of the lists.  The patterns are combined
+ * into one alternation, so that each name is searched once - except for
+ * the ones with back references, because their group numbers would
+ * change, so they are kept separate. */
+std::vector<std::regex> event_filter::compile(const char * list) {
+    std::vector<std::regex> patterns;
+    if (!configuration.HasMember(list) || !configuration[list].IsArray()) {
+        return patterns;
+    }
+    static const std::regex backref("\\\\[1-9]");
+    std::string combined;
+    auto & filter = configuration[list];
+    for(auto itr = filter.Begin(); itr != filter.End(); ++itr) {
+        if (!itr->IsString()) { continue; }
+        std::string needle(itr->GetString());
+        needle.erase(std::remove(needle.begin(),needle.end(),'\"'),needle.end());
+        try {
+            // compile it alone first, so errors name the bad pattern
+            std::regex re(needle);
+            if (std::regex_search(needle, backref)) {
+                patterns.push_back(re);
+                continue;
             }
+        } catch (std::regex_error& e) {
+            std::cerr << "Error: '" << e.what() << "' in regular expression: "
+                      << needle << std::endl;
+            handle_error(e);
+            continue;
         }
-        // not found in the exclude filters
-        // ...but don't assume anything yet - check for include list
+        if (!combined.empty()) { combined.append("|"); }
+        combined.append("(?:").append(needle).append(")");
     }
-    // check if this timer should be implicitly ignored
-    if (configuration.HasMember("include")) {
-        auto & include_filter = configuration["include"];
-        for(auto itr = include_filter.Begin(); itr != include_filter.End(); ++itr) {
-            std::string needle(itr->GetString());
-            needle.erase(std::remove(needle.begin(),needle.end(),'\"'),needle.end());
-            try {
-                std::regex re(needle);
-                std::string haystack(name);
-                if (std::regex_search(haystack, re)) {
-                    return false;
-                }
-            } catch (std::regex_error& e) {
-                std::cerr << "Error: '" << e.what() << "' in regular expression: "
-                          << needle << std::endl;
-                handle_error(e);
-            }
+    if (!combined.empty()) {
+        try {
+            patterns.insert(patterns.begin(), std::regex(combined,
+                std::regex::ECMAScript | std::regex::optimize));
+        } catch (std::regex_error& e) {
+            std::cerr << "Error: '" << e.what() << "' in regular expression: "
+                      << combined << std::endl;
+            handle_error(e);
+        }
+    }
+    return patterns;
+}
+
+bool event_filter::matches(const std::vector<std::regex>& patterns,
+    const std::string& name) {
+    for (auto& re : patterns) {
+        if (std::regex_search(name, re)) {
+            return true;
         }
-        // not found in the whitelist
+    }
+    return false;
+}
+
+bool event_filter::_exclude(const std::string &name) {
+    // check if this timer should be explicitly ignored
+    if (matches(exclude_patterns, name)) {
         return true;
     }
+    // not found in the exclude filters
+    // ...but don't assume anything yet - check for include list
+    if (have_include) {
+        // if not found in the whitelist, ignore it
+        return !matches(include_patterns, name);
+    }
     return false; // no filters
 }
 
+bool event_filter::_exclude(task_identifier * id) {
+    /* The decision for each task identifier, indexed by the interned id.
+     * Each thread has its own copy, so there is nothing to lock. */
+    enum : uint8_t { unknown = 0, included, excluded };
+    static APEX_NATIVE_TLS std::vector<uint8_t> decisions;
+    if (id->id >= decisions.size()) {
+        decisions.resize(id->id + 1024, unknown);
+    }
+    uint8_t& decision = decisions[id->id];
+    if (decision == unknown) {
+        decision = _exclude(id->get_name()) ? excluded : included;
+    }
+    return decision == excluded;
+}
+
 bool event_filter::exclude(const std::string &name) {
-    return instance()._exclude(name);
+    return instance()._exclude(task_identifier::get_task_id(name));
+}
+
+bool event_filter::exclude(task_identifier * id) {
+    return instance()._exclude(id);
 }
 
 event_filter& event_filter::instance(void) {
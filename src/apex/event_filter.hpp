@@ -10,14 +10,22 @@
 
 #include "apex.hpp"
 #include "apex_options.hpp"
+#include "task_identifier.hpp"
+#include <regex>
+#include <vector>
 #include <rapidjson/document.h>
 #include <rapidjson/istreamwrapper.h>
 
 namespace apex {
 
+/* Decides which timers are measured, from the include and exclude lists
+ * of regular expressions in the filter file.  The patterns are compiled
+ * once, and the decision is made once per task identifier - after that,
+ * it is a lookup in a per-thread table indexed by the interned id. */
 class event_filter {
 public:
     static bool exclude(const std::string &name);
+    static bool exclude(task_identifier * id);
     static event_filter& instance(void);
     bool have_filter;
 private:
@@ -29,8 +37,15 @@ private:
     event_filter(event_filter const&)    = delete;
     void operator=(event_filter const&)  = delete;
     bool _exclude(const std::string &name);
+    bool _exclude(task_identifier * id);
+    std::vector<std::regex> compile(const char * list);
+    static bool matches(const std::vector<std::regex>& patterns,
+        const std::string& name);
     static event_filter * _instance;
     rapidjson::Document configuration;
+    std::vector<std::regex> exclude_patterns;
+    std::vector<std::regex> include_patterns;
+    bool have_include;
 };
 
 }
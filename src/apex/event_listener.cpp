@@ -51,12 +51,30 @@ sample_value_event_data::sample_value_event_data(int thread_id,
   this->is_counter = true;
   this->thread_id = thread_id;
   this->counter_name = new string(counter_name);
+  this->counter_id = nullptr;
   this->counter_value = counter_value;
   this->is_threaded = threaded;
+  this->owns_name = true;
+}
+
+/* The name belongs to the counter registry, and outlives the event. */
+sample_value_event_data::sample_value_event_data(int thread_id,
+    string * counter_name, task_identifier * counter_id,
+    double counter_value, bool threaded) {
+  this->event_type_ = APEX_SAMPLE_VALUE;
+  this->is_counter = true;
+  this->thread_id = thread_id;
+  this->counter_name = counter_name;
+  this->counter_id = counter_id;
+  this->counter_value = counter_value;
+  this->is_threaded = threaded;
+  this->owns_name = false;
 }
 
 sample_value_event_data::~sample_value_event_data() {
-  delete(counter_name);
+  if (owns_name) {
+    delete(counter_name);
+  }
 }
 
 custom_event_data::custom_event_data(apex_event_type event_type,
@@ -10,6 +10,9 @@
 
 #include <string>
 #include <memory>
+#include <vector>
+#include <array>
+#include <cstdint>
 #include "apex_types.h"
 #include "profiler.hpp"
 #include "task_identifier.hpp"
@@ -62,10 +65,15 @@ public:
 class sample_value_event_data : public event_data {
 public:
   std::string * counter_name;
+  /* set for registered counters, so the name doesn't have to be looked up */
+  task_identifier * counter_id;
   double counter_value;
   bool is_threaded;
   bool is_counter;
+  bool owns_name;
   sample_value_event_data(int thread_id, std::string counter_name, double counter_value, bool threaded);
+  sample_value_event_data(int thread_id, std::string * counter_name,
+    task_identifier * counter_id, double counter_value, bool threaded);
   ~sample_value_event_data();
 };
 
@@ -132,11 +140,45 @@ public:
 
 /* Abstract class for creating an Event Listener class */
 
+/* The events a listener can subscribe to */
+enum listener_event {
+  LISTEN_STARTUP = 0,
+  LISTEN_PRE_SHUTDOWN,
+  LISTEN_SHUTDOWN,
+  LISTEN_DUMP,
+  LISTEN_RESET,
+  LISTEN_NEW_NODE,
+  LISTEN_NEW_THREAD,
+  LISTEN_EXIT_THREAD,
+  LISTEN_START,
+  LISTEN_STOP,
+  LISTEN_YIELD,
+  LISTEN_RESUME,
+  LISTEN_TASK_COMPLETE,
+  LISTEN_SAMPLE_VALUE,
+  LISTEN_PERIODIC,
+  LISTEN_CUSTOM_EVENT,
+  LISTEN_SEND,
+  LISTEN_RECV,
+  NUM_LISTENER_EVENTS
+};
+
+typedef uint32_t listener_mask;
+#define APEX_LISTEN(_event) ((::apex::listener_mask)1 << (_event))
+const listener_mask all_listener_events =
+  (((listener_mask)1) << NUM_LISTENER_EVENTS) - 1;
+
 class event_listener
 {
 public:
   // virtual destructor
   virtual ~event_listener() {};
+  /* The events this listener wants.  Events that aren't in the mask are
+   * never dispatched to the listener, so override this to skip the
+   * handlers that do nothing. */
+  virtual listener_mask subscriptions(void) const {
+    return all_listener_events;
+  }
   // all methods in the interface that a handler has to override
   virtual void on_startup(startup_event_data &data) = 0;
   virtual void on_pre_shutdown(void) = 0;
@@ -159,5 +201,15 @@ public:
   virtual void set_node_id(int node_id, int node_count) = 0;
 };
 
+/* The listeners that subscribe to each event, in the order they were
+ * added.  A table is never modified after it is published, so events are
+ * dispatched without a lock - adding a listener (or changing what it
+ * subscribes to) publishes a new table. */
+class listener_table {
+public:
+  std::array<std::vector<event_listener*>, NUM_LISTENER_EVENTS> subscribers;
+  std::vector<listener_mask> masks;
+};
+
 }
 
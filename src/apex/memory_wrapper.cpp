@@ -18,6 +18,13 @@
 #include <execinfo.h>
 #include "address_resolution.hpp"
 #include <stdio.h>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include "timer_wheel.hpp"
+#include "utils.hpp"
 
 namespace apex {
 
@@ -118,6 +125,55 @@ void printBacktrace() {
     }
 }
 
+/* Should we capture the call stack of this allocation?  This is Poisson
+ * sampling by bytes, like the tcmalloc heap profiler: each thread counts
+ * down a random number of bytes, exponentially distributed with a mean of
+ * APEX_MEMORY_SAMPLE_BYTES, and samples the allocation that reaches zero.
+ * Large allocations are almost always sampled, and small ones rarely.
+ * Returns the number of allocations the sample stands for (the inverse of
+ * the chance of sampling it), or zero if it isn't sampled. */
+static double sampleAllocation(const size_t bytes) {
+    const int period = apex_options::memory_sample_bytes();
+    if (period <= 1) { return period == 1 ? 1.0 : 0.0; }
+    // plain values, so the first allocation on a thread doesn't allocate
+    static APEX_NATIVE_TLS uint64_t state{0};
+    static APEX_NATIVE_TLS int64_t until_sample{0};
+    auto next = [&]() {
+        // xorshift64*
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        double u = ((double)((state * 0x2545F4914F6CDD1DULL) >> 11) + 1.0)
+            / 9007199254740992.0;
+        return (int64_t)(-std::log(u) * period) + 1;
+    };
+    if (state == 0) {
+        state = ((uint64_t)(uintptr_t)&state) ^ 0x9E3779B97F4A7C15ULL;
+        until_sample = next();
+    }
+    until_sample -= (int64_t)bytes;
+    if (until_sample > 0) { return 0.0; }
+    until_sample = next();
+    return 1.0 / (1.0 - std::exp(-((double)bytes) / period));
+}
+
+/* Find (or create) the site for this call stack, and count the sample */
+static allocation_site * recordSite(book_t& book, void** trace, int size,
+    const apex_allocator_t alloc, const size_t bytes, const double weight) {
+    std::string key((const char*)trace, size * sizeof(void*));
+    key.push_back((char)alloc);
+    std::unique_lock<std::mutex> l(book.siteMutex);
+    allocation_site *& site = book.sites[key];
+    if (site == nullptr) {
+        site = new allocation_site(trace, size, alloc);
+    }
+    site->allocations += weight;
+    site->bytes_allocated += weight * bytes;
+    site->live_allocations += weight;
+    site->live_bytes += weight * bytes;
+    return site;
+}
+
 void recordAlloc(const size_t bytes, const void* ptr,
     const apex_allocator_t alloc, const bool cpu) {
     if (!recording()) return;
@@ -125,15 +181,19 @@ void recordAlloc(const size_t bytes, const void* ptr,
     double value = (double)(bytes);
     if (cpu) sample_value("Memory: Bytes Allocated", value, true);
     profiler * p = thread_instance::instance().get_current_profiler();
-    record_t tmp(value, thread_instance::instance().get_id(), alloc, cpu);
+    record_t tmp(bytes, thread_instance::instance().get_id(), alloc, cpu);
     if (p != nullptr) { tmp.id = p->get_task_id(); }
-    //backtrace_record_t rec(3,tmp.backtrace);
-    //_Unwind_Backtrace (default_unwind, &(rec));
-    tmp.size = backtrace(tmp.backtrace.data(), tmp.backtrace.size());
-    book.mapMutex.lock();
-    //book.memoryMap[ptr] = value;
-    book.memoryMap.insert(std::pair<const void*,record_t>(ptr, tmp));
-    book.mapMutex.unlock();
+    double weight = sampleAllocation(bytes);
+    if (weight > 0.0) {
+        void * trace[64];
+        int size = backtrace(trace, 64);
+        tmp.weight = weight;
+        tmp.site = recordSite(book, trace, size, alloc, bytes, weight);
+    }
+    auto& shard = book.shard(ptr);
+    shard.mapMutex.lock();
+    shard.memoryMap[ptr] = std::move(tmp);
+    shard.mapMutex.unlock();
     book.totalAllocated.fetch_add(bytes, std::memory_order_relaxed);
     if (p == nullptr) {
         auto i = apex::instance();
@@ -153,18 +213,28 @@ void recordFree(const void* ptr, const bool cpu) {
     if (!recording()) return;
     static book_t& book = getBook();
     size_t bytes;
-    book.mapMutex.lock();
-    if (book.memoryMap.count(ptr) > 0) {
-        record_t& tmp = book.memoryMap[ptr];
-        bytes = tmp.bytes;
-        book.memoryMap.erase(ptr);
+    allocation_site * site;
+    double weight;
+    auto& shard = book.shard(ptr);
+    shard.mapMutex.lock();
+    auto found = shard.memoryMap.find(ptr);
+    if (found != shard.memoryMap.end()) {
+        bytes = found->second.bytes;
+        site = found->second.site;
+        weight = found->second.weight;
+        shard.memoryMap.erase(found);
     } else {
         //std::cout << std::hex << ptr << std::dec << " NOT FOUND" << std::endl;
         //printBacktrace();
-        book.mapMutex.unlock();
+        shard.mapMutex.unlock();
         return;
     }
-    book.mapMutex.unlock();
+    shard.mapMutex.unlock();
+    if (site != nullptr) {
+        std::unique_lock<std::mutex> l(book.siteMutex);
+        site->live_allocations -= weight;
+        site->live_bytes -= weight * bytes;
+    }
     double value = (double)(bytes);
     if (cpu) sample_value("Memory: Bytes Freed", value, true);
     book.totalAllocated.fetch_sub(bytes, std::memory_order_relaxed);
@@ -193,10 +263,10 @@ void recordMetric(std::string name, double value) {
 }
 
 // Comparator function to sort pairs descending, according to second value
-bool cmp(std::pair<const void*, record_t>& a,
-        std::pair<const void*, record_t>& b)
+bool cmp(const std::pair<const void*, const record_t*>& a,
+        const std::pair<const void*, const record_t*>& b)
 {
-    return a.second.bytes > b.second.bytes;
+    return a.second->bytes > b.second->bytes;
 }
 
 // Comparator function to sort pairs descending, according to second value
@@ -206,20 +276,167 @@ bool cmp2(std::pair<std::string, size_t>& a,
     return a.second > b.second;
 }
 
+/* Resolve the symbols of a site, once.  The caller holds the symbol lock. */
+static void resolveSite(allocation_site * site) {
+    if (site->resolved) { return; }
+    site->symbols.resize(site->frames.size());
+    for(size_t i = 0; i < site->frames.size(); i++ ){
+        std::string* tmp2{lookup_address(((uintptr_t)site->frames[i]), true)};
+        site->symbols[i] = *tmp2;
+        //delete tmp2;
+    }
+    site->resolved = true;
+}
+
+/* Resolve the symbols of many sites, with the addresses they have in common
+ * resolved only once, in one batch. */
+static void resolveSites(const std::vector<allocation_site*>& sites) {
+    std::vector<uintptr_t> addresses;
+    for (auto site : sites) {
+        if (site->resolved) { continue; }
+        for (auto frame : site->frames) {
+            addresses.push_back((uintptr_t)frame);
+        }
+    }
+    resolve_addresses(addresses);
+    for (auto site : sites) {
+        resolveSite(site);
+    }
+}
+
 void apex_get_leak_symbols() {
     in_apex prevent_memory_tracking;
     if (!apex_options::track_cpu_memory()) { return; }
     if (!recording()) return;
     static book_t& book = getBook();
-    for (auto& it : book.memoryMap) {
-        for(size_t i = 0; i < it.second.size; i++ ){
-            std::string* tmp2{lookup_address(((uintptr_t)it.second.backtrace[i]), true)};
-            it.second.symbols[i] = *tmp2;
-            //delete tmp2;
+    std::vector<allocation_site*> sites;
+    {
+        std::unique_lock<std::mutex> l(book.siteMutex);
+        for (auto& it : book.sites) { sites.push_back(it.second); }
+    }
+    std::unique_lock<std::mutex> l(book.symbolMutex);
+    resolveSites(sites);
+}
+
+/* The first frames of a sampled call stack are recordAlloc, the wrapper
+ * and the allocator itself. */
+static const size_t skipped_frames{3};
+
+/* Write the live heap, aggregated by allocation site.  The folded format
+ * has one line per call stack - the frames from the root down, separated
+ * by semicolons, and the live bytes - which flamegraph.pl reads, and two
+ * snapshots can be compared with difffolded.pl.  The pprof format is the
+ * text heap profile of gperftools, with the live and allocated objects and
+ * bytes of each call stack, followed by the mapped libraries. */
+void write_heap_snapshot(void) {
+    in_apex prevent_memory_tracking;
+    static book_t& book = getBook();
+    static std::atomic<size_t> sequence{0};
+    class site_stats {
+    public:
+        allocation_site * site;
+        double allocations;
+        double bytes_allocated;
+        double live_allocations;
+        double live_bytes;
+    };
+    std::vector<site_stats> stats;
+    {
+        std::unique_lock<std::mutex> l(book.siteMutex);
+        stats.reserve(book.sites.size());
+        for (auto& it : book.sites) {
+            allocation_site * site = it.second;
+            stats.push_back(site_stats{site, site->allocations,
+                site->bytes_allocated, site->live_allocations,
+                site->live_bytes});
+        }
+    }
+    std::string format(apex_options::heap_snapshot_format());
+    bool pprof = (format.compare("pprof") == 0);
+    std::stringstream filename;
+    filename << apex_options::output_file_path() << filesystem_separator()
+             << "heap_snapshot." << book.saved_node_id << "."
+             << sequence++ << (pprof ? ".heap" : ".folded");
+    std::ofstream out(filename.str());
+    if (pprof) {
+        // the biggest first, like the gperftools heap profiler
+        std::sort(stats.begin(), stats.end(),
+            [](const site_stats& a, const site_stats& b) {
+                return a.live_bytes > b.live_bytes;
+            });
+        double totals[4] = {0.0, 0.0, 0.0, 0.0};
+        for (auto& s : stats) {
+            totals[0] += s.live_allocations;
+            totals[1] += s.live_bytes;
+            totals[2] += s.allocations;
+            totals[3] += s.bytes_allocated;
+        }
+        out << "heap profile: " << std::llround(totals[0]) << ": "
+            << std::llround(totals[1]) << " [" << std::llround(totals[2])
+            << ": " << std::llround(totals[3]) << "] @ heap" << std::endl;
+        for (auto& s : stats) {
+            out << std::llround(s.live_allocations) << ": "
+                << std::llround(s.live_bytes) << " ["
+                << std::llround(s.allocations) << ": "
+                << std::llround(s.bytes_allocated) << "] @";
+            for (size_t i = skipped_frames ; i < s.site->frames.size() ; i++) {
+                out << " " << s.site->frames[i];
+            }
+            out << std::endl;
+        }
+        out << std::endl << "MAPPED_LIBRARIES:" << std::endl;
+        std::ifstream maps("/proc/self/maps");
+        out << maps.rdbuf();
+    } else {
+        // different addresses can resolve to the same names, so merge them
+        std::map<std::string, double> stacks;
+        std::unique_lock<std::mutex> l(book.symbolMutex);
+        std::vector<allocation_site*> live;
+        for (auto& s : stats) {
+            if (std::llround(s.live_bytes) > 0) { live.push_back(s.site); }
+        }
+        resolveSites(live);
+        for (auto& s : stats) {
+            if (std::llround(s.live_bytes) <= 0) { continue; }
+            std::string stack;
+            for (size_t i = s.site->frames.size() ; i > skipped_frames ; i--) {
+                std::string frame(s.site->symbols[i-1]);
+                // semicolons separate the frames, and newlines the stacks
+                std::replace(frame.begin(), frame.end(), ';', ':');
+                std::replace(frame.begin(), frame.end(), '\n', ' ');
+                stack.append(frame).append(";");
+            }
+            stack.append(allocator_strings[s.site->alloc]);
+            stacks[stack] += s.live_bytes;
+        }
+        for (auto& it : stacks) {
+            out << it.first << " " << std::llround(it.second) << std::endl;
         }
-        it.second.resolved = true;
     }
+    out.close();
+}
+
+static uint64_t& snapshotTimer(void) {
+    static uint64_t _timer{0};
+    return _timer;
+}
 
+void start_heap_snapshots(void) {
+    if (!apex_options::track_cpu_memory() &&
+        !apex_options::track_gpu_memory()) { return; }
+    int period = apex_options::heap_snapshot_period();
+    if (period <= 0 || snapshotTimer() != 0) { return; }
+    getBook().saved_node_id = apex::instance()->get_node_id();
+    snapshotTimer() = timer_wheel::instance().add(
+        (uint64_t)(period) * 1000000, write_heap_snapshot);
+}
+
+void stop_heap_snapshots(void) {
+    if (snapshotTimer() == 0) { return; }
+    timer_wheel::instance().remove(snapshotTimer());
+    snapshotTimer() = 0;
+    // and one of the heap at exit
+    write_heap_snapshot();
 }
 
 void apex_report_leaks() {
@@ -236,22 +453,35 @@ void apex_report_leaks() {
     std::string outfile{ss.str()};
     std::ofstream report (outfile);
     // Declare vector of pairs
-    std::vector<std::pair<const void*, record_t> > sorted;
-
-    if (book.saved_node_id == 0) {
-        std::cout << "APEX Memory Report: (see " << outfile << ")" << std::endl;
-        std::cout << "sorting " << book.memoryMap.size() << " leaks by size..." << std::endl;
-    }
+    std::vector<std::pair<const void*, const record_t*> > sorted;
 
     // Copy key-value pair from Map
     // to vector of pairs
-    for (auto& it : book.memoryMap) {
-        sorted.push_back(it);
+    for (auto& shard : book.shards) {
+        for (auto& it : shard.memoryMap) {
+            sorted.push_back(std::make_pair(it.first, &(it.second)));
+        }
+    }
+
+    if (book.saved_node_id == 0) {
+        std::cout << "APEX Memory Report: (see " << outfile << ")" << std::endl;
+        std::cout << "sorting " << sorted.size() << " leaks by size..." << std::endl;
     }
 
     // Sort using comparator function
     sort(sorted.begin(), sorted.end(), cmp);
 
+    // resolve the backtraces that weren't resolved yet, all at once
+    std::vector<uintptr_t> addresses;
+    for (auto& it : sorted) {
+        const allocation_site * site = it.second->site;
+        if (site == nullptr || site->resolved) { continue; }
+        for (size_t i = skipped_frames; i < site->frames.size(); i++) {
+            addresses.push_back((uintptr_t)site->frames[i]);
+        }
+    }
+    resolve_addresses(addresses);
+
     //std::unordered_map<std::string, size_t> locations;
 
     if (book.saved_node_id == 0) {
@@ -264,28 +494,40 @@ void apex_report_leaks() {
     size_t actual_leaks{0};
     // Print the sorted value
     size_t actual_bytes{0};
+    // without a call stack, we can't tell if it's a known leak
+    size_t unsampled_leaks{0};
+    size_t unsampled_bytes{0};
     for (auto& it : sorted) {
         std::stringstream ss;
-        //if (it.second.bytes > 1000) {
-            ss << it.second.bytes << " bytes leaked at " << std::hex << it.first << std::dec << " from task ";
+        const record_t& record = *(it.second);
+        //if (record.bytes > 1000) {
+            ss << record.bytes << " bytes leaked at " << std::hex << it.first << std::dec << " from task ";
         //} else {
             //break;
         //}
         std::string name{"(no timer)"};
         bool nameless{true};
-        if (it.second.id != nullptr) {
-            name = it.second.id->get_name();
+        if (record.id != nullptr) {
+            name = record.id->get_name();
             // skip known CUPTI leaks.
             //if (name.rfind("cuda", 0) == 0) { continue; }
             nameless = false;
         }
-        ss << name << " on tid " << it.second.tid << " with backtrace: " << std::endl;
-        ss << "\t" << allocator_strings[it.second.alloc] << std::endl;
-        char** strings = backtrace_symbols( it.second.backtrace.data(), it.second.size );
+        const allocation_site * site = record.site;
+        ss << name << " on tid " << record.tid;
+        if (site == nullptr) {
+            ss << " (backtrace not sampled)" << std::endl;
+        } else {
+            ss << " with backtrace: " << std::endl;
+        }
+        ss << "\t" << allocator_strings[record.alloc] << std::endl;
         bool skip{false};
-        for(size_t i = 3; i < it.second.size; i++ ){
+        size_t size = (site == nullptr) ? 0 : site->frames.size();
+        char** strings = (site == nullptr) ? nullptr :
+            backtrace_symbols( site->frames.data(), size );
+        for(size_t i = skipped_frames; i < size; i++ ){
             std::string tmp{strings[i]};
-            if (it.second.cpu) {
+            if (record.cpu) {
                 if (tmp.find("cuInit", 0) != std::string::npos) { skip = true; break; }
                 if (tmp.find("libcudart", 0) != std::string::npos) { skip = true; break; }
                 if (tmp.find("libcupti", 0) != std::string::npos) { skip = true; break; }
@@ -299,14 +541,14 @@ void apex_report_leaks() {
                 }
             }
             const std::string unknown{"{(unknown)}"};
-            if (it.second.resolved) {
-                if (it.second.symbols[i].find(unknown) == std::string::npos) {
-                    ss << "\t" << it.second.symbols[i] << std::endl;
+            if (site->resolved) {
+                if (site->symbols[i].find(unknown) == std::string::npos) {
+                    ss << "\t" << site->symbols[i] << std::endl;
                 } else {
                     ss << "\t" << tmp << std::endl;
                 }
             } else {
-                std::string* tmp2{lookup_address(((uintptr_t)it.second.backtrace[i]), true)};
+                std::string* tmp2{lookup_address(((uintptr_t)site->frames[i]), true)};
                 if (tmp2->find(unknown) == std::string::npos) {
                     ss << "\t" << *tmp2 << std::endl;
                 } else {
@@ -314,13 +556,14 @@ void apex_report_leaks() {
                 }
             }
         }
+        free(strings);
         if (skip) { continue; }
 
         /*
-        //for (auto a : it.second.backtrace) {
-        for (size_t a = 2 ; a <  it.second.size; a++) {
+        //for (auto a : site->frames) {
+        for (size_t a = 2 ; a <  size; a++) {
             //std::string * tmp = lookup_address(a, true);
-            std::string * tmp = lookup_address((uintptr_t)it.second.backtrace[a], true);
+            std::string * tmp = lookup_address((uintptr_t)site->frames[a], true);
             std::string demangled = demangle(*tmp);
             ss << "\t" << demangled << std::endl;
         }
@@ -328,14 +571,19 @@ void apex_report_leaks() {
         ss << std::endl;
         /*
         if (locations.count(name) > 0) {
-            locations[name] += it.second.bytes;
+            locations[name] += record.bytes;
         } else {
-            locations[name] = it.second.bytes;
+            locations[name] = record.bytes;
         }
         */
         report << ss.str();
+        if (site == nullptr) {
+            unsampled_leaks++;
+            unsampled_bytes+=record.bytes;
+            continue;
+        }
         actual_leaks++;
-        actual_bytes+=it.second.bytes;
+        actual_bytes+=record.bytes;
     }
     report.close();
     if (book.saved_node_id == 0) {
@@ -343,8 +591,16 @@ void apex_report_leaks() {
                   << actual_bytes
                   << " bytes.\nExpect false positives if memory was freed after exit."
                   << std::endl;
+        if (unsampled_leaks > 0) {
+            std::cout << "Also reported " << unsampled_leaks << " leaks of "
+                      << unsampled_bytes << " bytes without a call stack, "
+                      << "because the call stacks were sampled "
+                      << "(APEX_MEMORY_SAMPLE_BYTES="
+                      << apex_options::memory_sample_bytes() << ")."
+                      << std::endl;
+        }
     }
-    if (actual_leaks == 0) {
+    if (actual_leaks + unsampled_leaks == 0) {
         remove(outfile.c_str());
     }
 
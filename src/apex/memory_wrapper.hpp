@@ -13,6 +13,9 @@
 
 #pragma once
 #include <apex.hpp>
+#include <array>
+#include <memory>
+#include <vector>
 
 typedef enum apex_allocator {
     APEX_MALLOC = 0,
@@ -28,29 +31,67 @@ namespace apex {
 void apex_report_leaks();
 void apex_get_leak_symbols();
 
+/* A call stack that sampled allocations came from, with estimates of
+ * what was allocated there.  Each sampled allocation stands for 1/p of
+ * the allocations like it, where p is its chance of being sampled. */
+class allocation_site {
+public:
+    std::vector<void*> frames;
+    apex_allocator_t alloc;
+    std::vector<std::string> symbols; // resolved when needed
+    bool resolved;
+    // guarded by book_t::siteMutex
+    double allocations;
+    double bytes_allocated;
+    double live_allocations;
+    double live_bytes;
+    allocation_site(void** trace, size_t size, apex_allocator_t a) :
+        frames(trace, trace + size), alloc(a), resolved(false),
+        allocations(0.0), bytes_allocated(0.0), live_allocations(0.0),
+        live_bytes(0.0) {}
+};
+
+/* A live allocation.  This is kept small, because there is one for every
+ * allocation - only the sampled ones have a call stack. */
 class record_t {
 public:
     size_t bytes;
     task_identifier * id;
     size_t tid;
     apex_allocator_t alloc;
-    record_t() : bytes(0), id(nullptr), tid(0), alloc(APEX_MALLOC), resolved(false), cpu(true) {}
-    record_t(size_t b, size_t t, apex_allocator_t a, bool on_cpu) :
-        bytes(b), id(nullptr), tid(t), alloc(a), resolved(false), cpu(on_cpu) {}
-    //std::vector<uintptr_t> backtrace;
-    std::array<void*,64> backtrace;
-    std::array<std::string,64> symbols;
-    bool resolved;
-    size_t size;
     bool cpu;
+    float weight; // the number of allocations this sample stands for
+    allocation_site * site;
+    record_t() : bytes(0), id(nullptr), tid(0), alloc(APEX_MALLOC), cpu(true),
+        weight(0.0), site(nullptr) {}
+    record_t(size_t b, size_t t, apex_allocator_t a, bool on_cpu) :
+        bytes(b), id(nullptr), tid(t), alloc(a), cpu(on_cpu), weight(0.0),
+        site(nullptr) {}
 };
 
+/* The live allocations, in shards selected by a hash of the address so
+ * that threads allocating at the same time rarely wait for each other. */
 class book_t {
 public:
+    static const size_t num_shards = 64;
+    class alignas(64) shard_t {
+    public:
+        std::mutex mapMutex;
+        std::unordered_map<const void*,record_t> memoryMap;
+    };
     size_t saved_node_id;
     std::atomic<size_t> totalAllocated{0};
-    std::unordered_map<const void*,record_t> memoryMap;
-    std::mutex mapMutex;
+    std::array<shard_t, num_shards> shards;
+    /* The allocation sites, keyed by their call stacks.  They are never
+     * deleted, because records point to them. */
+    std::mutex siteMutex;
+    std::unordered_map<std::string, allocation_site*> sites;
+    std::mutex symbolMutex;
+    shard_t& shard(const void* ptr) {
+        // allocations are aligned, so mix the address before using it
+        uint64_t h = ((uint64_t)(uintptr_t)ptr) * 0x9E3779B97F4A7C15ULL;
+        return shards[h >> 58];
+    }
     ~book_t() {
         apex_report_leaks();
     }
@@ -63,6 +104,10 @@ void recordAlloc(const size_t bytes, const void* ptr,
     const apex_allocator_t alloc, const bool cpu = true);
 void recordFree(const void* ptr, const bool cpu = true);
 void recordMetric(std::string name, double value);
+/* Periodic heap snapshots, see APEX_HEAP_SNAPSHOT_PERIOD */
+void start_heap_snapshots(void);
+void stop_heap_snapshots(void);
+void write_heap_snapshot(void);
 
 }; // apex namespace
 
@@ -25,6 +25,10 @@ public:
   ~nvtx_listener (void) { };
   static bool initialize_nvtx(int argc, char** avgv);
   inline static bool initialized(void) { return _initialized; }
+  listener_mask subscriptions(void) const {
+    return APEX_LISTEN(LISTEN_START) | APEX_LISTEN(LISTEN_STOP) |
+        APEX_LISTEN(LISTEN_YIELD) | APEX_LISTEN(LISTEN_RESUME);
+  }
   void on_startup(startup_event_data &data);
   void on_dump(dump_event_data &data);
   void on_reset(task_identifier * id)
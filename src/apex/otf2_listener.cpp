@@ -15,6 +15,9 @@
 #endif
 #include "otf2_listener.hpp"
 #include "thread_instance.hpp"
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <sstream>
 #include <ostream>
 #include <fstream>
@@ -36,6 +39,8 @@
 #include "otf2/OTF2_MPI_Collectives.h"
 #endif
 #include <atomic>
+#include <chrono>
+#include <thread>
 
 #define OTF2_EC(call) { \
     OTF2_ErrorCode ec = call; \
@@ -272,10 +277,12 @@ namespace apex {
     }
 
         /* these indices are thread-specific. */
-        std::map<task_identifier,uint64_t>& otf2_listener::get_region_indices(void) {
-            static APEX_NATIVE_TLS std::map<task_identifier,uint64_t> * region_indices;
+        /* The thread-local cache is keyed by the interned task id, the
+         * global map is ordered by name for writing the definitions. */
+        std::unordered_map<uint32_t,uint64_t>& otf2_listener::get_region_indices(void) {
+            static APEX_NATIVE_TLS std::unordered_map<uint32_t,uint64_t> * region_indices;
             if (region_indices == nullptr) {
-                region_indices = new std::map<task_identifier,uint64_t>();
+                region_indices = new std::unordered_map<uint32_t,uint64_t>();
             }
             return *region_indices;
         }
@@ -289,8 +296,8 @@ namespace apex {
         }
         uint64_t otf2_listener::get_region_index(task_identifier* id) {
             /* first, look in this thread's map */
-            std::map<task_identifier,uint64_t>& region_indices = get_region_indices();
-            auto tmp = region_indices.find(*id);
+            std::unordered_map<uint32_t,uint64_t>& region_indices = get_region_indices();
+            auto tmp = region_indices.find(id->id);
             uint64_t region_index = 0;
             if (tmp == region_indices.end()) {
                 /* not in the thread's map? look in the global map */
@@ -305,7 +312,7 @@ namespace apex {
                 }
                 lock.unlock();
                 /* store the global value in the thread's map */
-                region_indices[*id] = region_index;
+                region_indices[id->id] = region_index;
             } else {
                 region_index = tmp->second;
             }
@@ -477,15 +484,6 @@ namespace apex {
             string(string(apex_options::otf2_archive_path()) + "/.metrics.");
         thread_filename_prefix =
             string(string(apex_options::otf2_archive_path()) + "/.threads.");
-        lock_filename_prefix =
-            string(string(apex_options::otf2_archive_path()) +
-            "/.regions.lock.");
-        lock2_filename_prefix =
-            string(string(apex_options::otf2_archive_path()) +
-            "/.metrics.lock.");
-        lock3_filename_prefix =
-            string(string(apex_options::otf2_archive_path()) +
-            "/.threads.lock.");
     }
 
     bool otf2_listener::create_archive(void) {
@@ -567,7 +565,9 @@ namespace apex {
         // synchronize global time offset based on archive creation time
         struct stat stat_buf;
         // wait for the file to exist
-        while (stat(apex_options::otf2_archive_path(), &stat_buf) != 0) {}
+        while (stat(apex_options::otf2_archive_path(), &stat_buf) != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
         /* get a start time for the trace, relative to when
          * the archive was created. */
 #if defined(__APPLE__)
@@ -1906,289 +1906,155 @@ namespace apex {
                                 rank_pid_map, rank_hostname_map);
     }
 
-    std::string otf2_listener::write_my_regions(void) {
-        stringstream region_file;
-        // first, output our number of threads.
-        //region_file << thread_instance::get_num_threads() << endl;
-        region_file << _event_threads.size() << endl;
-        // then iterate over the regions and write them out.
-        for (auto const &i : global_region_indices) {
-            task_identifier id = i.first;
-            //uint64_t idx = i.second;
-            //region_file << id.get_name() << "\t" << idx << endl;
-            region_file << id.get_name() << endl;
-        }
-        return region_file.str();
-    }
-
-    int otf2_listener::reduce_regions(void) {
-        std::string my_regions = write_my_regions();
-        int length = my_regions.size();
-        int full_length = 0;
-        int max_length = 0;
-        char * sbuf = nullptr;
-        char * rbuf = nullptr;
+    /* The region and metric names are reduced with a binomial tree.  In
+     * round k, the ranks with bit k set send their names to the rank
+     * without it, which merges them with its own, so rank 0 has the union
+     * after log2(P) rounds and no rank merges more than log2(P) lists.
+     * The names are sorted by their hash, so the merges are linear, and
+     * the position in the final list is the global id. */
+    typedef std::vector<std::pair<size_t, std::string> > hashed_names;
 
-        if (my_saved_node_count > 1) {
-            // get the max length from all nodes
-            PMPI_Allreduce(&length, &max_length, 1, MPI_INT,
-                           MPI_MAX, MPI_COMM_WORLD);
-        } else {
-            max_length = length;
-        }
-        // get the total length
-        full_length = max_length * my_saved_node_count;
+    static void add_name(hashed_names& names, const std::string& name) {
+        names.emplace_back(std::hash<std::string>()(name), name);
+    }
 
-        // allocate space to store the strings on node 0
-        if (my_saved_node_id == 0) {
-            rbuf = (char*) calloc(full_length, sizeof(char));
+    static std::string pack_names(const hashed_names& names) {
+        std::string buf;
+        for (auto const &i : names) {
+            buf += i.second;
+            buf += '\n';
         }
-        // put the local data in a fixed length string
-        sbuf = (char*) calloc(max_length, sizeof(char));
-        strncpy(sbuf, my_regions.c_str(), max_length);
+        return buf;
+    }
 
-        if (my_saved_node_count > 1) {
-            // gather the strings to node 0
-            PMPI_Gather(sbuf, max_length, MPI_CHAR, rbuf,
-                max_length, MPI_CHAR, 0, MPI_COMM_WORLD);
-        } else {
-            rbuf = sbuf;
+    /* The packed names are already in order, so they stay sorted. */
+    static hashed_names unpack_names(const char * buf, size_t length) {
+        hashed_names names;
+        const char * end = buf + length;
+        while (buf < end) {
+            const char * eol = std::find(buf, end, '\n');
+            add_name(names, std::string(buf, eol));
+            buf = eol + 1;
         }
+        return names;
+    }
 
-        int fullmap_length = 0;
-        char * fullmap = nullptr;
-        if (my_saved_node_id == 0) {
-            // iterate over my region map, and build a map of strings to ids
-            // save my number of regions
-            rank_region_map[0] = global_region_indices.size();
-            for (auto const &i : global_region_indices) {
-                task_identifier id = i.first;
-                uint64_t idx = i.second;
-                reduced_region_map[id.get_name()] = idx;
-            }
-            // iterate over the other ranks in the index files
-            for (int i = 1 ; i < my_saved_node_count ; i++) {
-                rank_region_map[i] = 0;
-                std::string region_file_string(rbuf+(max_length * i),
-                    max_length);
-                // get the number of threads from this rank
-                std::string region_line;
-                std::stringstream region_file(region_file_string);
-                std::getline(region_file, region_line);
-                std::string::size_type sz;   // alias of size_t
-                rank_thread_map[i] = std::stoi(region_line,&sz);
-                // read the map from that rank
-                while (std::getline(region_file, region_line)) {
-                    rank_region_map[i] = rank_region_map[i] + 1;
-                    // trim the newline
-                    region_line.erase(std::remove(region_line.begin(),
-                        region_line.end(), '\n'), region_line.end());
-                    if (reduced_region_map.find(region_line) ==
-                        reduced_region_map.end()) {
-                        uint64_t idx = reduced_region_map.size();
-                        reduced_region_map[region_line] = idx;
-                    }
-                }
-            }
-            // copy the reduced map to a pair, so we can sort by value
-            std::vector<std::pair<std::string, int>> pairs;
-            for (auto const &i : reduced_region_map) {
-                pairs.push_back(i);
+    static void reduce_names(hashed_names& names, int rank, int size,
+        std::map<std::string,uint64_t>& reduced) {
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        // use our own communicator, so we can't match application messages
+        MPI_Comm comm;
+        PMPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        for (int mask = 1 ; mask < size ; mask <<= 1) {
+            if (rank & mask) {
+                // send our names to the parent, and we are done
+                std::string buf(pack_names(names));
+                PMPI_Send(const_cast<char*>(buf.data()), (int)buf.size(),
+                    MPI_CHAR, rank - mask, 0, comm);
+                break;
             }
-            sort(pairs.begin(), pairs.end(), string_sort_by_value());
-            std::stringstream region_file;
-            // iterate over the regions and build the string
-            for (auto const &i : pairs) {
-                std::string name = i.first;
-                uint64_t idx = i.second;
-                region_file << idx << "\t" << name << endl;
+            if (rank + mask < size) {
+                MPI_Status status;
+                int length = 0;
+                PMPI_Probe(rank + mask, 0, comm, &status);
+                PMPI_Get_count(&status, MPI_CHAR, &length);
+                std::vector<char> buf(length + 1);
+                PMPI_Recv(buf.data(), length, MPI_CHAR, rank + mask, 0,
+                    comm, MPI_STATUS_IGNORE);
+                hashed_names theirs(unpack_names(buf.data(), length));
+                hashed_names merged;
+                merged.reserve(names.size() + theirs.size());
+                std::set_union(names.begin(), names.end(),
+                    theirs.begin(), theirs.end(), std::back_inserter(merged));
+                names.swap(merged);
             }
-            fullmap_length = region_file.str().length();
-            fullmap = (char*) calloc(fullmap_length, sizeof(char));
-            strncpy(fullmap, region_file.str().c_str(), fullmap_length);
-        }
-
-        if (my_saved_node_count > 1) {
-            PMPI_Barrier(MPI_COMM_WORLD);
-        }
-
-        // share the full map length
-        if (my_saved_node_count > 1) {
-            PMPI_Bcast(&fullmap_length, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        }
-        if (my_saved_node_id > 0) {
-            fullmap = (char*) calloc(fullmap_length, sizeof(char));
-        }
-
-        if (my_saved_node_count > 1) {
-            // share the full map
-            PMPI_Bcast(fullmap, fullmap_length, MPI_CHAR, 0, MPI_COMM_WORLD);
         }
-
-        // read the reduced data
-        if (my_saved_node_count > 1) {
-            std::map<std::string,uint64_t> reduced_region_map;
-            std::string region_line;
-            std::stringstream region_file(fullmap);
-            std::string region_name;
-            int idx;
-            // read the map from rank 0
-            while (std::getline(region_file, region_line)) {
-                //istringstream ss(region_line);
-                //ss >> idx >> region_name;
-                size_t index = region_line.find("\t");
-                std::string tmp = region_line.substr(0,index);
-                region_name = region_line.substr(index+1);
-                idx = atoi(tmp.c_str());
-                reduced_region_map[region_name] = idx;
-            }
-            // ...and write the map to the local definitions
-            write_region_map(reduced_region_map);
+        // share the full list
+        std::string fullmap;
+        int fullmap_length = 0;
+        if (rank == 0) {
+            fullmap = pack_names(names);
+            fullmap_length = fullmap.size();
+        }
+        PMPI_Bcast(&fullmap_length, 1, MPI_INT, 0, comm);
+        fullmap.resize(fullmap_length + 1);
+        PMPI_Bcast(&fullmap[0], fullmap_length, MPI_CHAR, 0, comm);
+        PMPI_Comm_free(&comm);
+        names = unpack_names(fullmap.data(), fullmap_length);
+        for (size_t i = 0 ; i < names.size() ; i++) {
+            reduced[names[i].second] = i;
         }
-        return my_saved_node_count;
     }
 
-    std::string otf2_listener::write_my_metrics(void) {
-        stringstream metric_file;
-        // first, output our number of threads.
-        //metric_file << thread_instance::get_num_threads() << endl;
-        metric_file << _event_threads.size() << endl;
-        metric_file << saved_end_timestamp << endl;
-        // then iterate over the metrics and write them out.
-        for (auto const &i : global_metric_indices) {
-            string id = i.first;
-            //uint64_t idx = i.second;
-            //metric_file << id.get_name() << "\t" << idx << endl;
-            metric_file << id << endl;
+    /* Rank 0 only needs the sizes from the other ranks, not their names. */
+    static void gather_counts(int count, int rank, int size,
+        std::map<int,int>& rank_map) {
+        std::vector<int> counts(rank == 0 ? size : 1);
+        PMPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0,
+            MPI_COMM_WORLD);
+        if (rank == 0) {
+            for (int i = 0 ; i < size ; i++) {
+                rank_map[i] = counts[i];
+            }
         }
-        return metric_file.str();
     }
 
-    void otf2_listener::reduce_metrics(void) {
-        std::string my_metrics = write_my_metrics();
-        int length = my_metrics.size();
-        int full_length = 0;
-        int max_length = 0;
-        char * sbuf = nullptr;
-        char * rbuf = nullptr;
-
-        if (my_saved_node_count > 1) {
-            // get the max length from all nodes
-            PMPI_Allreduce(&length, &max_length, 1, MPI_INT,
-                           MPI_MAX, MPI_COMM_WORLD);
-        } else {
-            max_length = length;
+    int otf2_listener::reduce_regions(void) {
+        // a single rank keeps its own ids, and needs no mapping table
+        if (my_saved_node_count == 1) {
+            rank_region_map[0] = global_region_indices.size();
+            for (auto const &i : global_region_indices) {
+                task_identifier id = i.first;
+                reduced_region_map[id.get_name()] = i.second;
+            }
+            return my_saved_node_count;
+        }
+        gather_counts(global_region_indices.size(), my_saved_node_id,
+            my_saved_node_count, rank_region_map);
+        gather_counts(_event_threads.size(), my_saved_node_id,
+            my_saved_node_count, rank_thread_map);
+        hashed_names names;
+        names.reserve(global_region_indices.size());
+        for (auto const &i : global_region_indices) {
+            task_identifier id = i.first;
+            add_name(names, id.get_name());
         }
-        // get the total length
-        full_length = max_length * my_saved_node_count;
-
-        // allocate space to store the strings on node 0
+        std::map<std::string,uint64_t> reduced;
+        reduce_names(names, my_saved_node_id, my_saved_node_count, reduced);
+        // ...and write the map to the local definitions
+        write_region_map(reduced);
         if (my_saved_node_id == 0) {
-            rbuf = (char*) calloc(full_length, sizeof(char));
-        }
-        // put the local data in a fixed length string
-        sbuf = (char*) calloc(max_length, sizeof(char));
-        strncpy(sbuf, my_metrics.c_str(), max_length);
-
-        if (my_saved_node_count > 1) {
-            // gather the strings to node 0
-            PMPI_Gather(sbuf, max_length, MPI_CHAR, rbuf,
-                max_length, MPI_CHAR, 0, MPI_COMM_WORLD);
-        } else {
-            rbuf = sbuf;
+            reduced_region_map = std::move(reduced);
         }
+        return my_saved_node_count;
+    }
 
-        int fullmap_length = 0;
-        char * fullmap = nullptr;
-        if (my_saved_node_id == 0) {
-            // iterate over my metric map, and build a map of strings to ids
-            // save my number of metrics
+    void otf2_listener::reduce_metrics(void) {
+        if (my_saved_node_count == 1) {
             rank_metric_map[0] = global_metric_indices.size();
             for (auto const &i : global_metric_indices) {
-                task_identifier id = i.first;
-                uint64_t idx = i.second;
-                reduced_metric_map[id.get_name()] = idx;
-            }
-            // iterate over the other ranks in the index files
-            for (int i = 1 ; i < my_saved_node_count ; i++) {
-                rank_metric_map[i] = 0;
-                std::string metric_file_string(rbuf+(max_length * i),
-                    max_length);
-                // get the number of threads from this rank
-                std::string metric_line;
-                std::stringstream metric_file(metric_file_string);
-                std::getline(metric_file, metric_line);
-                std::string::size_type sz;   // alias of size_t
-                rank_thread_map[i] = std::stoi(metric_line,&sz);
-                // get the last timestamp
-                std::getline(metric_file, metric_line);
-                uint64_t tmp_timestamp = std::stol(metric_line, &sz);
-                if (saved_end_timestamp < tmp_timestamp) {
-                    saved_end_timestamp = tmp_timestamp;
-                }
-                // read the map from that rank
-                while (std::getline(metric_file, metric_line)) {
-                    rank_metric_map[i] = rank_metric_map[i] + 1;
-                    // trim the newline
-                    metric_line.erase(std::remove(metric_line.begin(),
-                        metric_line.end(), '\n'), metric_line.end());
-                    if (reduced_metric_map.find(metric_line) ==
-                        reduced_metric_map.end()) {
-                        uint64_t idx = reduced_metric_map.size();
-                        reduced_metric_map[metric_line] = idx;
-                    }
-                }
-            }
-            // copy the reduced map to a pair, so we can sort by value
-            std::vector<std::pair<std::string, int>> pairs;
-            for (auto const &i : reduced_metric_map) {
-                pairs.push_back(i);
-            }
-            sort(pairs.begin(), pairs.end(), string_sort_by_value());
-            std::stringstream metric_file;
-            // iterate over the metrics and build the string
-            for (auto const &i : pairs) {
-                std::string name = i.first;
-                uint64_t idx = i.second;
-                metric_file << idx << "\t" << name << endl;
+                reduced_metric_map[i.first] = i.second;
             }
-            fullmap_length = metric_file.str().length();
-            fullmap = (char*) calloc(fullmap_length, sizeof(char));
-            strncpy(fullmap, metric_file.str().c_str(), fullmap_length);
+            return;
         }
-
-        if (my_saved_node_count > 1) {
-            PMPI_Barrier(MPI_COMM_WORLD);
-            // share the full map length
-            PMPI_Bcast(&fullmap_length, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-            if (my_saved_node_id > 0) {
-                fullmap = (char*) calloc(fullmap_length, sizeof(char));
-            }
-
-            // share the full map
-            PMPI_Bcast(fullmap, fullmap_length, MPI_CHAR, 0, MPI_COMM_WORLD);
+        // get the last timestamp
+        uint64_t my_end_timestamp = saved_end_timestamp;
+        PMPI_Reduce(&my_end_timestamp, &saved_end_timestamp, 1,
+            MPI_UINT64_T, MPI_MAX, 0, MPI_COMM_WORLD);
+        gather_counts(global_metric_indices.size(), my_saved_node_id,
+            my_saved_node_count, rank_metric_map);
+        hashed_names names;
+        names.reserve(global_metric_indices.size());
+        for (auto const &i : global_metric_indices) {
+            add_name(names, i.first);
         }
-
-        // read the reduced data
-        if (my_saved_node_count > 1) {
-            std::map<std::string,uint64_t> reduced_metric_map;
-            std::string metric_line;
-            std::stringstream metric_file(fullmap);
-            std::string metric_name;
-            int idx;
-            // read the map from rank 0
-            while (std::getline(metric_file, metric_line)) {
-                //istringstream ss(metric_line);
-                //ss >> idx >> metric_name;
-                size_t index = metric_line.find("\t");
-                std::string tmp = metric_line.substr(0,index);
-                metric_name = metric_line.substr(index+1);
-                idx = atoi(tmp.c_str());
-                reduced_metric_map[metric_name] = idx;
-            }
-            // ...and distribute them back out
-            write_metric_map(reduced_metric_map);
+        std::map<std::string,uint64_t> reduced;
+        reduce_names(names, my_saved_node_id, my_saved_node_count, reduced);
+        // ...and distribute them back out
+        write_metric_map(reduced);
+        if (my_saved_node_id == 0) {
+            reduced_metric_map = std::move(reduced);
         }
      }
 
@@ -2274,25 +2140,48 @@ namespace apex {
 
     /* When not using HPX or MPI, use the filesystem. Ick. */
 
+    /* Each rank writes its files under a temporary name, and renames them
+     * into place.  The rename is atomic, so once a file exists it is
+     * complete - there are no lock files to check. */
+    void otf2_listener::publish_file(const std::string& name) {
+        std::string tmp(name + ".tmp");
+        if (std::rename(tmp.c_str(), name.c_str()) != 0) {
+            std::cerr << "APEX: Unable to rename " << tmp << " to " << name
+                      << std::endl;
+        }
+    }
+
+    /* Wait for another rank's file to be published.  Back off, instead of
+     * spinning on stat(), so the waiting ranks don't burn a core each or
+     * flood a shared filesystem's metadata server.  The more ranks there
+     * are, the longer the longest wait between polls. */
+    void otf2_listener::wait_for_file(const std::string& name) {
+        struct stat buffer;
+        const int64_t max_delay = std::min<int64_t>(1000000,
+            std::max<int64_t>(10000, 1000 * (int64_t)my_saved_node_count));
+        int64_t delay = 10;
+        while (stat(name.c_str(), &buffer) != 0) {
+            // spread the ranks out, so they don't all poll at once
+            int64_t jitter = (delay * (my_saved_node_id % 8)) / 8;
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(delay + jitter));
+            delay = std::min(delay * 2, max_delay);
+        }
+    }
+
     std::unique_ptr<std::tuple<std::map<int,int>,
                     std::map<int,std::string> > >
                     otf2_listener::reduce_node_properties(std::string&& str) {
-        // create my lock file.
-        ostringstream lock_filename;
-        lock_filename << lock_filename_prefix << my_saved_node_id;
-        ofstream lock_file(lock_filename.str(), ios::out | ios::trunc );
-        lock_file << "lock" << endl;
-        lock_file.close();
-        lock_file.flush();
-
-        std::ofstream index_file(index_filename + to_string(my_saved_node_id));
+        std::string my_index_filename(index_filename +
+            to_string(my_saved_node_id));
+        std::ofstream index_file(my_index_filename + ".tmp");
         // write our info
         index_file << str.c_str();
         // close the file
         index_file.close();
 
-        // delete the lock file, so rank 0 can read our data.
-        std::remove(lock_filename.str().c_str());
+        // publish the file, so rank 0 can read our data.
+        publish_file(my_index_filename);
 
         if (my_saved_node_id > 0) {
             return nullptr;
@@ -2307,15 +2196,10 @@ namespace apex {
         // the rank, pid and hostname for each
         for (int i = 0 ; i < my_saved_node_count ; i++) {
             std::string line;
-            struct stat buffer;
             std::stringstream full_index_filename;
             full_index_filename << index_filename << to_string(i);
             // wait for the file to exist
-            while (stat (full_index_filename.str().c_str(), &buffer) != 0) {}
-            ostringstream lock_filename2;
-            lock_filename2 << lock_filename_prefix << i;
-            // wait for the lock file to not exist
-            while (stat (lock_filename2.str().c_str(), &buffer) == 0) {}
+            wait_for_file(full_index_filename.str());
             std::ifstream myfile(full_index_filename.str());
             while (std::getline(myfile, line)) {
                 istringstream ss(line);
@@ -2331,17 +2215,10 @@ namespace apex {
     }
 
     std::string otf2_listener::write_my_regions(void) {
-        // create my lock file.
-        ostringstream lock_filename;
-        lock_filename << lock_filename_prefix << my_saved_node_id;
-        ofstream lock_file(lock_filename.str(), ios::out | ios::trunc );
-        lock_file << "lock" << endl;
-        lock_file.close();
-        lock_file.flush();
         // open my region file
         ostringstream region_filename;
         region_filename << region_filename_prefix << my_saved_node_id;
-        ofstream region_file(region_filename.str(), ios::out | ios::trunc );
+        ofstream region_file(region_filename.str() + ".tmp", ios::out | ios::trunc );
         // first, output our number of threads.
         //region_file << thread_instance::get_num_threads() << endl;
         region_file << _event_threads.size() << endl;
@@ -2354,8 +2231,8 @@ namespace apex {
         }
         // close the region file
         region_file.close();
-        // delete the lock file, so rank 0 can read our data.
-        std::remove(lock_filename.str().c_str());
+        // publish the file, so rank 0 can read our data.
+        publish_file(region_filename.str());
         return std::string();
     }
 
@@ -2363,11 +2240,6 @@ namespace apex {
         write_my_regions();
 
         if (my_saved_node_id == 0) {
-        // create my lock file.
-        ostringstream my_lock_filename;
-        my_lock_filename << lock_filename_prefix << "all";
-        ofstream lock_file(my_lock_filename.str(), ios::out | ios::trunc );
-        lock_file.close();
         // iterate over my region map, and build a map of strings to ids
         // save my number of regions
         rank_region_map[0] = global_region_indices.size();
@@ -2381,16 +2253,10 @@ namespace apex {
             // skip myself
             if (i == 0) continue;
             rank_region_map[i] = 0;
-            struct stat buffer;
             // wait on the map file to exist
             ostringstream region_filename;
             region_filename << region_filename_prefix << i;
-            // wait for the region file to exist
-            while (stat (region_filename.str().c_str(), &buffer) != 0) {}
-            ostringstream lock_filename;
-            lock_filename << lock_filename_prefix << i;
-            // wait for the lock file to not exist
-            while (stat (lock_filename.str().c_str(), &buffer) == 0) {}
+            wait_for_file(region_filename.str());
             // get the number of threads from that rank
             std::string region_line;
             std::ifstream region_file(region_filename.str());
@@ -2417,7 +2283,7 @@ namespace apex {
         // open my region file
         ostringstream region_filename;
         region_filename << region_filename_prefix << "reduced." << my_saved_node_id;
-        ofstream region_file(region_filename.str(), ios::out | ios::trunc );
+        ofstream region_file(region_filename.str() + ".tmp", ios::out | ios::trunc );
         // copy the reduced map to a pair, so we can sort by value
         std::vector<std::pair<std::string, int>> pairs;
         for (auto const &i : reduced_region_map) {
@@ -2432,25 +2298,17 @@ namespace apex {
         }
         // close the region file
         region_file.close();
-        // delete the lock file, so everyone can read our data.
-        int rc = std::remove(my_lock_filename.str().c_str());
-        while (rc != 0) {
-            rc = std::remove(my_lock_filename.str().c_str());
-        }
+        // publish the file, so everyone can read our data.
+        publish_file(region_filename.str());
         }
 
         // read the reduced data
         if (my_saved_node_count > 1) {
-            struct stat buffer;
             std::map<std::string,uint64_t> reduced_region_map;
             // wait on the map file from rank 0 to exist
             ostringstream region_filename;
             region_filename << region_filename_prefix << "reduced." << 0;
-            while (stat (region_filename.str().c_str(), &buffer) != 0) {}
-            // wait for the lock file from rank 0 to NOT exist
-            ostringstream lock_filename;
-            lock_filename << lock_filename_prefix << "all";
-            while (stat (lock_filename.str().c_str(), &buffer) == 0) {}
+            wait_for_file(region_filename.str());
             std::string region_line;
             std::string region_name;
             std::ifstream region_file(region_filename.str());
@@ -2478,15 +2336,10 @@ namespace apex {
     }
 
     std::string otf2_listener::write_my_metrics(void) {
-        // create my lock file.
-        ostringstream lock_filename;
-        lock_filename << lock2_filename_prefix << my_saved_node_id;
-        ofstream lock_file(lock_filename.str(), ios::out | ios::trunc );
-        lock_file.close();
         // open my metric file
         ostringstream metric_filename;
         metric_filename << metric_filename_prefix << my_saved_node_id;
-        ofstream metric_file(metric_filename.str(), ios::out | ios::trunc );
+        ofstream metric_file(metric_filename.str() + ".tmp", ios::out | ios::trunc );
         // first, output our number of threads.
         //metric_file << thread_instance::get_num_threads() << endl;
         metric_file << _event_threads.size() << endl;
@@ -2500,8 +2353,8 @@ namespace apex {
         }
         // close the metric file
         metric_file.close();
-        // delete the lock file, so rank 0 can read our data.
-        std::remove(lock_filename.str().c_str());
+        // publish the file, so rank 0 can read our data.
+        publish_file(metric_filename.str());
         return std::string();
     }
 
@@ -2509,11 +2362,6 @@ namespace apex {
         write_my_metrics();
 
         if (my_saved_node_id == 0) {
-        // create my lock file.
-        ostringstream my_lock_filename;
-        my_lock_filename << lock2_filename_prefix << "all";
-        ofstream lock_file(my_lock_filename.str(), ios::out | ios::trunc );
-        lock_file.close();
         // iterate over my metric map, and build a map of strings to ids
         // save my number of metrics
         rank_metric_map[0] = global_metric_indices.size();
@@ -2527,15 +2375,10 @@ namespace apex {
             // skip myself
             if (i == 0) continue;
             rank_metric_map[i] = 0;
-            struct stat buffer;
             // wait on the map file to exist
             ostringstream metric_filename;
             metric_filename << metric_filename_prefix << i;
-            while (stat (metric_filename.str().c_str(), &buffer) != 0) {}
-            // wait for the lock file to not exist
-            ostringstream lock_filename;
-            lock_filename << lock2_filename_prefix << i;
-            while (stat (lock_filename.str().c_str(), &buffer) == 0) {}
+            wait_for_file(metric_filename.str());
             // get the number of threads from that rank
             std::string metric_line;
             std::ifstream metric_file(metric_filename.str());
@@ -2568,7 +2411,7 @@ namespace apex {
         // open my metric file
         ostringstream metric_filename;
         metric_filename << metric_filename_prefix << "reduced." << my_saved_node_id;
-        ofstream metric_file(metric_filename.str(), ios::out | ios::trunc );
+        ofstream metric_file(metric_filename.str() + ".tmp", ios::out | ios::trunc );
         // copy the reduced map to a pair, so we can sort by value
         std::vector<std::pair<std::string, int>> pairs;
         for (auto const &i : reduced_metric_map) {
@@ -2583,25 +2426,17 @@ namespace apex {
         }
         // close the metric file
         metric_file.close();
-        // delete the lock file, so everyone can read our data.
-        int rc = std::remove(my_lock_filename.str().c_str());
-        while (rc != 0) {
-            rc = std::remove(my_lock_filename.str().c_str());
-        }
+        // publish the file, so everyone can read our data.
+        publish_file(metric_filename.str());
         }
 
         // read the reduced data
         if (my_saved_node_count > 1) {
-            struct stat buffer;
             std::map<std::string,uint64_t> reduced_metric_map;
             // wait on the map file from rank 0 to exist
             ostringstream metric_filename;
             metric_filename << metric_filename_prefix << "reduced." << 0;
-            while (stat (metric_filename.str().c_str(), &buffer) != 0) {}
-            // wait for the lock file from rank 0 to NOT exist
-            ostringstream lock_filename;
-            lock_filename << lock2_filename_prefix << "all";
-            while (stat (lock_filename.str().c_str(), &buffer) == 0) {}
+            wait_for_file(metric_filename.str());
             std::string metric_line;
             std::ifstream metric_file(metric_filename.str());
             std::string metric_name;
@@ -2623,15 +2458,10 @@ namespace apex {
     }
 
     std::string otf2_listener::write_my_threads(void) {
-        // create my lock file.
-        ostringstream lock_filename;
-        lock_filename << lock3_filename_prefix << my_saved_node_id;
-        ofstream lock_file(lock_filename.str(), ios::out | ios::trunc );
-        lock_file.close();
         // open my thread file
         ostringstream thread_filename;
         thread_filename << thread_filename_prefix << my_saved_node_id;
-        ofstream thread_file(thread_filename.str(), ios::out | ios::trunc );
+        ofstream thread_file(thread_filename.str() + ".tmp", ios::out | ios::trunc );
         // first, output our number of threads.
         //thread_file << thread_instance::get_num_threads() << endl;
         thread_file << _event_threads.size() << endl;
@@ -2641,8 +2471,8 @@ namespace apex {
         }
         // close the thread file
         thread_file.close();
-        // delete the lock file, so rank 0 can read our data.
-        std::remove(lock_filename.str().c_str());
+        // publish the file, so rank 0 can read our data.
+        publish_file(thread_filename.str());
         return std::string();
     }
 
@@ -2650,11 +2480,6 @@ namespace apex {
         write_my_threads();
 
         if (my_saved_node_id == 0) {
-        // create my lock file.
-        ostringstream my_lock_filename;
-        my_lock_filename << lock3_filename_prefix << "all";
-        ofstream lock_file(my_lock_filename.str(), ios::out | ios::trunc );
-        lock_file.close();
         // iterate over my thread map, and build a map of strings to ids
         // save my number of threads
         std::map<uint32_t, std::string> thread_name_map;
@@ -2665,15 +2490,10 @@ namespace apex {
         // iterate over the other ranks in the index file
         for (int i = 1 ; i < my_saved_node_count ; i++) {
             std::map<uint32_t, std::string> tmp_thread_name_map;
-            struct stat buffer;
             // wait on the map file to exist
             ostringstream thread_filename;
             thread_filename << thread_filename_prefix << i;
-            while (stat (thread_filename.str().c_str(), &buffer) != 0) {}
-            // wait for the lock file to not exist
-            ostringstream lock_filename;
-            lock_filename << lock3_filename_prefix << i;
-            while (stat (lock_filename.str().c_str(), &buffer) == 0) {}
+            wait_for_file(thread_filename.str());
             // get the number of threads from that rank
             std::string thread_line;
             std::ifstream thread_file(thread_filename.str());
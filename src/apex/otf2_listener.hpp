@@ -12,6 +12,7 @@
 #include "event_listener.hpp"
 #include <otf2/otf2.h>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <string>
 #include <tuple>
@@ -142,7 +143,7 @@ namespace apex {
         bool event_file_exists (uint32_t threadid);
         OTF2_DefWriter* getDefWriter(uint32_t threadid);
         OTF2_GlobalDefWriter* global_def_writer;
-        std::map<task_identifier,uint64_t>& get_region_indices(void);
+        std::unordered_map<uint32_t,uint64_t>& get_region_indices(void);
         std::map<std::string,uint64_t> global_string_indices;
         std::map<std::string,uint64_t>& get_string_indices(void);
         std::map<task_identifier,uint64_t> global_region_indices;
@@ -169,9 +170,6 @@ namespace apex {
         void write_clock_properties(void);
         void write_host_properties(int rank, int pid, std::string& hostname);
         std::string index_filename;
-        std::string lock_filename_prefix;
-        std::string lock2_filename_prefix;
-        std::string lock3_filename_prefix;
         std::string region_filename_prefix;
         std::string metric_filename_prefix;
         std::string thread_filename_prefix;
@@ -179,6 +177,8 @@ namespace apex {
         std::string write_my_node_properties(void);
         static int my_saved_node_id;
         static int my_saved_node_count;
+        static void wait_for_file(const std::string& name);
+        static void publish_file(const std::string& name);
         std::map<int,int> rank_thread_map;
         std::map<int,int> rank_region_map;
         std::map<int,int> rank_metric_map;
@@ -218,6 +218,14 @@ namespace apex {
             this->my_saved_node_id = node_id;
             this->my_saved_node_count = node_count;
         }
+        listener_mask subscriptions(void) const {
+            return all_listener_events &
+                ~(APEX_LISTEN(LISTEN_NEW_NODE) | APEX_LISTEN(LISTEN_DUMP) |
+                  APEX_LISTEN(LISTEN_RESET) |
+                  APEX_LISTEN(LISTEN_TASK_COMPLETE) |
+                  APEX_LISTEN(LISTEN_PERIODIC) |
+                  APEX_LISTEN(LISTEN_CUSTOM_EVENT));
+        }
         void on_startup(startup_event_data &data);
         void on_dump(dump_event_data &data);
         void on_reset(task_identifier * id)
@@ -19,6 +19,12 @@ class perfetto_listener : public event_listener {
 public:
   	perfetto_listener (void);
   	~perfetto_listener (void);
+  	listener_mask subscriptions(void) const {
+  	    return APEX_LISTEN(LISTEN_STARTUP) | APEX_LISTEN(LISTEN_SHUTDOWN) |
+  	        APEX_LISTEN(LISTEN_START) | APEX_LISTEN(LISTEN_STOP) |
+  	        APEX_LISTEN(LISTEN_YIELD) | APEX_LISTEN(LISTEN_RESUME) |
+  	        APEX_LISTEN(LISTEN_SAMPLE_VALUE);
+  	}
   	void on_startup(startup_event_data &data);
   	void on_dump(dump_event_data &data);
   	void on_reset(task_identifier * id) { APEX_UNUSED(id); };
@@ -146,82 +146,66 @@ namespace apex {
         int id = next_id++;
         std::shared_ptr<policy_instance> instance(
                 std::make_shared<policy_instance>(id, f));
+        write_lock_type l(policies_mutex);
         switch(when) {
             case APEX_STARTUP: {
-                //write_lock_type l(startup_mutex);
                 startup_policies.push_back(instance);
                 break;
             }
             case APEX_SHUTDOWN: {
-                //write_lock_type l(shutdown_mutex);
                 shutdown_policies.push_back(instance);
                 break;
             }
             case APEX_NEW_NODE: {
-                //write_lock_type l(new_node_mutex);
                 new_node_policies.push_back(instance);
                 break;
             }
             case APEX_NEW_THREAD: {
-                //write_lock_type l(new_thread_mutex);
                 new_thread_policies.push_back(instance);
                 break;
             }
             case APEX_EXIT_THREAD: {
-                //write_lock_type l(exit_thread_mutex);
                 exit_thread_policies.push_back(instance);
                 break;
             }
             case APEX_START_EVENT: {
-                //write_lock_type l(start_event_mutex);
                 start_event_policies.push_back(instance);
                 break;
             }
             case APEX_RESUME_EVENT: {
-                //write_lock_type l(resume_event_mutex);
                 resume_event_policies.push_back(instance);
                 break;
             }
             case APEX_STOP_EVENT: {
-                //write_lock_type l(stop_event_mutex);
                 stop_event_policies.push_back(instance);
                 break;
             }
             case APEX_YIELD_EVENT: {
-                //write_lock_type l(yield_event_mutex);
                 yield_event_policies.push_back(instance);
                 break;
             }
             case APEX_SAMPLE_VALUE: {
-                //write_lock_type l(sample_value_mutex);
                 sample_value_policies.push_back(instance);
                 break;
             }
             case APEX_SEND: {
-                //write_lock_type l(sample_value_mutex);
                 send_policies.push_back(instance);
                 break;
             }
             case APEX_RECV: {
-                //write_lock_type l(sample_value_mutex);
                 recv_policies.push_back(instance);
                 break;
             }
             case APEX_PERIODIC: {
-                //write_lock_type l(periodic_mutex);
                 periodic_policies.push_back(instance);
                 break;
             }
             //case APEX_CUSTOM_EVENT_1:
             default: {
-                //write_lock_type l(custom_event_mutex);
-                static std::mutex foo;
-                foo.lock();
                 if(custom_event_policies.find(when) == custom_event_policies.end()) {
                     std::list<std::shared_ptr<policy_instance> > new_list;
                     custom_event_policies.insert(std::make_pair(when, std::move(new_list)));
                 }
-                foo.unlock();
                 custom_event_policies[when].push_back(instance);
                 break;
             }
@@ -249,9 +233,9 @@ namespace apex {
             usleep(apex_options::policy_drain_timeout()); // sleep 1ms
 #endif
         }
+        write_lock_type l(policies_mutex);
         switch(handle->event_type) {
             case APEX_STARTUP: {
-                //write_lock_type l(startup_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = startup_policies.begin() ;
                     it != startup_policies.end() ; it++) {
@@ -264,7 +248,6 @@ namespace apex {
                 break;
             }
             case APEX_SHUTDOWN: {
-                //write_lock_type l(shutdown_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = shutdown_policies.begin() ;
                     it != shutdown_policies.end() ; it++) {
@@ -277,7 +260,6 @@ namespace apex {
                 break;
             }
             case APEX_NEW_NODE: {
-                //write_lock_type l(new_node_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = new_node_policies.begin() ;
                     it != new_node_policies.end() ; it++) {
@@ -290,7 +272,6 @@ namespace apex {
                 break;
             }
             case APEX_NEW_THREAD: {
-                //write_lock_type l(new_thread_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = new_thread_policies.begin() ;
                     it != new_thread_policies.end() ; it++) {
@@ -303,7 +284,6 @@ namespace apex {
                 break;
             }
             case APEX_EXIT_THREAD: {
-                //write_lock_type l(exit_thread_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = exit_thread_policies.begin() ;
                     it != exit_thread_policies.end() ; it++) {
@@ -316,7 +296,6 @@ namespace apex {
                 break;
             }
             case APEX_START_EVENT: {
-                //write_lock_type l(start_event_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = start_event_policies.begin() ;
                     it != start_event_policies.end() ; it++) {
@@ -329,7 +308,6 @@ namespace apex {
                 break;
             }
             case APEX_RESUME_EVENT: {
-                //write_lock_type l(resume_event_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = resume_event_policies.begin() ;
                     it != resume_event_policies.end() ; it++) {
@@ -342,7 +320,6 @@ namespace apex {
                 break;
             }
             case APEX_STOP_EVENT: {
-                //write_lock_type l(stop_event_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = stop_event_policies.begin() ;
                     it != stop_event_policies.end() ; it++) {
@@ -355,7 +332,6 @@ namespace apex {
                 break;
             }
             case APEX_YIELD_EVENT: {
-                //write_lock_type l(yield_event_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = yield_event_policies.begin() ;
                     it != yield_event_policies.end() ; it++) {
@@ -368,7 +344,6 @@ namespace apex {
                 break;
             }
             case APEX_SAMPLE_VALUE: {
-                //write_lock_type l(sample_value_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = sample_value_policies.begin() ;
                     it != sample_value_policies.end() ; it++) {
@@ -381,7 +356,6 @@ namespace apex {
                 break;
             }
             case APEX_SEND: {
-                //write_lock_type l(send_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = send_policies.begin() ;
                     it != send_policies.end() ; it++) {
@@ -394,7 +368,6 @@ namespace apex {
                 break;
             }
             case APEX_RECV: {
-                //write_lock_type l(recv_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = recv_policies.begin() ;
                     it != recv_policies.end() ; it++) {
@@ -407,7 +380,6 @@ namespace apex {
                 break;
             }
             case APEX_PERIODIC: {
-                //write_lock_type l(periodic_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = periodic_policies.begin() ;
                     it != periodic_policies.end() ; it++) {
@@ -427,7 +399,6 @@ namespace apex {
             }
             //case APEX_CUSTOM_EVENT_1:
             default: {
-                //write_lock_type l(custom_event_mutex);
                 std::list<std::shared_ptr<policy_instance> >::iterator it;
                 for(it = custom_event_policies[handle->event_type].begin() ; it
                     != custom_event_policies[handle->event_type].end() ; it++) {
@@ -445,6 +416,52 @@ namespace apex {
         return APEX_NOERROR;
     }
 
+    listener_mask policy_handler::subscriptions(void) const {
+        // we always have to stop the periodic timer at shutdown
+        listener_mask mask = APEX_LISTEN(LISTEN_SHUTDOWN);
+        read_lock_type l(policies_mutex);
+        if (!startup_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_STARTUP);
+        }
+        if (!new_node_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_NEW_NODE);
+        }
+        if (!new_thread_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_NEW_THREAD);
+        }
+        if (!exit_thread_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_EXIT_THREAD);
+        }
+        if (!start_event_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_START);
+        }
+        if (!stop_event_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_STOP);
+        }
+        if (!yield_event_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_YIELD);
+        }
+        if (!resume_event_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_RESUME);
+        }
+        if (!sample_value_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_SAMPLE_VALUE);
+        }
+        if (!send_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_SEND);
+        }
+        if (!recv_policies.empty()) {
+            mask |= APEX_LISTEN(LISTEN_RECV);
+        }
+        for (auto& custom : custom_event_policies) {
+            if (!custom.second.empty()) {
+                mask |= APEX_LISTEN(LISTEN_CUSTOM_EVENT);
+                break;
+            }
+        }
+        return mask;
+    }
+
     inline void policy_handler::call_policies(
             const std::list<std::shared_ptr<policy_instance> > & policies,
             void *data, const apex_event_type& event_type) {
@@ -64,20 +64,9 @@ private:
     std::list<std::shared_ptr<policy_instance> > periodic_policies;
     std::map<apex_event_type, std::list<std::shared_ptr<policy_instance > > >
         custom_event_policies;
-    shared_mutex_type startup_mutex;
-    shared_mutex_type shutdown_mutex;
-    shared_mutex_type new_node_mutex;
-    shared_mutex_type new_thread_mutex;
-    shared_mutex_type exit_thread_mutex;
-    shared_mutex_type start_event_mutex;
-    shared_mutex_type stop_event_mutex;
-    shared_mutex_type yield_event_mutex;
-    shared_mutex_type resume_event_mutex;
-    shared_mutex_type sample_value_mutex;
-    shared_mutex_type send_mutex;
-    shared_mutex_type recv_mutex;
-    shared_mutex_type custom_event_mutex;
-    shared_mutex_type periodic_mutex;
+    /* Guards the lists against each other's updates and subscriptions().
+     * Calling the policies doesn't take it, see call_policies(). */
+    mutable shared_mutex_type policies_mutex;
     void call_policies(
         const std::list<std::shared_ptr<policy_instance> > & policies,
         void *event_data, const apex_event_type& event_type);
@@ -92,6 +81,9 @@ public:
 */
     policy_handler(uint64_t period_microseconds);
     ~policy_handler (void) { };
+    /* Only the events that have policies, so that the others don't
+     * cost anything. */
+    listener_mask subscriptions(void) const;
     void on_startup(startup_event_data &data);
     void on_dump(dump_event_data &data);
     void on_reset(task_identifier * id)
@@ -55,6 +55,9 @@ using namespace std;
 #endif
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <algorithm>
 
 namespace apex {
 
@@ -132,51 +135,104 @@ namespace apex {
     }
 
 
+    proc_file::proc_file(const char * path) :
+        fd(open(path, O_RDONLY | O_CLOEXEC)), buffer(4096) { }
+
+    proc_file::~proc_file(void) {
+        if (fd >= 0) { close(fd); }
+    }
+
+    const char * proc_file::read(void) {
+        if (fd < 0) { return nullptr; }
+        size_t length = 0;
+        while (true) {
+            // leave room for the terminator
+            ssize_t bytes = pread(fd, buffer.data() + length,
+                buffer.size() - length - 1, length);
+            if (bytes < 0) {
+                if (errno == EINTR) { continue; }
+                return nullptr;
+            }
+            if (bytes == 0) { break; }
+            length += bytes;
+            if (length + 1 == buffer.size()) {
+                buffer.resize(buffer.size() * 2);
+            }
+        }
+        buffer[length] = '\0';
+        return buffer.data();
+    }
+
+    /* A tokenizer for the /proc files, that doesn't allocate. */
+    static inline const char * skip_space(const char * p) {
+        while (*p == ' ' || *p == '\t') { p++; }
+        return p;
+    }
+
+    static inline const char * end_of_line(const char * p) {
+        while (*p != '\0' && *p != '\n') { p++; }
+        return p;
+    }
+
+    static inline const char * end_of_word(const char * p) {
+        while (*p != '\0' && !isspace((unsigned char)*p) && *p != ':') { p++; }
+        return p;
+    }
+
+    static inline bool starts_with(const char * p, const char * end,
+        const char * prefix) {
+        size_t length = strlen(prefix);
+        return (size_t)(end - p) >= length && strncmp(p, prefix, length) == 0;
+    }
+
     ProcData* parse_proc_stat(void) {
         if (!apex_options::use_proc_stat()) return nullptr;
 
-        /*  Reading proc/stat as a file  */
-        FILE * pFile;
-        char line[128];
-        char dummy[32];
-        pFile = fopen ("/proc/stat","r");
+        static proc_file file("/proc/stat");
+        const char * p = file.read();
+        if (p == nullptr) {
+            perror ("Error reading /proc/stat");
+            return nullptr;
+        }
         ProcData* procData = new ProcData();
-        if (pFile == nullptr) perror ("Error opening file");
-        else {
-            CPUStat* cpu_stat;
-            while ( fgets( line, 128, pFile)) {
-                if ( strncmp (line, "cpu", 3) == 0 ) {
-                    cpu_stat = new CPUStat();
-                    /*  Note, this will only work on linux 2.6.24 through 3.5  */
-                    sscanf(line, "%s %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
-                            cpu_stat->name, &cpu_stat->user, &cpu_stat->nice,
-                            &cpu_stat->system, &cpu_stat->idle,
-                            &cpu_stat->iowait, &cpu_stat->irq, &cpu_stat->softirq,
-                            &cpu_stat->steal, &cpu_stat->guest);
-                    procData->cpus.push_back(cpu_stat);
-                }
-                else if ( strncmp (line, "ctxt", 4) == 0 ) {
-                    sscanf(line, "%s %lld\n", dummy, &procData->ctxt);
-                } else if ( strncmp (line, "btime", 5) == 0 ) {
-                    sscanf(line, "%s %lld\n", dummy, &procData->btime);
-                } else if ( strncmp (line, "processes", 9) == 0 ) {
-                    sscanf(line, "%s %ld\n", dummy, &procData->processes);
-                } else if ( strncmp (line, "procs_running", 13) == 0 ) {
-                    sscanf(line, "%s %ld\n", dummy, &procData->procs_running);
-                } else if ( strncmp (line, "procs_blocked", 13) == 0 ) {
-                    sscanf(line, "%s %ld\n", dummy, &procData->procs_blocked);
-                    //} else if ( strncmp (line, "softirq", 5) == 0 ) {
-                    // softirq 10953997190 0 1380880059 1495447920 1585783785...
-                    // ...15525789 0 12 661586214 0 1519806115
-                    //sscanf(line, "%s %d\n", dummy, &procData->btime);
-                }
-                // don't waste time parsing anything but the mean
-                if (!apex_options::use_proc_stat_details()) {
-                    break;
+        while (*p != '\0') {
+            const char * eol = end_of_line(p);
+            const char * key_end = end_of_word(p);
+            const char * value = key_end;
+            if (starts_with(p, key_end, "cpu")) {
+                CPUStat* cpu_stat = new CPUStat();
+                size_t length = std::min((size_t)(key_end - p),
+                    sizeof(cpu_stat->name) - 1);
+                memcpy(cpu_stat->name, p, length);
+                cpu_stat->name[length] = '\0';
+                /*  Note, this will only work on linux 2.6.24 and later  */
+                long long * fields[] = { &cpu_stat->user, &cpu_stat->nice,
+                    &cpu_stat->system, &cpu_stat->idle, &cpu_stat->iowait,
+                    &cpu_stat->irq, &cpu_stat->softirq, &cpu_stat->steal,
+                    &cpu_stat->guest };
+                for (auto field : fields) {
+                    char * next;
+                    *field = strtoll(value, &next, 10);
+                    value = next;
                 }
+                procData->cpus.push_back(cpu_stat);
+            } else if (starts_with(p, key_end, "ctxt")) {
+                procData->ctxt = strtoll(value, nullptr, 10);
+            } else if (starts_with(p, key_end, "btime")) {
+                procData->btime = strtoll(value, nullptr, 10);
+            } else if (starts_with(p, key_end, "processes")) {
+                procData->processes = strtol(value, nullptr, 10);
+            } else if (starts_with(p, key_end, "procs_running")) {
+                procData->procs_running = strtol(value, nullptr, 10);
+            } else if (starts_with(p, key_end, "procs_blocked")) {
+                procData->procs_blocked = strtol(value, nullptr, 10);
             }
+            // don't waste time parsing anything but the mean
+            if (!apex_options::use_proc_stat_details()) {
+                break;
+            }
+            p = (*eol == '\0') ? eol : eol + 1;
         }
-        fclose (pFile);
 #if defined(APEX_HAVE_CRAY_POWER)
         read_cray_power(procData->cray_power_units, procData->cray_power_values);
 #endif
@@ -349,6 +405,7 @@ namespace apex {
     }
 
     void ProcData::sample_values(void) {
+        if (cpus.empty()) { return; }
         double total;
         CPUs::iterator iter = cpus.begin();
         CPUStat* cpu_stat=*iter;
@@ -356,32 +413,47 @@ namespace apex {
                 cpu_stat->idle + cpu_stat->iowait + cpu_stat->irq + cpu_stat->softirq +
                 cpu_stat->steal + cpu_stat->guest);
         total = total * 0.01; // so we have a percentage in the final values
-        sample_value("CPU User %",     ((double)(cpu_stat->user))    / total);
-        sample_value("CPU Nice %",     ((double)(cpu_stat->nice))    / total);
-        sample_value("CPU System %",   ((double)(cpu_stat->system))  / total);
-        sample_value("CPU Idle %",     ((double)(cpu_stat->idle))    / total);
-        sample_value("CPU I/O Wait %", ((double)(cpu_stat->iowait))  / total);
-        sample_value("CPU IRQ %",      ((double)(cpu_stat->irq))     / total);
-        sample_value("CPU soft IRQ %", ((double)(cpu_stat->softirq)) / total);
-        sample_value("CPU Steal %",    ((double)(cpu_stat->steal))   / total);
-        sample_value("CPU Guest %",    ((double)(cpu_stat->guest))   / total);
+        static const apex_counter_handle cpu_counters[] = {
+            register_counter("CPU User %"),
+            register_counter("CPU Nice %"),
+            register_counter("CPU System %"),
+            register_counter("CPU Idle %"),
+            register_counter("CPU I/O Wait %"),
+            register_counter("CPU IRQ %"),
+            register_counter("CPU soft IRQ %"),
+            register_counter("CPU Steal %"),
+            register_counter("CPU Guest %") };
+        sample_value(cpu_counters[0], ((double)(cpu_stat->user))    / total);
+        sample_value(cpu_counters[1], ((double)(cpu_stat->nice))    / total);
+        sample_value(cpu_counters[2], ((double)(cpu_stat->system))  / total);
+        sample_value(cpu_counters[3], ((double)(cpu_stat->idle))    / total);
+        sample_value(cpu_counters[4], ((double)(cpu_stat->iowait))  / total);
+        sample_value(cpu_counters[5], ((double)(cpu_stat->irq))     / total);
+        sample_value(cpu_counters[6], ((double)(cpu_stat->softirq)) / total);
+        sample_value(cpu_counters[7], ((double)(cpu_stat->steal))   / total);
+        sample_value(cpu_counters[8], ((double)(cpu_stat->guest))   / total);
         if (apex_options::use_proc_stat_details()) {
             iter++;
             int index = 0;
             int width = 1;
             if (cpus.size() > 100) { width = 3; }
             else if (cpus.size() > 10) { width = 2; }
+            // the names don't change, so only register them once
+            static std::vector<apex_counter_handle> counters;
             while (iter != cpus.end()) {
-                std::stringstream id;
-                id << std::setfill('0');
+                if ((size_t)index >= counters.size()) {
+                    std::stringstream id;
+                    id << std::setfill('0');
+                    id << "CPU_" << std::setw(width) << index << " Utilized %";
+                    counters.push_back(register_counter(id.str()));
+                }
                 CPUStat* cpu_stat=*iter;
                 total = (double)(cpu_stat->user + cpu_stat->nice + cpu_stat->system +
                         cpu_stat->idle + cpu_stat->iowait + cpu_stat->irq + cpu_stat->softirq +
                         cpu_stat->steal + cpu_stat->guest);
                 double busy = total - cpu_stat->idle;
                 total = total * 0.01; // so we have a percentage in the final values
-                id << "CPU_" << std::setw(width) << index << " Utilized %";
-                sample_value(id.str(), busy / total);
+                sample_value(counters[index], busy / total);
                 /*
                 id << "CPU_" << std::setw(width) << index << " User %";
                 sample_value(id.str(), ((double)(cpu_stat->user)) / total);
@@ -473,277 +545,116 @@ namespace apex {
     bool parse_proc_loadavg() {
         if (!apex_options::use_proc_loadavg()) return false;
 
-        FILE *f = fopen("/proc/loadavg", "r");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                tmp = trim(tmp);
-                // check for empty line
-                if (tmp.size() == 0) continue;
-                const REGEX_NAMESPACE::regex separator("0");
-                REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(), tmp.end(),
-                        separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string value = *token;
-                if (value.size() == 0) continue;
-                char* pEnd;
-                double d1 = strtod (value.c_str(), &pEnd);
-                string cname("1 Minute Load average");
-                if (pEnd) { sample_value(cname, d1); }
-            }
-            fclose(f);
-        } else {
-            return false;
+        static proc_file file("/proc/loadavg");
+        const char * p = file.read();
+        if (p == nullptr) { return false; }
+        // the first field is the 1 minute average
+        char * end;
+        double d1 = strtod(p, &end);
+        if (end != p) {
+            static apex_counter_handle counter =
+                register_counter("1 Minute Load average");
+            sample_value(counter, d1);
         }
         return true;
     }
 
-    bool parse_proc_meminfo() {
-        if (!apex_options::use_proc_meminfo()) return false;
-        FILE *f = fopen("/proc/meminfo", "r");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                const REGEX_NAMESPACE::regex separator(":");
-                REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(), tmp.end(),
-                        separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string name = *token++;
-                if (token != end) {
-                    string value = *token;
-                    char* pEnd;
-                    double d1 = strtod (value.c_str(), &pEnd);
-                    string mname("meminfo:" + name);
-                    if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                        if( pEnd[len-1] == '\n' )
-                            pEnd[len-1] = 0;
-                        mname.append(pEnd);
-                    }
-                    if (pEnd) { sample_value(mname, d1); }
-                }
+    /* Sample the "key: value [unit]" lines of a /proc file that pass the
+     * filter, as "<prefix><key>[ unit]". */
+    template<typename F>
+    static bool parse_key_values(proc_file& file, proc_counters& counters,
+        const char * prefix, bool with_unit, F filter) {
+        const char * p = file.read();
+        if (p == nullptr) { return false; }
+        for (size_t index = 0 ; *p != '\0' ; index++) {
+            const char * eol = end_of_line(p);
+            const char * colon = static_cast<const char*>(
+                memchr(p, ':', eol - p));
+            if (colon != nullptr && filter(p, colon, eol)) {
+                char * unit;
+                double d1 = strtod(colon + 1, &unit);
+                apex_counter_handle counter = counters.get(index, p, colon - p,
+                    [&]() {
+                        std::string name(prefix);
+                        name.append(p, colon);
+                        if (with_unit) { name.append((const char*)unit, eol); }
+                        return name;
+                    });
+                sample_value(counter, d1);
             }
-            fclose(f);
-        } else {
-            return false;
+            p = (*eol == '\0') ? eol : eol + 1;
         }
         return true;
     }
 
+    bool parse_proc_meminfo() {
+        if (!apex_options::use_proc_meminfo()) return false;
+        static proc_file file("/proc/meminfo");
+        static proc_counters counters;
+        return parse_key_values(file, counters, "meminfo:", true,
+            [](const char *, const char *, const char *) { return true; });
+    }
+
     bool parse_proc_self_status() {
         if (!apex_options::use_proc_self_status()) return false;
-        FILE *f = fopen("/proc/self/status", "r");
-        const std::string vm_prefix("Vm");
-        const std::string thread_prefix("Threads");
-        const std::string ctx_substr("ctxt_switches");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                if (!tmp.compare(0,vm_prefix.size(),vm_prefix)) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
-                }
-                if (!tmp.compare(0,thread_prefix.size(),thread_prefix)) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
-                }
-                if (tmp.find(ctx_substr) != tmp.npos) {
-                    const REGEX_NAMESPACE::regex separator(":");
-                    REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(),
-                            tmp.end(), separator, -1);
-                    REGEX_NAMESPACE::sregex_token_iterator end;
-                    string name = *token++;
-                    if (token != end) {
-                        string value = *token;
-                        char* pEnd;
-                        double d1 = strtod (value.c_str(), &pEnd);
-                        string mname("status:" + name);
-                        if (pEnd != NULL) {
-                        int len = strlen(pEnd);
-                            if( pEnd[len-1] == '\n' )
-                                pEnd[len-1] = 0;
-                            mname.append(pEnd);
-                        }
-                        if (pEnd) { sample_value(mname, d1); }
-                    }
-                }
-            }
-            fclose(f);
-        } else {
-            return false;
-        }
-        return true;
+        static proc_file file("/proc/self/status");
+        static proc_counters counters;
+        static const char ctx_substr[] = "ctxt_switches";
+        return parse_key_values(file, counters, "status:", true,
+            [](const char * p, const char * colon, const char * eol) {
+                return starts_with(p, colon, "Vm") ||
+                    starts_with(p, colon, "Threads") ||
+                    std::search(p, eol, ctx_substr,
+                        ctx_substr + sizeof(ctx_substr) - 1) != eol;
+            });
     }
 
     bool parse_proc_self_io() {
         if (!apex_options::use_proc_self_io()) return false;
-        FILE *f = fopen("/proc/self/io", "r");
-        if (f) {
-            char line[4096] = {0};
-            while ( fgets( line, 4096, f)) {
-                string tmp(line);
-                const REGEX_NAMESPACE::regex separator(":");
-                REGEX_NAMESPACE::sregex_token_iterator token(tmp.begin(), tmp.end(),
-                        separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string name = *token++;
-                if (token != end) {
-                    string value = *token;
-                    char* pEnd;
-                    double d1 = strtod (value.c_str(), &pEnd);
-                    string mname("io:" + name);
-                    if (pEnd) { sample_value(mname, d1); }
-                }
-            }
-            fclose(f);
-        } else {
-            return false;
-        }
-        return true;
+        static proc_file file("/proc/self/io");
+        static proc_counters counters;
+        return parse_key_values(file, counters, "io:", false,
+            [](const char *, const char *, const char *) { return true; });
     }
 
     bool parse_proc_netdev() {
         if (!apex_options::use_proc_net_dev()) return false;
-        FILE *f = fopen("/proc/self/net/dev", "r");
-        if (f) {
-            char line[4096] = {0};
-            char * rc = fgets(line, 4096, f); // skip this line
-            if (rc == nullptr) {
-                fclose(f);
-                return false;
+        static proc_file file("/proc/self/net/dev");
+        static proc_counters counters;
+        static const char * fields[] = {
+            ".receive.bytes", ".receive.packets", ".receive.errs",
+            ".receive.drop", ".receive.fifo", ".receive.frame",
+            ".receive.compressed", ".receive.multicast",
+            ".transmit.bytes", ".transmit.packets", ".transmit.errs",
+            ".transmit.drop", ".transmit.fifo", ".transmit.colls",
+            ".transmit.carrier", ".transmit.compressed" };
+        constexpr size_t num_fields = sizeof(fields) / sizeof(fields[0]);
+        const char * p = file.read();
+        if (p == nullptr) { return false; }
+        for (size_t line = 0 ; *p != '\0' ; line++) {
+            const char * eol = end_of_line(p);
+            // skip the two header lines
+            if (line < 2) {
+                p = (*eol == '\0') ? eol : eol + 1;
+                continue;
             }
-            rc = fgets(line, 4096, f); // skip this line
-            if (rc == nullptr) {
-                fclose(f);
-                return false;
+            const char * devname = skip_space(p);
+            const char * devname_end = end_of_word(devname);
+            const char * value = devname_end;
+            if (*value == ':') { value++; }
+            for (size_t i = 0 ; i < num_fields && value < eol ; i++) {
+                char * next;
+                double d1 = strtod(value, &next);
+                if (next == value) { break; }
+                value = next;
+                apex_counter_handle counter = counters.get(
+                    (line - 2) * num_fields + i, devname,
+                    devname_end - devname, [&]() {
+                        return std::string(devname, devname_end) + fields[i];
+                    });
+                sample_value(counter, d1);
             }
-            while (fgets(line, 4096, f)) {
-                string outer_tmp(line);
-                outer_tmp = trim(outer_tmp);
-                const REGEX_NAMESPACE::regex separator("[|:\\s]+");
-                REGEX_NAMESPACE::sregex_token_iterator token(outer_tmp.begin(),
-                        outer_tmp.end(), separator, -1);
-                REGEX_NAMESPACE::sregex_token_iterator end;
-                string devname = *token++; // device name
-                string tmp = *token++;
-                char* pEnd;
-                double d1 = strtod (tmp.c_str(), &pEnd);
-                string cname = devname + ".receive.bytes";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.packets";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.errs";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.drop";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.fifo";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.frame";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.compressed";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".receive.multicast";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.bytes";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.packets";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.errs";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.drop";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.fifo";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.colls";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.carrier";
-                sample_value(cname, d1);
-
-                tmp = *token++;
-                d1 = strtod (tmp.c_str(), &pEnd);
-                cname = devname + ".transmit.compressed";
-                sample_value(cname, d1);
-            }
-            fclose(f);
-        } else {
-            return false;
+            p = (*eol == '\0') ? eol : eol + 1;
         }
         return true;
     }
@@ -766,19 +677,28 @@ namespace apex {
     }
 
     /* This is the main function for the reader thread. */
-    //void* proc_data_reader::read_proc(void * _ptw) {
-    void* proc_data_reader::read_proc() {
-        in_apex prevent_deadlocks;
-        // when tracking memory allocations, ignore these
-        in_apex prevent_nonsense;
-        //pthread_wrapper* ptw = (pthread_wrapper*)_ptw;
-        // make sure APEX knows this is not a worker thread
-        thread_instance::instance(false).set_worker(false);
-        //ptw->_running = true;
-        if (apex_options::pin_apex_threads()) {
-            set_thread_affinity();
-        }
-        /* make sure the profiler_listener has a queue that this
+    proc_data_reader::proc_data_reader(void) : done(false),
+        initialized(false), timer(0), oldData(nullptr) {
+#ifdef APEX_HAVE_LM_SENSORS
+        mysensors = nullptr;
+#endif
+        // initialize right away on the timer thread, then sample periodically
+        timer = timer_wheel::instance().add(apex_options::proc_period(),
+            [this]() { read_proc(); }, 0);
+    }
+
+    void proc_data_reader::stop_reading(void) {
+        done = true;
+        if (timer != 0) {
+            // waits for a reading in progress
+            timer_wheel::instance().remove(timer);
+            timer = 0;
+        }
+        finalize();
+    }
+
+    void proc_data_reader::initialize(void) {
+        /* make sure the profiler_listener has a queue that the timer
          * thread can push sampled values to */
         apex::async_thread_setup();
         static bool _initialized = false;
@@ -786,17 +706,13 @@ namespace apex {
             initialize_worker_thread_for_tau();
             _initialized = true;
         }
-        if (apex_options::use_tau()) {
-            tau_listener::Tau_start_wrapper("proc_data_reader::read_proc");
-        }
-        if (done) { return nullptr; }
 #if defined(APEX_HAVE_PAPI)
         initialize_papi_events();
 #endif
 #ifdef APEX_HAVE_LM_SENSORS
-        sensor_data * mysensors = new sensor_data();
+        mysensors = new sensor_data();
 #endif
-        ProcData *oldData = parse_proc_stat();
+        oldData = parse_proc_stat();
 #if defined(APEX_HAVE_PAPI)
         read_papi_components();
 #endif
@@ -812,8 +728,6 @@ namespace apex {
             mysensors->read_sensors();
         }
 #endif
-        ProcData *newData = nullptr;
-        ProcData *periodData = nullptr;
         if (apex_options::monitor_gpu()) {
             dynamic::nvml::query();
         }
@@ -823,77 +737,74 @@ namespace apex {
         if (apex_options::use_hip_profiler()) {
             dynamic::rocprofiler::query();
         }
-        // release the main thread to continue
-        while(!done /*&& ptw->wait()*/) {
-            incrementPeriod();
-            //usleep(apex_options::proc_period());
-            std::unique_lock<std::mutex> lk(proc_data_reader::cv_m);
-            // if we've been interrupted by the main thread, break and exit
-            if(cv.wait_for(lk, apex_options::proc_period()*1us) ==
-               std::cv_status::no_timeout) {
-               break;
-            }
-            if (done) break;
-            reading = true;
-            if (apex_options::use_tau()) {
-                tau_listener::Tau_start_wrapper("proc_data_reader::read_proc: main loop");
-            }
-            if (apex_options::use_proc_stat()) {
-                // take a reading
-                newData = parse_proc_stat();
-                periodData = newData->diff(*oldData);
+        initialized = true;
+    }
+
+    void proc_data_reader::finalize(void) {
+        if (!initialized) { return; }
+        initialized = false;
+#ifdef APEX_HAVE_LM_SENSORS
+        delete(mysensors);
+        mysensors = nullptr;
+#endif
+        if (apex_options::monitor_gpu()) {
+            dynamic::rsmi::stop();
+        }
+        if (apex_options::use_hip_profiler()) {
+            dynamic::rocprofiler::stop();
+        }
+        delete(oldData);
+        oldData = nullptr;
+    }
+
+    void proc_data_reader::read_proc(void) {
+        in_apex prevent_deadlocks;
+        if (done) { return; }
+        if (!initialized) {
+            initialize();
+            return;
+        }
+        incrementPeriod();
+        if (apex_options::use_tau()) {
+            tau_listener::Tau_start_wrapper("proc_data_reader::read_proc: main loop");
+        }
+        if (apex_options::use_proc_stat()) {
+            // take a reading
+            ProcData *newData = parse_proc_stat();
+            if (newData != nullptr && oldData != nullptr) {
+                ProcData *periodData = newData->diff(*oldData);
                 // save the values
-                if (done) break; // double-check...
                 periodData->sample_values();
-                // free the memory
-                delete(oldData);
                 delete(periodData);
-                oldData = newData;
             }
-            parse_proc_loadavg();
-            parse_proc_meminfo(); // some things change, others don't...
-            parse_proc_self_status();
-            parse_proc_self_io();
-            parse_proc_netdev();
+            // free the memory
+            delete(oldData);
+            oldData = newData;
+        }
+        parse_proc_loadavg();
+        parse_proc_meminfo(); // some things change, others don't...
+        parse_proc_self_status();
+        parse_proc_self_io();
+        parse_proc_netdev();
 #if defined(APEX_HAVE_PAPI)
-            read_papi_components();
+        read_papi_components();
 #endif
 
 #ifdef APEX_HAVE_LM_SENSORS
-            if (apex_options::use_lm_sensors()) {
-                mysensors->read_sensors();
-            }
-#endif
-            if (apex_options::monitor_gpu()) {
-                dynamic::nvml::query();
-                dynamic::rsmi::query();
-            }
-            if (apex_options::use_hip_profiler()) {
-                dynamic::rocprofiler::query();
-            }
-            if (apex_options::use_tau()) {
-                tau_listener::Tau_stop_wrapper("proc_data_reader::read_proc: main loop");
-            }
-            reading = false;
+        if (apex_options::use_lm_sensors()) {
+            mysensors->read_sensors();
         }
-        // in case we broke from while loop
-        reading = false;
-#ifdef APEX_HAVE_LM_SENSORS
-        delete(mysensors);
 #endif
-
         if (apex_options::monitor_gpu()) {
-            dynamic::rsmi::stop();
+            dynamic::nvml::query();
+            dynamic::rsmi::query();
         }
         if (apex_options::use_hip_profiler()) {
-            dynamic::rocprofiler::stop();
+            dynamic::rocprofiler::query();
         }
         if (apex_options::use_tau()) {
-            tau_listener::Tau_stop_wrapper("proc_data_reader::read_proc");
+            tau_listener::Tau_stop_wrapper("proc_data_reader::read_proc: main loop");
         }
-        delete(oldData);
-        //ptw->_running = false;
-        return nullptr;
     }
 
 #ifdef APEX_HAVE_MSR
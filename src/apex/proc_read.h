@@ -17,14 +17,13 @@
 #include <fstream>
 #include <unordered_set>
 #include <unordered_map>
-#include <condition_variable>
-#include <mutex>
 #include <atomic>
-#include <thread>
 #include <string>
 #include <memory>
 //#include "pthread_wrapper.hpp"
 #include "apex_options.hpp"
+#include "apex_api.hpp"
+#include "timer_wheel.hpp"
 
 namespace apex {
 
@@ -44,45 +43,77 @@ public:
 
 typedef std::vector<CPUStat*> CPUs;
 
-class proc_data_reader {
+/* A /proc file that is opened once, and re-read with pread() on every
+ * sample into a buffer that is reused.  The kernel generates the contents
+ * on each read, so the whole file is read in one pass. */
+class proc_file {
 private:
-    //pthread_wrapper * worker_thread;
-    std::atomic<bool> done;
-    std::atomic<bool> reading;
-    std::thread worker_thread;
-    std::condition_variable cv;
-    std::mutex cv_m;
-    static std::atomic<uint64_t> sample_period;
+    int fd;
+    std::vector<char> buffer;
 public:
-    /*
-    static void* read_proc(void * _pdr);
-    proc_data_reader(void) {
-        worker_thread = new pthread_wrapper(&proc_data_reader::read_proc,
-        (void*)(this), apex_options::proc_period());
-    };
-    */
-    void* read_proc(void);
-    proc_data_reader(void) : done(false), reading(false) {
-        worker_thread = std::thread(&proc_data_reader::read_proc, this);
-        worker_thread.detach();
-    }
+    proc_file(const char * path);
+    ~proc_file(void);
+    /* The contents, null terminated, or nullptr if the file can't be
+     * read.  Valid until the next call. */
+    const char * read(void);
+};
 
-    void stop_reading(void) {
-        done = true;
-        cv.notify_all();
-        //worker_thread->stop_thread();
-        if (worker_thread.joinable()) {
-            worker_thread.join();
-        }
-        if(reading) {
-            // this is helpful if we are sampling frequently
-            usleep(apex_options::proc_period());
+/* The counters for the lines of a /proc file.  Each counter is registered
+ * the first time its slot is used, and its handle is reused as long as
+ * the slot has the same key - so the names aren't rebuilt or looked up on
+ * every sample. */
+class proc_counters {
+private:
+    class slot {
+    public:
+        std::string key;
+        apex_counter_handle handle;
+        bool registered;
+        slot() : handle(0), registered(false) {}
+    };
+    std::vector<slot> slots;
+public:
+    template<typename F>
+    apex_counter_handle get(size_t index, const char * key, size_t length,
+        F make_name) {
+        if (index >= slots.size()) { slots.resize(index + 1); }
+        slot& s = slots[index];
+        if (!s.registered || s.key.compare(0, std::string::npos,
+            key, length) != 0) {
+            s.key.assign(key, length);
+            s.handle = register_counter(make_name());
+            s.registered = true;
         }
+        return s.handle;
     }
+};
+
+class ProcData;
+#ifdef APEX_HAVE_LM_SENSORS
+class sensor_data;
+#endif
 
+/* Samples the /proc files (and the other system counters) periodically.
+ * The reader runs on the timer_wheel thread, so it doesn't need a thread
+ * of its own. */
+class proc_data_reader {
+private:
+    std::atomic<bool> done;
+    bool initialized;
+    uint64_t timer; // our timer in the wheel, or zero
+    ProcData * oldData;
+#ifdef APEX_HAVE_LM_SENSORS
+    sensor_data * mysensors;
+#endif
+    static std::atomic<uint64_t> sample_period;
+    void initialize(void);
+    void finalize(void);
+public:
+    void read_proc(void);
+    proc_data_reader(void);
+    void stop_reading(void);
     ~proc_data_reader(void) {
         stop_reading();
-        //delete worker_thread;
     }
     static std::string get_command_line(void);
     static uint64_t getPeriod() { return sample_period; }
@@ -145,6 +145,35 @@ public:
         _profile.num_threads = thread_ids.size();
         _mtx.unlock();
     }
+    /* Fold a partial aggregate (accumulated privately by one thread)
+     * into this profile. */
+    void merge(const apex_profile &partial, uint64_t thread_id) {
+        if (partial.stops == 0.0) { return; }
+        _mtx.lock();
+        _profile.accumulated += partial.accumulated;
+        _profile.inclusive_accumulated += partial.inclusive_accumulated;
+        _profile.stops = _profile.stops + partial.stops;
+        _profile.calls = _profile.calls + partial.calls;
+#if APEX_HAVE_PAPI
+        for (int i = 0 ; i < 8 ; i++) {
+            _profile.papi_metrics[i] += partial.papi_metrics[i];
+        }
+#endif
+#ifdef FULL_STATISTICS
+        _profile.sum_squares += partial.sum_squares;
+        _profile.minimum = _profile.minimum > partial.minimum ?
+            partial.minimum : _profile.minimum;
+        _profile.maximum = _profile.maximum < partial.maximum ?
+            partial.maximum : _profile.maximum;
+#endif
+        _profile.allocations += partial.allocations;
+        _profile.frees += partial.frees;
+        _profile.bytes_allocated += partial.bytes_allocated;
+        _profile.bytes_freed += partial.bytes_freed;
+        thread_ids.insert(thread_id);
+        _profile.num_threads = thread_ids.size();
+        _mtx.unlock();
+    }
     void reset() {
         _mtx.lock();
         _profile.calls = 0.0;
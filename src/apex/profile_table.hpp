@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "task_identifier.hpp"
+#include "profile.hpp"
+#include <array>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace apex {
+
+/* The map of task_identifier to profile objects, split into shards.
+ * Each shard has its own mutex, so threads updating different timers
+ * don't all serialize on a single lock.  Profile objects are never
+ * removed from the table until shutdown, so pointers returned from
+ * the table stay valid after the shard lock is released. */
+class profile_table {
+public:
+    typedef std::unordered_map<task_identifier, profile*> map_type;
+    typedef std::vector<std::pair<task_identifier, profile*> > snapshot_type;
+    static constexpr size_t num_shards = 64;
+private:
+    /* pad each shard to its own cache line(s), so the mutexes
+     * don't false-share. */
+    struct alignas(64) shard {
+        std::mutex mtx;
+        map_type map;
+    };
+    std::array<shard, num_shards> _shards;
+    shard& get_shard(const task_identifier &id) {
+        size_t h = std::hash<task_identifier>()(id);
+        // mix the high bits down, the low bits of the hash aren't great
+        h ^= (h >> 17);
+        return _shards[h % num_shards];
+    }
+public:
+    profile_table(void) {}
+    ~profile_table(void) {}
+    /* Disable the copy and assign methods. */
+    profile_table(profile_table const&) = delete;
+    void operator=(profile_table const&) = delete;
+    /* Find the profile for this task, or nullptr. */
+    profile * find(const task_identifier &id) {
+        shard& s = get_shard(id);
+        std::unique_lock<std::mutex> l(s.mtx);
+        auto it = s.map.find(id);
+        if (it != s.map.end()) {
+            return it->second;
+        }
+        return nullptr;
+    }
+    /* Find the profile for this task.  If it doesn't exist, create it by
+     * calling the factory function while holding the shard lock, so only
+     * one thread creates it.  The "created" flag tells the caller which
+     * happened. */
+    template<typename Factory>
+    profile * find_or_create(const task_identifier &id, Factory make,
+        bool &created) {
+        shard& s = get_shard(id);
+        std::unique_lock<std::mutex> l(s.mtx);
+        auto it = s.map.find(id);
+        if (it != s.map.end()) {
+            created = false;
+            return it->second;
+        }
+        profile * p = make();
+        s.map.insert(std::pair<task_identifier,profile*>(id, p));
+        created = true;
+        return p;
+    }
+    /* Call the function on each profile, one shard locked at a time.
+     * Don't call back into the table from the function! */
+    template<typename Function>
+    void for_each(Function f) {
+        for (auto& s : _shards) {
+            std::unique_lock<std::mutex> l(s.mtx);
+            for (auto& kv : s.map) {
+                f(kv.first, kv.second);
+            }
+        }
+    }
+    /* Copy out the (id, profile) pairs, for output.  The profiles
+     * can still be updated by other threads after this returns. */
+    snapshot_type snapshot(void) {
+        snapshot_type tmp;
+        for_each([&tmp](const task_identifier& id, profile * p) {
+            tmp.push_back(std::pair<task_identifier,profile*>(id, p));
+        });
+        return tmp;
+    }
+    size_t size(void) {
+        size_t total = 0;
+        for (auto& s : _shards) {
+            std::unique_lock<std::mutex> l(s.mtx);
+            total += s.map.size();
+        }
+        return total;
+    }
+    /* Delete all profile objects and empty the table. */
+    void clear(void) {
+        for (auto& s : _shards) {
+            std::unique_lock<std::mutex> l(s.mtx);
+            for (auto& kv : s.map) {
+                delete kv.second;
+            }
+            s.map.clear();
+        }
+    }
+};
+
+/* Per-thread partial aggregates of the profiles in the table.  The owning
+ * thread accumulates into its own partials without touching the shared
+ * profile objects (or their mutexes).  The partials are folded into the
+ * shared profiles whenever the data is read: get_profile(), dump and reset.
+ * The mutex is only contended while another thread is folding. */
+class profile_partials {
+public:
+    struct partial {
+        apex_profile values;
+        profile * shared;
+        uint64_t thread_id;
+        partial(profile * p, uint64_t tid) : shared(p), thread_id(tid) {
+            clear();
+        }
+        void clear(void) {
+            memset(&values, 0, sizeof(apex_profile));
+            values.minimum = std::numeric_limits<double>::max();
+        }
+        /* Same as profile::increment, without the lock. */
+        void increment(double increase, double inclusive, int num_metrics,
+            double * papi_metrics, double allocations, double frees,
+            double bytes_allocated, double bytes_freed, bool yielded) {
+            values.accumulated += increase;
+            values.inclusive_accumulated += inclusive;
+            values.stops = values.stops + 1.0;
+#if APEX_HAVE_PAPI
+            for (int i = 0 ; i < num_metrics ; i++) {
+                values.papi_metrics[i] += papi_metrics[i];
+            }
+#else
+            APEX_UNUSED(num_metrics);
+            APEX_UNUSED(papi_metrics);
+#endif
+            values.sum_squares += (increase * increase);
+            values.minimum = values.minimum > increase ?
+                increase : values.minimum;
+            values.maximum = values.maximum < increase ?
+                increase : values.maximum;
+            if (!yielded) {
+                values.calls = values.calls + 1.0;
+            }
+            values.allocations += allocations;
+            values.frees += frees;
+            values.bytes_allocated += bytes_allocated;
+            values.bytes_freed += bytes_freed;
+        }
+        /* Add a batch of measurements, already aggregated. */
+        void add(const apex_profile &batch) {
+            values.accumulated += batch.accumulated;
+            values.inclusive_accumulated += batch.inclusive_accumulated;
+            values.stops = values.stops + batch.stops;
+            values.calls = values.calls + batch.calls;
+#if APEX_HAVE_PAPI
+            for (int i = 0 ; i < 8 ; i++) {
+                values.papi_metrics[i] += batch.papi_metrics[i];
+            }
+#endif
+            values.sum_squares += batch.sum_squares;
+            values.minimum = values.minimum > batch.minimum ?
+                batch.minimum : values.minimum;
+            values.maximum = values.maximum < batch.maximum ?
+                batch.maximum : values.maximum;
+            values.allocations += batch.allocations;
+            values.frees += batch.frees;
+            values.bytes_allocated += batch.bytes_allocated;
+            values.bytes_freed += batch.bytes_freed;
+        }
+        void fold(void) {
+            shared->merge(values, thread_id);
+            clear();
+        }
+    };
+    // keyed by the interned task id, so lookups never touch the name
+    typedef std::unordered_map<uint32_t, partial> map_type;
+    std::mutex mtx;
+    map_type map;
+    profile_partials(void) {}
+    /* Fold all partials into their shared profiles, and clear them. */
+    void fold(void) {
+        std::unique_lock<std::mutex> l(mtx);
+        for (auto& kv : map) {
+            kv.second.fold();
+        }
+    }
+    /* Fold the partial for one task into its shared profile. */
+    void fold(const task_identifier &id) {
+        std::unique_lock<std::mutex> l(mtx);
+        auto it = map.find(id.id);
+        if (it != map.end()) {
+            it->second.fold();
+        }
+    }
+    /* Throw away the partials, when the profiles are reset. */
+    void discard(void) {
+        std::unique_lock<std::mutex> l(mtx);
+        for (auto& kv : map) {
+            kv.second.clear();
+        }
+    }
+    void discard(const task_identifier &id) {
+        std::unique_lock<std::mutex> l(mtx);
+        auto it = map.find(id.id);
+        if (it != map.end()) {
+            it->second.clear();
+        }
+    }
+};
+
+}
+
@@ -23,6 +23,7 @@ class profiler;
 #include "apex_assert.h"
 #include "apex_clock.hpp"
 #include "task_wrapper.hpp"
+#include "slab_pool.hpp"
 
 namespace apex {
 
@@ -63,6 +64,16 @@ public:
     // needed for correct Hatchet output
     uint64_t thread_id;
     std::map<std::string, double> metric_map;
+    /* A profiler is created and destroyed for every timer, so they
+     * come from a per-thread slab_pool, not the global allocator. */
+    static void * operator new(std::size_t size) {
+        if (size != sizeof(profiler)) { return ::operator new(size); }
+        return slab_pool<sizeof(profiler)>::allocate_block();
+    }
+    static void operator delete(void * p, std::size_t size) {
+        if (size != sizeof(profiler)) { ::operator delete(p); return; }
+        slab_pool<sizeof(profiler)>::release_block(p);
+    }
     task_identifier * get_task_id(void) {
         return task_id;
     }
@@ -71,11 +71,10 @@ const int num_non_worker_threads_registered = 1; // including the main thread
 //bool synchronous_flush{false};
 #endif
 
-#define APEX_SYNCHRONOUS_PROCESSING 1
-
 #include "tau_listener.hpp"
 #include "utils.hpp"
 #include "profile_reducer.hpp"
+#include "batch_stats.hpp"
 
 #include <cstdlib>
 #include <ctime>
@@ -110,7 +109,8 @@ std::unordered_set<profile*> free_profiles;
 
     /* We do this in two stages, to make the common case fast. */
     profiler_queue_t * profiler_listener::_construct_thequeue() {
-        profiler_queue_t * _thequeue = new profiler_queue_t();
+        /* the consumer updates this thread's partial profiles */
+        profiler_queue_t * _thequeue = new profiler_queue_t(partials());
         /* We are locking to make sure the vector is only updated by
          * one thread at a time. */
         std::unique_lock<std::mutex> queue_lock(queue_mtx);
@@ -143,6 +143,52 @@ std::unordered_set<profile*> free_profiles;
         return _thequeue;
     }
 
+    /* We do this in two stages, to make the common case fast. */
+    profile_partials * profiler_listener::_construct_partials() {
+        profile_partials * _partials = new profile_partials();
+        /* We are locking to make sure the vector is only updated by
+         * one thread at a time. */
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        all_partials.push_back(_partials);
+        return _partials;
+    }
+    /* this is a thread-local pointer to the partial profiles for each thread.
+     * They outlive the thread, so the values are not lost when it exits. */
+    profile_partials * profiler_listener::partials() {
+        static APEX_NATIVE_TLS profile_partials * _partials =
+            _construct_partials();
+        return _partials;
+    }
+
+    /* Fold every thread's partial profiles into the shared profiles. */
+    void profiler_listener::fold_partials(void) {
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        for (auto p : all_partials) {
+            p->fold();
+        }
+    }
+
+    void profiler_listener::fold_partials(const task_identifier &id) {
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        for (auto p : all_partials) {
+            p->fold(id);
+        }
+    }
+
+    void profiler_listener::discard_partials(void) {
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        for (auto p : all_partials) {
+            p->discard();
+        }
+    }
+
+    void profiler_listener::discard_partials(const task_identifier &id) {
+        std::unique_lock<std::mutex> queue_lock(queue_mtx);
+        for (auto p : all_partials) {
+            p->discard(id);
+        }
+    }
+
   /* Flag indicating whether a consumer task is currently running */
   std::atomic_flag consumer_task_running = ATOMIC_FLAG_INIT;
 #ifdef APEX_HAVE_HPX
@@ -151,18 +197,20 @@ std::unordered_set<profile*> free_profiles;
 
   double profiler_listener::get_non_idle_time() {
     double non_idle_time = 0.0;
+    if (_async_processing) {
+        drain_queues();
+    }
+    fold_partials();
     /* Iterate over all timers and accumulate the time spent in them */
-    unordered_map<task_identifier, profile*>::const_iterator it2;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-      profile * p = it2->second;
+    for(auto& it2 : task_map.snapshot()) {
+      profile * p = it2.second;
       if (apex_options::throttle_timers()) {
         if (!apex_options::use_tau()) {
-            task_identifier id = it2->first;
-            unordered_set<task_identifier>::const_iterator it4;
+            task_identifier& id = it2.first;
+            unordered_set<uint32_t>::const_iterator it4;
             {
                 read_lock_type l(throttled_event_set_mutex);
-                it4 = throttled_tasks.find(id);
+                it4 = throttled_tasks.find(id.id);
             }
             if (it4!= throttled_tasks.end()) {
                 continue;
@@ -217,15 +265,10 @@ std::unordered_set<profile*> free_profiles;
   /* Return the requested profile object to the user.
    * Return nullptr if doesn't exist. */
   profile * profiler_listener::get_profile(const task_identifier &id) {
-    /* Maybe we aren't processing profiler objects yet? Fire off a request. */
-#ifndef APEX_SYNCHRONOUS_PROCESSING
-#ifdef APEX_HAVE_HPX
-    // don't schedule an HPX action - just do it.
-    process_profiles_wrapper();
-#else
-    queue_signal.post();
-#endif
-#endif // APEX_SYNCHRONOUS_PROCESSING
+    /* Maybe there are records in the queues? Process them first. */
+    if (_async_processing) {
+        drain_queues();
+    }
     if (id.name == string(APEX_IDLE_RATE)) {
         return get_idle_rate();
     } else if (id.name == string(APEX_IDLE_TIME)) {
@@ -238,19 +281,16 @@ std::unordered_set<profile*> free_profiles;
         }
         return theprofile;
     }
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    unordered_map<task_identifier, profile*>::const_iterator it = task_map.find(id);
-    if (it != task_map.end()) {
-      return (*it).second;
-    }
-    return nullptr;
+    fold_partials(id);
+    return task_map.find(id);
   }
 
   void profiler_listener::reset_all(void) {
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(auto &it : task_map) {
-        it.second->reset();
-    }
+    discard_partials();
+    task_map.for_each([](const task_identifier& id, profile * p) {
+        APEX_UNUSED(id);
+        p->reset();
+    });
     if (apex_options::use_jupyter_support()) {
         // restart the main timer
         main_timer = std::make_shared<profiler>(task_wrapper::get_apex_main_wrapper());
@@ -272,133 +312,219 @@ std::unordered_set<profile*> free_profiles;
   unsigned int profiler_listener::process_profile(profiler& p, unsigned int tid)
   {
     APEX_UNUSED(tid);
+    stop_record r;
+    make_stop_record(p, r);
+    if (!r.is_counter && !p.metric_map.empty() && r.tree_node != nullptr &&
+        (apex_options::use_tasktree_output() ||
+         apex_options::use_hatchet_output())) {
+        r.tree_node->addMetrics(p.metric_map);
+    }
+    return process_profile(r, partials());
+  }
+
+  /* Copy what we need out of the profiler object.  This is done on the
+   * thread that stopped the timer, the record can be processed later. */
+  void profiler_listener::make_stop_record(profiler& p, stop_record& r) {
+    r.task_id = p.get_task_id();
+    r.start_ns = p.start_ns;
+    r.end_ns = p.end_ns;
+    r.thread_id = p.thread_id;
+    r.is_counter = p.is_counter;
+    r.is_resume = p.is_resume;
+    r.is_reset = p.is_reset;
+    r.elapsed = p.elapsed();
+    r.inclusive = (p.is_reset == reset_type::NONE) ? p.inclusive() : 0.0;
+    r.allocations = p.allocations;
+    r.frees = p.frees;
+    r.bytes_allocated = p.bytes_allocated;
+    r.bytes_freed = p.bytes_freed;
+    r.tree_node = (p.tt_ptr != nullptr) ? p.tt_ptr->tree_node : nullptr;
+    for (int i = 0 ; i < 8 ; i++) {
+        r.counters[i] = 0.0;
+    }
+#if APEX_HAVE_PAPI
+    for (int i = 0 ; i < num_papi_counters ; i++) {
+        if (p.papi_stop_values[i] > p.papi_start_values[i]) {
+            r.counters[i] = p.papi_stop_values[i] - p.papi_start_values[i];
+        }
+    }
+#endif
+  }
+
+  /* Update the profile for this stop record.  The partials are those of
+   * the thread that stopped the timer. */
+  unsigned int profiler_listener::process_profile(stop_record& r,
+    profile_partials * mine)
+  {
     profile * theprofile;
-    if(p.is_reset == reset_type::ALL) {
+    if(r.is_reset == reset_type::ALL) {
         reset_all();
         return 0;
     }
-    double values[8] = {0};
+    double * values = r.counters;
     double tmp_num_counters = 0;
 #if APEX_HAVE_PAPI
     tmp_num_counters = num_papi_counters;
-    for (int i = 0 ; i < num_papi_counters ; i++) {
-        if (p.papi_stop_values[i] > p.papi_start_values[i]) {
-            values[i] = p.papi_stop_values[i] - p.papi_start_values[i];
-        } else {
-            values[i] = 0.0;
+#endif
+    const bool track_memory = apex_options::track_cpu_memory() ||
+        apex_options::track_gpu_memory();
+    double calls = 0.0;
+    double accumulated = 0.0;
+    theprofile = nullptr;
+    if (r.is_reset == reset_type::NONE) {
+        /* The common case: this thread has already seen this task, so
+         * accumulate into its private partial profile.  No shared locks,
+         * no contention on the shared profile. */
+        std::unique_lock<std::mutex> partial_lock(mine->mtx);
+        auto pit = mine->map.find(r.task_id->id);
+        if (pit != mine->map.end() && pit->second.thread_id == r.thread_id) {
+            profile_partials::partial& partial = pit->second;
+            if (track_memory) {
+                partial.increment(r.elapsed, r.inclusive, tmp_num_counters,
+                    values, r.allocations, r.frees, r.bytes_allocated,
+                    r.bytes_freed, r.is_resume);
+            } else {
+                partial.increment(r.elapsed, r.inclusive, tmp_num_counters,
+                    values, 0, 0, 0, 0, r.is_resume);
+            }
+            theprofile = partial.shared;
+            // the totals so far, for the throttling decision below
+            calls = theprofile->get_calls() + partial.values.calls;
+            accumulated = theprofile->get_accumulated() +
+                partial.values.accumulated;
         }
     }
-#endif
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    unordered_map<task_identifier, profile*>::const_iterator it =
-        task_map.find(*(p.get_task_id()));
-    if (it != task_map.end()) {
+    if (theprofile == nullptr) {
+      bool created = false;
+      theprofile = task_map.find_or_create(*(r.task_id), [&]() {
+        // Create a new profile for this name.
+        if (track_memory && !r.is_counter) {
+            return new profile(r.is_reset ==
+                reset_type::CURRENT ? 0.0 : r.elapsed, r.inclusive,
+                tmp_num_counters, values, r.is_resume,
+                r.allocations, r.frees, r.bytes_allocated,
+                r.bytes_freed);
+        }
+        return new profile(r.is_reset ==
+            reset_type::CURRENT ? 0.0 : r.elapsed, r.inclusive,
+            tmp_num_counters, values, r.is_resume,
+            r.is_counter ? APEX_COUNTER : APEX_TIMER);
+      }, created);
+      if (!created) {
           // A profile for this ID already exists.
-        theprofile = (*it).second;
-        task_map_lock.unlock();
-        if(p.is_reset == reset_type::CURRENT) {
+        if(r.is_reset == reset_type::CURRENT) {
+            discard_partials(*(r.task_id));
             theprofile->reset();
         } else {
-            if (apex_options::track_cpu_memory() || apex_options::track_gpu_memory()) {
-                theprofile->increment(p.elapsed(), p.inclusive(), tmp_num_counters,
-                    values, p.allocations, p.frees, p.bytes_allocated,
-                    p.bytes_freed, p.is_resume, p.thread_id);
+            if (track_memory) {
+                theprofile->increment(r.elapsed, r.inclusive, tmp_num_counters,
+                    values, r.allocations, r.frees, r.bytes_allocated,
+                    r.bytes_freed, r.is_resume, r.thread_id);
             } else {
-                theprofile->increment(p.elapsed(), p.inclusive(), tmp_num_counters,
-                    values, p.is_resume, p.thread_id);
-            }
-        }
-        if (apex_options::throttle_timers()) {
-            if (!apex_options::use_tau()) {
-            // Is this a lightweight task? If so, we shouldn't measure it any more,
-            // in order to reduce overhead.
-            if (theprofile->get_calls() > apex_options::throttle_timers_calls() &&
-                theprofile->get_mean_useconds() < apex_options::throttle_timers_percall()) {
-                // set the profile to throttled for output reasons
-                theprofile->set_throttled();
-                // add the task_identifier to the list of throttled events
-                unordered_set<task_identifier>::const_iterator it2;
-                {
-                    read_lock_type l(throttled_event_set_mutex);
-                    it2 = throttled_tasks.find(*(p.get_task_id()));
-                }
-                if (it2 == throttled_tasks.end()) {
-                    // lock the set for insert
-                    {
-                        write_lock_type l(throttled_event_set_mutex);
-                        // was it inserted when we were waiting?
-                        it2 = throttled_tasks.find(*(p.get_task_id()));
-                        // no? OK - insert it.
-                        if (it2 == throttled_tasks.end()) {
-                            throttled_tasks.insert(*(p.get_task_id()));
-                        }
-                    }
-                    if (apex_options::use_verbose()) {
-                        cout << "APEX: disabling lightweight timer "
-                            << p.get_task_id()->get_name()
-                                << endl;
-                        fflush(stdout);
-                    }
-                }
-            }
+                theprofile->increment(r.elapsed, r.inclusive, tmp_num_counters,
+                    values, r.is_resume, r.thread_id);
             }
         }
       } else {
-        // Create a new profile for this name.
-        if ((apex_options::track_cpu_memory() ||
-             apex_options::track_gpu_memory()) && !p.is_counter) {
-            theprofile = new profile(p.is_reset ==
-                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
-                tmp_num_counters, values, p.is_resume,
-                p.allocations, p.frees, p.bytes_allocated,
-                p.bytes_freed);
-            task_map[*(p.get_task_id())] = theprofile;
-        } else {
-            theprofile = new profile(p.is_reset ==
-                reset_type::CURRENT ? 0.0 : p.elapsed(), p.inclusive(),
-                tmp_num_counters, values, p.is_resume,
-                p.is_counter ? APEX_COUNTER : APEX_TIMER);
-            task_map[*(p.get_task_id())] = theprofile;
-        }
-        task_map_lock.unlock();
 #ifdef APEX_HAVE_HPX
 #ifdef APEX_REGISTER_HPX3_COUNTERS
-        if(!_done) {
-            if(get_hpx_runtime_ptr() != nullptr &&
-                p.get_task_id()->has_name()) {
-                std::string timer_name(p.get_task_id()->get_name());
-                //Don't register timers containing "/"
-                if(timer_name.find("/") == std::string::npos) {
-                    hpx::performance_counters::install_counter_type(
-                    std::string("/apex/") + timer_name,
-                    [p](bool r)->std::int64_t{
-                        std::int64_t value(p.elapsed());
-                        return value;
-                    },
-                    std::string("APEX counter ") + timer_name,
-                    ""
-                    );
-                }
-            } else {
-                std::cerr << "HPX runtime not initialized yet." << std::endl;
-            }
-        }
+          if(!_done) {
+              if(get_hpx_runtime_ptr() != nullptr &&
+                  r.task_id->has_name()) {
+                  std::string timer_name(r.task_id->get_name());
+                  //Don't register timers containing "/"
+                  if(timer_name.find("/") == std::string::npos) {
+                      hpx::performance_counters::install_counter_type(
+                      std::string("/apex/") + timer_name,
+                      [r](bool reset)->std::int64_t{
+                          std::int64_t value(r.elapsed);
+                          return value;
+                      },
+                      std::string("APEX counter ") + timer_name,
+                      ""
+                      );
+                  }
+              } else {
+                  std::cerr << "HPX runtime not initialized yet." << std::endl;
+              }
+          }
 #endif
 #endif
       }
+      if (r.is_reset == reset_type::NONE) {
+        /* From now on, this thread will accumulate into its partial. */
+        std::unique_lock<std::mutex> partial_lock(mine->mtx);
+        mine->map.emplace(r.task_id->id,
+            profile_partials::partial(theprofile, r.thread_id));
+      }
+      calls = theprofile->get_calls();
+      accumulated = theprofile->get_accumulated();
+    }
+    if (r.is_reset == reset_type::NONE) {
+        check_throttle(r.task_id, theprofile, calls, accumulated);
+    }
+    process_record_samples(r);
+    return 1;
+  }
+
+  /* Throttle the task, if it is too lightweight to measure.
+   * The calls and accumulated values are the totals so far. */
+  void profiler_listener::check_throttle(task_identifier * id,
+    profile * theprofile, double calls, double accumulated) {
+    if (apex_options::throttle_timers()) {
+        if (!apex_options::use_tau()) {
+        // Is this a lightweight task? If so, we shouldn't measure it any more,
+        // in order to reduce overhead.
+        if (calls > apex_options::throttle_timers_calls() &&
+            (accumulated * 1.0e-3 / calls) <
+                apex_options::throttle_timers_percall()) {
+            // set the profile to throttled for output reasons
+            theprofile->set_throttled();
+            // add the task_identifier to the list of throttled events
+            unordered_set<uint32_t>::const_iterator it2;
+            {
+                read_lock_type l(throttled_event_set_mutex);
+                it2 = throttled_tasks.find(id->id);
+            }
+            if (it2 == throttled_tasks.end()) {
+                // lock the set for insert
+                {
+                    write_lock_type l(throttled_event_set_mutex);
+                    // was it inserted when we were waiting?
+                    it2 = throttled_tasks.find(id->id);
+                    // no? OK - insert it.
+                    if (it2 == throttled_tasks.end()) {
+                        throttled_tasks.insert(id->id);
+                    }
+                }
+                if (apex_options::use_verbose()) {
+                    cout << "APEX: disabling lightweight timer "
+                        << id->get_name()
+                            << endl;
+                    fflush(stdout);
+                }
+            }
+        }
+        }
+    }
+  }
+
+  /* Write the scatterplot samples and update the task tree, for one
+   * record.  These can't be aggregated. */
+  void profiler_listener::process_record_samples(stop_record& r) {
       /* write the sample to the file */
       if (apex_options::task_scatterplot()) {
-        if (!p.is_counter) {
+        if (!r.is_counter) {
             static int thresh = std::round((double)(RAND_MAX) * apex_options::scatterplot_fraction());
             if (std::rand() < thresh) {
-                /* before calling p.get_task_id()->get_name(), make sure we create
+                /* before calling r.task_id->get_name(), make sure we create
                  * a thread_instance object that is NOT a worker. */
                 thread_instance::instance(false);
                 std::unique_lock<std::mutex> task_map_lock(_mtx);
                 task_scatterplot_samples << std::fixed
-                    << std::setprecision(0) << p.normalized_timestamp()
-                    << " " << p.elapsed() << " "
-                    << "'" << p.get_task_id()->get_name() << "'" << endl;
+                    << std::setprecision(0) << r.normalized_timestamp()
+                    << " " << r.elapsed << " "
+                    << "'" << r.task_id->get_name() << "'" << endl;
                 int loc0 = task_scatterplot_samples.tellp();
                 if (loc0 > 32768) {
                     task_scatterplot_sample_file() << task_scatterplot_samples.rdbuf();
@@ -414,9 +540,9 @@ std::unordered_set<profile*> free_profiles;
 #ifdef APEX_HAVE_PROC
                     << proc_data_reader::getPeriod() << " "
 #endif
-                    << p.normalized_timestamp()
-                    << " " << std::setprecision(6) << p.elapsed() << " "
-                    << "'" << p.get_task_id()->get_name() << "'" << endl;
+                    << r.normalized_timestamp()
+                    << " " << std::setprecision(6) << r.elapsed << " "
+                    << "'" << r.task_id->get_name() << "'" << endl;
                 int loc0 = task_scatterplot_samples.tellp();
                 if (loc0 > 32768) {
                     counter_scatterplot_sample_file() << counter_scatterplot_samples.rdbuf();
@@ -427,11 +553,9 @@ std::unordered_set<profile*> free_profiles;
                 }
 	}
       }
-    if ((apex_options::use_tasktree_output() || apex_options::use_hatchet_output()) && !p.is_counter && p.tt_ptr != nullptr) {
-        p.tt_ptr->tree_node->addAccumulated(p.elapsed_seconds(), p.inclusive_seconds(), p.is_resume, p.thread_id, values, num_papi_counters);
-        p.tt_ptr->tree_node->addMetrics(p.metric_map);
+    if ((apex_options::use_tasktree_output() || apex_options::use_hatchet_output()) && !r.is_counter && r.tree_node != nullptr) {
+        r.tree_node->addAccumulated(r.elapsed * 1.0e-9, r.inclusive * 1.0e-9, r.is_resume, r.thread_id, r.counters, num_papi_counters);
     }
-    return 1;
   }
 
   inline unsigned int profiler_listener::process_dependency(task_dependency* td)
@@ -466,13 +590,7 @@ std::unordered_set<profile*> free_profiles;
   /* Cleaning up memory. Not really necessary, because it only gets
    * called at shutdown. But a good idea to do regardless. */
   void profiler_listener::delete_profiles(void) {
-    // iterate over the map and free the objects in the map
-    unordered_map<task_identifier, profile*>::const_iterator it;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it = task_map.begin(); it != task_map.end(); it++) {
-      delete it->second;
-    }
-    // clear the map.
+    // free the objects in the map, and clear the map.
     task_map.clear();
 
   }
@@ -699,21 +817,8 @@ std::unordered_set<profile*> free_profiles;
     // our TOTAL available time is the elapsed * the number of threads, or cores
     int num_worker_threads = thread_instance::get_num_workers();
     auto main_id = task_identifier::get_main_task_id();
+    // (get_profile() processes any queued records first)
     profile * total_time = get_profile(*main_id);
-#ifndef APEX_SYNCHRONOUS_PROCESSING
-    /* The profiles haven't been processed yet. */
-    while (total_time == nullptr) {
-#ifdef APEX_HAVE_HPX
-        // schedule an HPX action
-        apex_schedule_process_profiles();
-#else
-        queue_signal.post();
-#endif
-        // wait for profiles to update
-        std::this_thread::sleep_for(std::chrono::microseconds(100));
-        total_time = get_profile(main_id);
-    }
-#endif  // APEX_SYNCHRONOUS_PROCESSING
     double wall_clock_main = (total_time != nullptr) ? total_time->get_accumulated_seconds() : 0.0;
 #ifdef APEX_HAVE_HPX
     num_worker_threads = num_worker_threads - num_non_worker_threads_registered;
@@ -745,14 +850,11 @@ std::unordered_set<profile*> free_profiles;
     double total_accumulated = 0.0;
     std::vector<std::string> id_vector;
     // iterate over the counters, and sort their names
-    {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-        for(auto it2 : all_profiles) {
-            std::string name = it2.first;
-            apex_profile * p = it2.second;
-            if (p->type != APEX_TIMER) {
-                id_vector.push_back(name);
-            }
+    for(auto it2 : all_profiles) {
+        std::string name = it2.first;
+        apex_profile * p = it2.second;
+        if (p->type != APEX_TIMER) {
+            id_vector.push_back(name);
         }
     }
     if (id_vector.size() > 0) {
@@ -1030,9 +1132,8 @@ std::unordered_set<profile*> free_profiles;
     task_dependencies.clear();
 
     // output nodes with  "main" [shape=box; style=filled; fillcolor="#ff0000" ];
-    unordered_map<task_identifier, profile*>::const_iterator it;
-    std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-    for(it = task_map.begin(); it != task_map.end(); it++) {
+    auto all_profiles = task_map.snapshot();
+    for(auto it = all_profiles.begin(); it != all_profiles.end(); it++) {
       profile * p = it->second;
       // shouldn't happen, but?
       if (p == nullptr) continue;
@@ -1203,6 +1304,8 @@ std::unordered_set<profile*> free_profiles;
                 header_stream << ",\"stddev " << x << "\"";
                 header_stream << ",\"median " << x << "\"";
                 header_stream << ",\"mode " << x << "\"";
+                header_stream << ",\"p90 " << x << "\"";
+                header_stream << ",\"p99 " << x << "\"";
             }
             /* First, we need to tokenize the list of metrics */
             std::stringstream tmpstr(apex_options::papi_metrics());
@@ -1238,17 +1341,15 @@ std::unordered_set<profile*> free_profiles;
 
     // Determine number of counter events, as these need to be
     // excluded from the number of normal timers
-    unordered_map<task_identifier, profile*>::const_iterator it2;
-    {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-        for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
-            profile * p = it2->second;
-            if(p->get_type() == APEX_COUNTER) {
-                counter_events++;
-            }
+    auto all_profiles = task_map.snapshot();
+    profile_table::snapshot_type::iterator it2;
+    for(it2 = all_profiles.begin(); it2 != all_profiles.end(); it2++) {
+        profile * p = it2->second;
+        if(p->get_type() == APEX_COUNTER) {
+            counter_events++;
         }
     }
-    size_t function_count = task_map.size() - counter_events;
+    size_t function_count = all_profiles.size() - counter_events;
     if (apex_options::use_tasktree_output() || apex_options::use_hatchet_output()) {
         auto root = task_wrapper::get_apex_main_wrapper();
         function_count += (root->tree_node->getNodeCount() - 1);
@@ -1266,8 +1367,7 @@ std::unordered_set<profile*> free_profiles;
     profile * mainp = nullptr;
     double not_main = 0.0;
     {
-        std::unique_lock<std::mutex> task_map_lock(_task_map_mutex);
-        for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
+        for(it2 = all_profiles.begin(); it2 != all_profiles.end(); it2++) {
             profile * p = it2->second;
             task_identifier task_id = it2->first;
             if(p->get_type() == APEX_TIMER) {
@@ -1301,7 +1401,7 @@ std::unordered_set<profile*> free_profiles;
     if(counter_events > 0) {
       myfile << counter_events << " userevents" << endl;
       myfile << "# eventname numevents max min mean sumsqr" << endl;
-      for(it2 = task_map.begin(); it2 != task_map.end(); it2++) {
+      for(it2 = all_profiles.begin(); it2 != all_profiles.end(); it2++) {
         profile * p = it2->second;
         if(p->get_type() == APEX_COUNTER) {
           task_identifier task_id = it2->first;
@@ -1352,13 +1452,143 @@ std::unordered_set<profile*> free_profiles;
 
   bool profiler_listener::concurrent_cleanup(int i){
       //set_thread_affinity(i);
-      std::shared_ptr<profiler> p;
-      while(allqueues[i]->try_dequeue(p)) {
-             process_profile(p,0);
+      profiler_queue_t * queue;
+      {
+          std::unique_lock<std::mutex> queue_lock(queue_mtx);
+          queue = allqueues[i];
       }
+      std::unique_lock<std::mutex> drain_lock(drain_mtx);
+      drain_queue(queue);
       return true;
   }
 
+  /* Process the records in one thread's queue.  Hold the drain_mtx!
+   * Small batches are processed one record at a time.  Larger batches
+   * are sorted by task, so each task gets one update per batch. */
+  void profiler_listener::drain_queue(profiler_queue_t * queue) {
+      const size_t min_batch_size = 16;
+      profile_partials * mine = queue->partials;
+      queue->consume_bulk([this, mine, min_batch_size](stop_record * first,
+          size_t n1, stop_record * second, size_t n2) {
+          if (n1 + n2 < min_batch_size) {
+              for (size_t i = 0 ; i < n1 ; i++) {
+                  process_profile(first[i], mine);
+              }
+              for (size_t i = 0 ; i < n2 ; i++) {
+                  process_profile(second[i], mine);
+              }
+              return;
+          }
+          _batch_order.clear();
+          auto add = [this](stop_record& r) {
+              uint64_t key = ((uint64_t)(r.task_id->id) << 32) |
+                  (r.thread_id & 0xFFFFFFFF);
+              _batch_order.push_back(batch_entry(key, &r));
+          };
+          for (size_t i = 0 ; i < n1 ; i++) { add(first[i]); }
+          for (size_t i = 0 ; i < n2 ; i++) { add(second[i]); }
+          std::sort(_batch_order.begin(), _batch_order.end());
+          size_t begin = 0;
+          for (size_t i = 1 ; i <= _batch_order.size() ; i++) {
+              if (i == _batch_order.size() ||
+                  _batch_order[i].first != _batch_order[begin].first) {
+                  process_batch(&(_batch_order[begin]), i - begin, mine);
+                  begin = i;
+              }
+          }
+      });
+  }
+
+  /* Apply a batch of records for the same task (and thread) to the
+   * partial profile with one update. */
+  void profiler_listener::process_batch(batch_entry * batch, size_t n,
+    profile_partials * mine) {
+      stop_record& head = *(batch[0].second);
+      size_t start = 0;
+      profile_partials::partial * partial = nullptr;
+      auto find_partial = [&]() {
+          std::unique_lock<std::mutex> partial_lock(mine->mtx);
+          auto pit = mine->map.find(head.task_id->id);
+          if (pit != mine->map.end() &&
+              pit->second.thread_id == head.thread_id) {
+              partial = &(pit->second);
+          }
+      };
+      find_partial();
+      if (partial == nullptr) {
+          // the first time for this task, create the profile (and partial)
+          process_profile(head, mine);
+          start = 1;
+          find_partial();
+          if (partial == nullptr) {
+              for (size_t i = start ; i < n ; i++) {
+                  process_profile(*(batch[i].second), mine);
+              }
+              return;
+          }
+      }
+      if (start == n) { return; }
+      const bool track_memory = apex_options::track_cpu_memory() ||
+          apex_options::track_gpu_memory();
+      apex_profile values;
+      memset(&values, 0, sizeof(apex_profile));
+      _batch_values.clear();
+      for (size_t i = start ; i < n ; i++) {
+          stop_record& r = *(batch[i].second);
+          _batch_values.push_back(r.elapsed);
+          values.inclusive_accumulated += r.inclusive;
+          if (!r.is_resume) {
+              values.calls = values.calls + 1.0;
+          }
+#if APEX_HAVE_PAPI
+          for (int j = 0 ; j < num_papi_counters ; j++) {
+              values.papi_metrics[j] += r.counters[j];
+          }
+#endif
+          if (track_memory) {
+              values.allocations += r.allocations;
+              values.frees += r.frees;
+              values.bytes_allocated += r.bytes_allocated;
+              values.bytes_freed += r.bytes_freed;
+          }
+      }
+      batch_stats stats;
+      compute_batch_stats(_batch_values.data(), _batch_values.size(), stats);
+      values.stops = (double)(_batch_values.size());
+      values.accumulated = stats.sum;
+      values.sum_squares = stats.sum_squares;
+      values.minimum = stats.minimum;
+      values.maximum = stats.maximum;
+      double calls = 0.0;
+      double accumulated = 0.0;
+      {
+          std::unique_lock<std::mutex> partial_lock(mine->mtx);
+          partial->add(values);
+          calls = partial->shared->get_calls() + partial->values.calls;
+          accumulated = partial->shared->get_accumulated() +
+              partial->values.accumulated;
+      }
+      check_throttle(head.task_id, partial->shared, calls, accumulated);
+      for (size_t i = start ; i < n ; i++) {
+          process_record_samples(*(batch[i].second));
+      }
+  }
+
+  /* Process the records in every thread's queue.  Called by the consumer,
+   * and by any thread that needs the profiles to be up to date. */
+  void profiler_listener::drain_queues(void) {
+      std::vector<profiler_queue_t*> queues;
+      {
+          /* Copy the list, so threads can register while we work. */
+          std::unique_lock<std::mutex> queue_lock(queue_mtx);
+          queues = allqueues;
+      }
+      std::unique_lock<std::mutex> drain_lock(drain_mtx);
+      for (auto queue : queues) {
+          drain_queue(queue);
+      }
+  }
+
   /* This is the main function for the consumer thread.
    * Operation outside of HPX:
    * It will wait at a semaphore for pending work. When there is
@@ -1388,28 +1618,11 @@ std::unordered_set<profile*> free_profiles;
     start(prof);
     */
 
-    std::shared_ptr<profiler> p;
     task_dependency* td;
 #ifdef APEX_HAVE_HPX
     //bool schedule_another_task = false;
-    {
-        size_t num_queues = 0;
-        {
-            std::unique_lock<std::mutex> queue_lock(queue_mtx);
-            num_queues = allqueues.size();
-        }
-        for (size_t q = 0 ; q < num_queues ; q++) {
-            int i = 0;
-            while(!_done && allqueues[q]->try_dequeue(p)) {
-                process_profile(p, 0);
-                /*
-                if (++i > 1000 && !synchronous_flush) {
-                    schedule_another_task = true;
-                    break;
-                }
-                */
-            }
-        }
+    if (!_done) {
+        drain_queues();
     }
     if (apex_options::use_taskgraph_output()) {
         size_t num_queues = 0;
@@ -1438,18 +1651,7 @@ std::unordered_set<profile*> free_profiles;
             tau_listener::Tau_start_wrapper(
                 "profiler_listener::process_profiles: main loop");
         }
-        {
-            size_t num_queues = 0;
-                std::unique_lock<std::mutex> queue_lock(queue_mtx);
-            {
-                num_queues = allqueues.size();
-            }
-            for (size_t q = 0 ; q < num_queues ; q++) {
-                while(!_done && allqueues[q]->try_dequeue(p)) {
-                    process_profile(p, 0);
-                }
-            }
-        }
+        drain_queues();
         if (apex_options::use_taskgraph_output()) {
             size_t num_queues = 0;
                 std::unique_lock<std::mutex> queue_lock(queue_mtx);
@@ -1637,13 +1839,14 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   void profiler_listener::on_startup(startup_event_data &data) {
     if (!_done) {
       _pls.my_tid = (unsigned int)thread_instance::get_id();
+      _async_processing = apex_options::async_processing();
       async_thread_setup();
-#ifndef APEX_SYNCHRONOUS_PROCESSING
 #ifndef APEX_HAVE_HPX
-      // Start the consumer thread, to process profiler objects.
-      consumer_thread = new std::thread(consumer_process_profiles_wrapper);
+      if (_async_processing) {
+          // Start the consumer thread, to process the stop records.
+          consumer_thread = new std::thread(consumer_process_profiles_wrapper);
+      }
 #endif
-#endif // APEX_SYNCHRONOUS_PROCESSING
 
 #if APEX_HAVE_PAPI
       initialize_PAPI(true);
@@ -1713,21 +1916,15 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
         resume_main_timer();
     }
 
-    // trigger statistics updating
-#ifndef APEX_SYNCHRONOUS_PROCESSING
-#ifdef APEX_HAVE_HPX
-    // We can't schedule an action, because the runtime might be gone
-    // if we are in the dump() during finalize.  So synchronously
-    // process the queue.
-    // synchronous_flush = true;
-    process_profiles_wrapper();
-    // synchronous_flush = false;
-#else
-    queue_signal.post();
-    // wait until any other threads are done processing dependencies
-    while(consumer_task_running.test_and_set(memory_order_acq_rel)) { }
-#endif
-#endif // APEX_SYNCHRONOUS_PROCESSING
+    // trigger statistics updating.  We can't wait for the consumer
+    // (or schedule an HPX action, the runtime might be gone if we are
+    // in the dump() during finalize), so process the queues here.
+    if (_async_processing) {
+        drain_queues();
+    }
+
+      // fold the per-thread partial profiles into the shared profiles
+      fold_partials();
 
       // output to screen?
       if (apex_options::use_screen_output() ||
@@ -1807,13 +2004,13 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       if (data.reset) {
           reset_all();
       }
-#ifndef APEX_SYNCHRONOUS_PROCESSING
-      // on_dump() releasing the "task_running" flag
-      consumer_task_running.clear(memory_order_release);
-#endif
   }
 
   void profiler_listener::on_reset(task_identifier * id) {
+    // apply the queued measurements before the reset
+    if (_async_processing) {
+        drain_queues();
+    }
     if (id == nullptr) {
         reset_all();
     } else {
@@ -1830,16 +2027,14 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       _done = true;
       //node_id = data.node_id;
       //sleep(1);
-#ifndef APEX_SYNCHRONOUS_PROCESSING
 #ifndef APEX_HAVE_HPX
-      queue_signal.post();
-      queue_signal.dump_stats();
       if (consumer_thread != nullptr) {
+          queue_signal.post();
+          queue_signal.dump_stats();
           queue_signal.post(); // one more time, just to be sure
           consumer_thread->join();
       }
 #endif
-#endif // APEX_SYNCHRONOUS_PROCESSING
 
     }
   }
@@ -1875,10 +2070,10 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       if (apex_options::throttle_timers()) {
         if (!apex_options::use_tau()) {
             // if this timer is throttled, return without doing anything
-            unordered_set<task_identifier>::const_iterator it;
+            unordered_set<uint32_t>::const_iterator it;
             {
                 read_lock_type l(throttled_event_set_mutex);
-                it = throttled_tasks.find(*tt_ptr->get_task_id());
+                it = throttled_tasks.find(tt_ptr->get_task_id()->id);
             }
             if (it != throttled_tasks.end()) {
                 /*
@@ -1937,32 +2132,38 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
 #ifdef APEX_TRACE_APEX
       if (p.get_task_id()->name == "apex::process_profiles_sync") { return; }
 #endif
-      process_profile(p,0);
-      return;
+      // resets have to be applied in order, so do them right now.
+      if (!_async_processing || p.is_reset != reset_type::NONE) {
+          process_profile(p,0);
+          return;
+      }
+      stop_record r;
+      make_stop_record(p, r);
+      // the extra metrics don't fit in a record, add them now.
+      if (!p.metric_map.empty() && r.tree_node != nullptr &&
+          (apex_options::use_tasktree_output() ||
+           apex_options::use_hatchet_output())) {
+          r.tree_node->addMetrics(p.metric_map);
+      }
+      profiler_queue_t * queue = thequeue();
+      while (!queue->try_push(r)) {
+          // The queue is full, the consumer isn't keeping up. Help it.
+          drain_queues();
+      }
+      /* Only wake the consumer when the queue starts to fill up - the
+       * rest of the time, all we paid for is a copy into our queue. */
+      if (queue->size_approx() == profiler_queue_t::capacity / 4) {
+#ifndef APEX_HAVE_HPX
+          queue_signal.post();
+#else
+          apex_schedule_process_profiles();
+#endif
+      }
   }
 
   inline void profiler_listener::push_profiler(int my_tid,
     std::shared_ptr<profiler> &p) {
-      APEX_UNUSED(my_tid);
-      // if we aren't processing profiler objects, just return.
-      if (!apex_options::process_async_state()) { return; }
-#ifdef APEX_TRACE_APEX
-      if (p->get_task_id()->name == "apex::process_profiles_async") { return; }
-#endif
-      thequeue()->enqueue(p);
-#ifndef APEX_HAVE_HPX
-      // Check to see if the consumer is already running, to avoid calling
-      // "post" too frequently - it is rather costly.
-      if(!consumer_task_running.test_and_set(memory_order_acq_rel)) {
-        queue_signal.post();
-      }
-#else
-      // only fire off an action 0.1% of the time.
-      static int thresh = RAND_MAX/1000;
-      if (std::rand() < thresh) {
-        apex_schedule_process_profiles();
-      }
-#endif
+      push_profiler(my_tid, *p);
   }
 
   /* Stop the timer, if applicable, and queue the profiler object */
@@ -1983,11 +2184,7 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
 #endif
         // moved this to _common_start
         //p->thread_id = _pls.my_tid;
-#ifdef APEX_SYNCHRONOUS_PROCESSING
         push_profiler(_pls.my_tid, *p);
-#else // APEX_SYNCHRONOUS_PROCESSING
-        push_profiler(_pls.my_tid, p);
-#endif // APEX_SYNCHRONOUS_PROCESSING
       }
     }
   }
@@ -2022,7 +2219,9 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
    * call apex::async_thread_setup() which will end up here.*/
   void profiler_listener::async_thread_setup(void) {
       // for asynchronous threads, check to make sure there is a queue!
-      thequeue();
+      if (_async_processing) {
+          thequeue();
+      }
       if (apex_options::use_taskgraph_output()) {
         dependency_queue();
       }
@@ -2031,17 +2230,13 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   /* When a sample value is processed, save it as a profiler object, and queue it. */
   void profiler_listener::on_sample_value(sample_value_event_data &data) {
     if (!_done) {
-      // don't make a shared pointer if not necessary!
-#ifdef APEX_SYNCHRONOUS_PROCESSING
-      profiler p(task_identifier::get_task_id(
-        *data.counter_name), data.counter_value);
+      task_identifier * id = data.counter_id;
+      if (id == nullptr) {
+        id = task_identifier::get_task_id(*data.counter_name);
+      }
+      profiler p(id, data.counter_value);
       p.is_counter = data.is_counter;
-#else // APEX_SYNCHRONOUS_PROCESSING
-      std::shared_ptr<profiler> p =
-        std::make_shared<profiler>(task_identifier::get_task_id(
-        *data.counter_name), data.counter_value);
-      p->is_counter = data.is_counter;
-#endif // APEX_SYNCHRONOUS_PROCESSING
+      p.thread_id = _pls.my_tid;
       push_profiler(_pls.my_tid, p);
     }
   }
@@ -2063,13 +2258,8 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   /* Communication send event. Save the number of bytes. */
   void profiler_listener::on_send(message_event_data &data) {
     if (!_done) {
-      // don't make a shared pointer if not necessary!
-#ifdef APEX_SYNCHRONOUS_PROCESSING
       profiler p(task_identifier::get_task_id("Bytes Sent"), (double)data.size);
-#else // APEX_SYNCHRONOUS_PROCESSING
-      std::shared_ptr<profiler> p = std::make_shared<profiler>(
-        task_identifier::get_task_id("Bytes Sent"), (double)data.size);
-#endif // APEX_SYNCHRONOUS_PROCESSING
+      p.thread_id = _pls.my_tid;
       push_profiler(0, p);
     }
   }
@@ -2077,13 +2267,8 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   /* Communication recv event. Save the number of bytes. */
   void profiler_listener::on_recv(message_event_data &data) {
     if (!_done) {
-      // don't make a shared pointer if not necessary!
-#ifdef APEX_SYNCHRONOUS_PROCESSING
       profiler p(task_identifier::get_task_id("Bytes Received"), (double)data.size);
-#else // APEX_SYNCHRONOUS_PROCESSING
-      std::shared_ptr<profiler> p = std::make_shared<profiler>(
-        task_identifier::get_task_id("Bytes Received"), (double)data.size);
-#endif // APEX_SYNCHRONOUS_PROCESSING
+      p.thread_id = _pls.my_tid;
       push_profiler(0, p);
     }
   }
@@ -2103,13 +2288,7 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
   }
 
   void profiler_listener::reset(task_identifier * id) {
-    // don't make a shared pointer if not necessary!
-#ifdef APEX_SYNCHRONOUS_PROCESSING
     profiler p(id, false, reset_type::CURRENT);
-#else // APEX_SYNCHRONOUS_PROCESSING
-    std::shared_ptr<profiler> p =
-        std::make_shared<profiler>(id, false, reset_type::CURRENT);
-#endif // APEX_SYNCHRONOUS_PROCESSING
     push_profiler(_pls.my_tid, p);
   }
 
@@ -2117,13 +2296,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
       _done = true; // yikes!
       finalize();
       delete_profiles();
-#ifndef APEX_SYNCHRONOUS_PROCESSING
 #ifndef APEX_HAVE_HPX
 #ifndef APEX_STATIC // unbelievable.  Deleting this object can crash in a static link.
       delete consumer_thread;
 #endif
 #endif
-#endif // APEX_SYNCHRONOUS_PROCESSING
     std::unique_lock<std::mutex> queue_lock(queue_mtx);
     while (allqueues.size() > 0) {
         auto tmp = allqueues.back();
@@ -2135,6 +2312,11 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
         dependency_queues.pop_back();
         delete(tmp);
     }
+    while (all_partials.size() > 0) {
+        auto tmp = all_partials.back();
+        all_partials.pop_back();
+        delete(tmp);
+    }
     for (auto tmp : free_profiles) {
         delete(tmp);
     }
@@ -2181,12 +2363,7 @@ if (rc != 0) cout << "PAPI error! " << name << ": " << PAPI_strerror(rc) << endl
 
   void profiler_listener::push_profiler_public(std::shared_ptr<profiler> &p) {
     in_apex prevent_deadlocks;
-#ifdef APEX_SYNCHRONOUS_PROCESSING
-    // make sure we call the synchronous version!
     push_profiler(0, *(p.get()));
-#else
-    push_profiler(0, p);
-#endif
   }
 
 }
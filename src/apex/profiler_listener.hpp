@@ -30,6 +30,9 @@
 #include <string>
 
 #include "profile.hpp"
+#include "profile_table.hpp"
+#include "spsc_ring.hpp"
+#include "stop_record.hpp"
 #include "thread_instance.hpp"
 #include <fstream>
 
@@ -71,12 +74,13 @@ using moodycamel::ConcurrentQueue;
 
 namespace apex {
 
-class profiler_queue_t : public ConcurrentQueue<std::shared_ptr<profiler> > {
+/* With asynchronous processing, each thread writes the records of its
+ * stopped timers to its own queue, and the consumer folds them into that
+ * thread's partial profiles. */
+class profiler_queue_t : public spsc_ring<stop_record, 2048> {
 public:
-  profiler_queue_t() {}
-  virtual ~profiler_queue_t() {
-      //finalize();
-  }
+  profile_partials * partials;
+  profiler_queue_t(profile_partials * p) : partials(p) {}
 };
 
 class dependency_queue_t : public ConcurrentQueue<task_dependency*> {
@@ -113,6 +117,13 @@ private:
 #endif
   unsigned int process_profile(std::shared_ptr<profiler> &p, unsigned int tid);
   unsigned int process_profile(profiler& p, unsigned int tid);
+  unsigned int process_profile(stop_record& r, profile_partials * mine);
+  void make_stop_record(profiler& p, stop_record& r);
+  void check_throttle(task_identifier * id, profile * theprofile,
+    double calls, double accumulated);
+  void process_record_samples(stop_record& r);
+  typedef std::pair<uint64_t, stop_record*> batch_entry;
+  void process_batch(batch_entry * batch, size_t n, profile_partials * mine);
   unsigned int process_dependency(task_dependency* td);
   int node_id;
   std::mutex _mtx;
@@ -122,8 +133,15 @@ private:
     bool is_yield); // internal, inline function
   void push_profiler(int my_tid, std::shared_ptr<profiler> &p);
   void push_profiler(int my_tid, profiler &p);
-  std::unordered_map<task_identifier, profile*> task_map;
-  std::mutex _task_map_mutex;
+  profile_table task_map;
+  /* an vector of per-thread partial profiles - so they can be folded */
+  std::vector<profile_partials*> all_partials;
+  profile_partials * _construct_partials(void);
+  profile_partials * partials(void);
+  void fold_partials(void);
+  void fold_partials(const task_identifier &id);
+  void discard_partials(void);
+  void discard_partials(const task_identifier &id);
   std::unordered_map<task_identifier, std::unordered_map<task_identifier,
     int>* > task_dependencies;
   /* an vector of profiler queues - so the consumer thread can access them */
@@ -131,12 +149,22 @@ private:
   std::vector<profiler_queue_t*> allqueues;
   profiler_queue_t * _construct_thequeue(void);
   profiler_queue_t * thequeue(void);
+  /* set from APEX_ASYNC_PROCESSING at startup */
+  bool _async_processing;
+  /* only one thread at a time can consume from the queues */
+  std::mutex drain_mtx;
+  /* scratch space for processing batches, protected by the drain_mtx */
+  std::vector<batch_entry> _batch_order;
+  std::vector<double> _batch_values;
+  void drain_queue(profiler_queue_t * queue);
+  void drain_queues(void);
   /* The task dependency queues */
   std::vector<dependency_queue_t*> dependency_queues;
   dependency_queue_t * _construct_dependency_queue(void);
   dependency_queue_t * dependency_queue(void);
   //ConcurrentQueue<task_dependency*> dependency_queue;
-  std::unordered_set<task_identifier> throttled_tasks;
+  // interned ids of the throttled tasks
+  std::unordered_set<uint32_t> throttled_tasks;
   int num_papi_counters;
   std::vector<std::string> metric_names;
 #if APEX_HAVE_PAPI
@@ -157,9 +185,12 @@ public:
     this->node_id = node_id;
   }
   profiler_listener (void) : _initialized(false), _main_timer_stopped(false), _done(false),
-                             node_id(0), task_map() , num_papi_counters(0),
-                             metric_names(0)
+                             node_id(0), _async_processing(false),
+                             num_papi_counters(0), metric_names(0)
   {
+#ifndef APEX_HAVE_HPX
+      consumer_thread = nullptr;
+#endif
       if (apex_options::task_scatterplot()) {
         profiler::get_global_start();
       }
@@ -172,6 +203,16 @@ public:
   };
   ~profiler_listener (void);
   void async_thread_setup(void);
+  listener_mask subscriptions(void) const {
+    listener_mask mask = all_listener_events &
+      ~(APEX_LISTEN(LISTEN_NEW_NODE) | APEX_LISTEN(LISTEN_EXIT_THREAD) |
+        APEX_LISTEN(LISTEN_PERIODIC) | APEX_LISTEN(LISTEN_CUSTOM_EVENT) |
+        APEX_LISTEN(LISTEN_TASK_COMPLETE));
+    if (apex_options::use_taskgraph_output()) {
+      mask |= APEX_LISTEN(LISTEN_TASK_COMPLETE);
+    }
+    return mask;
+  }
   // events
   void on_startup(startup_event_data &data);
   void on_dump(dump_event_data &data);
@@ -230,14 +271,13 @@ public:
   profile * get_idle_rate(void);
   std::vector<task_identifier>& get_available_profiles() {
     static std::vector<task_identifier> ids;
-    _task_map_mutex.lock();
     if (task_map.size() > ids.size()) {
         ids.clear();
-        for (auto kv : task_map) {
-           ids.push_back(kv.first);
-        }
+        task_map.for_each([](const task_identifier& id, profile * p) {
+           APEX_UNUSED(p);
+           ids.push_back(id);
+        });
     }
-    _task_map_mutex.unlock();
     return ids;
   }
   void process_profiles(void);
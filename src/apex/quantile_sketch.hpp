@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace apex {
+
+/* A quantile sketch, after DDSketch (Masson et al., VLDB 2019).  Values
+ * are counted in logarithmically sized buckets, so every quantile is
+ * within relative_accuracy of the true value, and the memory is bounded
+ * by max_buckets per sign.  When a sketch needs more buckets than that,
+ * the lowest buckets are collapsed into one, which only loses accuracy
+ * for the smallest values.  Two sketches are merged by adding their
+ * bucket counts, so the result doesn't depend on how the values were
+ * divided between threads or processes.  Not thread safe. */
+class quantile_sketch {
+private:
+    static constexpr double relative_accuracy = 0.01;
+    static constexpr size_t max_buckets = 2048;
+    /* Buckets [offset, offset + counts.size()), dense. */
+    class store {
+    public:
+        std::vector<uint64_t> counts;
+        int offset;
+        store() : offset(0) {}
+        void add(int index, uint64_t n) {
+            if (counts.empty()) {
+                counts.push_back(0);
+                offset = index;
+            }
+            if (index < offset) {
+                // the lowest bucket absorbs anything below the range
+                if ((size_t)(offset + (int)counts.size() - index) >
+                    max_buckets) {
+                    index = offset;
+                } else {
+                    counts.insert(counts.begin(), (size_t)(offset - index), 0);
+                    offset = index;
+                }
+            } else if (index >= offset + (int)counts.size()) {
+                if ((size_t)(index - offset) + 1 > max_buckets) {
+                    collapse(index - (int)max_buckets + 1);
+                }
+                counts.resize((size_t)(index - offset) + 1, 0);
+            }
+            counts[(size_t)(index - offset)] += n;
+        }
+        /* Fold the buckets below new_offset into the bucket at new_offset. */
+        void collapse(int new_offset) {
+            size_t n = std::min(counts.size(), (size_t)(new_offset - offset));
+            uint64_t folded = 0;
+            for (size_t i = 0 ; i < n ; i++) { folded += counts[i]; }
+            counts.erase(counts.begin(), counts.begin() + n);
+            if (counts.empty()) { counts.push_back(0); }
+            counts[0] += folded;
+            offset = new_offset;
+        }
+    };
+    store positive;
+    store negative;      // by the magnitude of the values
+    uint64_t zero_count;
+    uint64_t total;
+    static double gamma(void) {
+        return (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+    }
+    static int index_of(double magnitude) {
+        static const double log_gamma = std::log(gamma());
+        return (int)std::ceil(std::log(magnitude) / log_gamma);
+    }
+    /* The middle of the bucket, in relative terms */
+    static double value_of(int index) {
+        return 2.0 * std::pow(gamma(), index) / (gamma() + 1.0);
+    }
+    static bool is_zero(double value) {
+        return std::fabs(value) < std::numeric_limits<double>::min();
+    }
+public:
+    quantile_sketch() : zero_count(0), total(0) {}
+    void add(double value, uint64_t n = 1) {
+        if (std::isnan(value) || n == 0) { return; }
+        if (is_zero(value)) {
+            zero_count += n;
+        } else if (value > 0.0) {
+            positive.add(index_of(value), n);
+        } else {
+            negative.add(index_of(-value), n);
+        }
+        total += n;
+    }
+    void merge(const quantile_sketch& other) {
+        for (size_t i = 0 ; i < other.positive.counts.size() ; i++) {
+            if (other.positive.counts[i] > 0) {
+                positive.add(other.positive.offset + (int)i,
+                    other.positive.counts[i]);
+            }
+        }
+        for (size_t i = 0 ; i < other.negative.counts.size() ; i++) {
+            if (other.negative.counts[i] > 0) {
+                negative.add(other.negative.offset + (int)i,
+                    other.negative.counts[i]);
+            }
+        }
+        zero_count += other.zero_count;
+        total += other.total;
+    }
+    uint64_t count(void) const { return total; }
+    /* q in [0,1] */
+    double quantile(double q) const {
+        if (total == 0) { return 0.0; }
+        q = std::max(0.0, std::min(1.0, q));
+        uint64_t rank = (uint64_t)(q * (double)(total - 1));
+        uint64_t seen = 0;
+        // the negative values, from the largest magnitude down
+        for (size_t i = negative.counts.size() ; i > 0 ; i--) {
+            seen += negative.counts[i-1];
+            if (seen > rank) {
+                return -value_of(negative.offset + (int)(i-1));
+            }
+        }
+        seen += zero_count;
+        if (seen > rank) { return 0.0; }
+        for (size_t i = 0 ; i < positive.counts.size() ; i++) {
+            seen += positive.counts[i];
+            if (seen > rank) {
+                return value_of(positive.offset + (int)i);
+            }
+        }
+        return positive.counts.empty() ? 0.0 :
+            value_of(positive.offset + (int)positive.counts.size() - 1);
+    }
+    /* The most common value, to the sketch's accuracy */
+    double mode(void) const {
+        uint64_t most = zero_count;
+        double value = 0.0;
+        for (size_t i = 0 ; i < negative.counts.size() ; i++) {
+            if (negative.counts[i] > most) {
+                most = negative.counts[i];
+                value = -value_of(negative.offset + (int)i);
+            }
+        }
+        for (size_t i = 0 ; i < positive.counts.size() ; i++) {
+            if (positive.counts[i] > most) {
+                most = positive.counts[i];
+                value = value_of(positive.offset + (int)i);
+            }
+        }
+        return value;
+    }
+};
+
+} // namespace apex
+
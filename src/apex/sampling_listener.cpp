@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "sampling_listener.hpp"
+#include "apex.hpp"
+#include "apex_options.hpp"
+#include "address_resolution.hpp"
+#include "thread_instance.hpp"
+#include "timer_wheel.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#if defined(__linux__)
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+// older glibc doesn't name the thread id of the sigevent
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+using namespace std;
+
+namespace apex {
+
+#if defined(__linux__)
+
+/* The samples of this thread, while its timer is armed.  A plain pointer,
+ * so that the signal handler doesn't run a thread_local constructor. */
+static APEX_NATIVE_TLS sampling_listener::thread_samples * my_samples{nullptr};
+static int sample_depth{8};
+
+static void * interrupted_pc(void * context) {
+    ucontext_t * uc = (ucontext_t*)(context);
+#if defined(__x86_64__)
+    return (void*)(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__i386__)
+    return (void*)(uc->uc_mcontext.gregs[REG_EIP]);
+#elif defined(__aarch64__)
+    return (void*)(uc->uc_mcontext.pc);
+#elif defined(__powerpc64__)
+    return (void*)(uc->uc_mcontext.gp_regs[32]); // the NIP register
+#else
+    APEX_UNUSED(uc);
+    return nullptr;
+#endif
+}
+
+/* The frame pointer of the interrupted frame, or 0 */
+static uintptr_t interrupted_fp(void * context) {
+    ucontext_t * uc = (ucontext_t*)(context);
+#if defined(__x86_64__)
+    return (uintptr_t)(uc->uc_mcontext.gregs[REG_RBP]);
+#elif defined(__i386__)
+    return (uintptr_t)(uc->uc_mcontext.gregs[REG_EBP]);
+#elif defined(__aarch64__)
+    return (uintptr_t)(uc->uc_mcontext.regs[29]);
+#else
+    APEX_UNUSED(uc);
+    return 0;
+#endif
+}
+
+/* Walk the chain of frame pointers, where each frame holds the caller's
+ * frame pointer and then the return address.  This only reads the stack:
+ * backtrace() isn't async-signal-safe, because the unwinder takes the
+ * loader's locks.  Every frame has to be aligned, inside this thread's
+ * stack and above the last one, so code built without frame pointers
+ * ends the walk early instead of crashing it. */
+static uint32_t walk_frames(uintptr_t fp,
+    const sampling_listener::thread_samples * samples,
+    void ** frames, uint32_t depth, uint32_t max) {
+    while (depth < max) {
+        if ((fp % sizeof(void*)) != 0 || fp < samples->stack_low ||
+            fp + 2 * sizeof(void*) > samples->stack_high) {
+            break;
+        }
+        void ** frame = (void**)(fp);
+        if (frame[1] == nullptr) { break; }
+        frames[depth++] = frame[1];
+        uintptr_t next = (uintptr_t)(frame[0]);
+        if (next <= fp) { break; }
+        fp = next;
+    }
+    return depth;
+}
+
+/* Only async-signal-safe work in here: no locks, and no allocation. */
+static void sigprof_handler(int sig, siginfo_t * info, void * context) {
+    APEX_UNUSED(sig);
+    APEX_UNUSED(info);
+    sampling_listener::thread_samples * samples = my_samples;
+    if (samples == nullptr) { return; }
+    int saved_errno = errno;
+    sampling_listener::sample s;
+    s.task = thread_instance::get_current_task();
+    /* CPU timers are checked on the scheduler tick, so with a short period
+     * one signal can stand for several expirations of the timer. */
+    int overrun = timer_getoverrun((timer_t)(samples->timer));
+    s.periods = 1 + (overrun > 0 ? (uint32_t)(overrun) : 0);
+    s.depth = 0;
+    void * pc = interrupted_pc(context);
+    if (pc != nullptr) {
+        s.frames[s.depth++] = pc;
+        s.depth = walk_frames(interrupted_fp(context), samples, s.frames,
+            s.depth, (uint32_t)(sample_depth));
+    }
+    if (!samples->ring.try_push(s)) {
+        samples->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    errno = saved_errno;
+}
+
+#endif // __linux__
+
+sampling_listener::sampling_listener(void) :
+    _period(apex_options::sampling_period()),
+    _depth(std::min(std::max(apex_options::sampling_depth(), 1),
+        (int)(max_depth))),
+    _active(false), _drain_timer(0), _total(0), _dropped(0) {
+}
+
+void sampling_listener::on_startup(startup_event_data &data) {
+    APEX_UNUSED(data);
+#if defined(__linux__)
+    struct sigaction act;
+    struct sigaction old;
+    memset(&act, 0, sizeof(act));
+    memset(&old, 0, sizeof(old));
+    sigaction(SIGPROF, nullptr, &old);
+    if ((old.sa_flags & SA_SIGINFO) || (old.sa_handler != SIG_DFL &&
+        old.sa_handler != SIG_IGN)) {
+        // someone else is already profiling (TAU, gprof...)
+        if (apex::instance()->get_node_id() == 0) {
+            std::cerr << "APEX: SIGPROF is already handled, "
+                      << "the sampling profiler is disabled." << std::endl;
+        }
+        return;
+    }
+    sample_depth = _depth;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_RESTART | SA_SIGINFO;
+    act.sa_sigaction = sigprof_handler;
+    sigaction(SIGPROF, &act, nullptr);
+    _active = true;
+    // drain the rings before they can fill up, at most every second
+    uint64_t drain_period = std::min<uint64_t>(
+        (uint64_t)(_period) * (ring_size / 4),
+        1000000);
+    _drain_timer = timer_wheel::instance().add(drain_period,
+        [this]() { drain(); });
+    // and sample the main thread
+    arm();
+#else
+    if (apex::instance()->get_node_id() == 0) {
+        std::cerr << "APEX: the sampling profiler is only supported on Linux."
+                  << std::endl;
+    }
+#endif
+}
+
+void sampling_listener::arm(void) {
+#if defined(__linux__)
+    if (my_samples != nullptr) { return; }
+    std::unique_lock<std::mutex> l(_threads_mutex);
+    if (!_active) { return; }
+    // the timer counts this thread's CPU time, and signals this thread
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = (pid_t)(syscall(SYS_gettid));
+    timer_t timer;
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &timer) != 0) {
+        if (apex_options::use_verbose()) {
+            perror("APEX: timer_create");
+        }
+        return;
+    }
+    thread_samples * samples = new thread_samples();
+    samples->timer = (void*)(timer);
+    // the bounds of this thread's stack, for walking its frames
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        void * stack;
+        size_t size;
+        if (pthread_attr_getstack(&attr, &stack, &size) == 0) {
+            samples->stack_low = (uintptr_t)(stack);
+            samples->stack_high = (uintptr_t)(stack) + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    _threads.push_back(samples);
+    my_samples = samples;
+    struct itimerspec its;
+    its.it_interval.tv_sec = _period / 1000000;
+    its.it_interval.tv_nsec = (_period % 1000000) * 1000;
+    its.it_value = its.it_interval;
+    timer_settime(timer, 0, &its, nullptr);
+    samples->armed = true;
+#endif
+}
+
+/* The caller holds the threads lock */
+void sampling_listener::disarm(thread_samples * samples) {
+#if defined(__linux__)
+    if (!samples->armed) { return; }
+    timer_delete((timer_t)(samples->timer));
+    samples->armed = false;
+#else
+    APEX_UNUSED(samples);
+#endif
+}
+
+void sampling_listener::on_new_thread(new_thread_event_data &data) {
+    APEX_UNUSED(data);
+    arm();
+}
+
+void sampling_listener::on_exit_thread(event_data &data) {
+    APEX_UNUSED(data);
+#if defined(__linux__)
+    thread_samples * samples = my_samples;
+    if (samples == nullptr) { return; }
+    // no more samples from this thread, so drain() can free its ring
+    my_samples = nullptr;
+    std::unique_lock<std::mutex> l(_threads_mutex);
+    disarm(samples);
+    samples->exited = true;
+#endif
+}
+
+void sampling_listener::on_pre_shutdown(void) {
+    if (_drain_timer != 0) {
+        timer_wheel::instance().remove(_drain_timer);
+        _drain_timer = 0;
+    }
+    /* Stop all the timers.  The threads that are still running keep their
+     * rings, because a signal might still be on its way to them. */
+    std::unique_lock<std::mutex> l(_threads_mutex);
+    _active = false;
+    for (auto samples : _threads) {
+        disarm(samples);
+    }
+}
+
+void sampling_listener::drain(void) {
+    in_apex prevent_memory_tracking;
+    std::unique_lock<std::mutex> drain_lock(_drain_mutex);
+    std::unique_lock<std::mutex> l(_threads_mutex);
+    std::string key;
+    for (auto samples : _threads) {
+        samples->ring.consume_all([&](const sample& s) {
+            key.assign((const char*)(&s.task), sizeof(s.task));
+            key.append((const char*)(s.frames), s.depth * sizeof(void*));
+            sample_count& c = _counts[key];
+            if (c.count == 0) {
+                c.task = s.task;
+                c.frames.assign(s.frames, s.frames + s.depth);
+            }
+            c.count += s.periods;
+            _total += s.periods;
+        });
+        _dropped += samples->dropped.exchange(0, std::memory_order_relaxed);
+    }
+    // the rings of threads that have exited are empty now, and stay empty
+    auto exited = std::partition(_threads.begin(), _threads.end(),
+        [](thread_samples * samples) { return !samples->exited; });
+    for (auto it = exited ; it != _threads.end() ; it++) {
+        delete *it;
+    }
+    _threads.erase(exited, _threads.end());
+}
+
+void sampling_listener::on_dump(dump_event_data &data) {
+    write_profile(data.node_id);
+    if (data.reset) {
+        on_reset(nullptr);
+    }
+}
+
+void sampling_listener::on_reset(task_identifier * id) {
+    if (id != nullptr) { return; }
+    drain();
+    std::unique_lock<std::mutex> l(_drain_mutex);
+    _counts.clear();
+    _total = 0;
+    _dropped = 0;
+}
+
+/* Write the samples as a flat profile of each task, and as folded call
+ * stacks (rooted at the task) that flamegraph.pl reads. */
+void sampling_listener::write_profile(int node_id) {
+    in_apex prevent_memory_tracking;
+    drain();
+    std::unique_lock<std::mutex> l(_drain_mutex);
+    if (_total == 0) { return; }
+    // resolve each address once, and all of them in one batch
+    std::vector<uintptr_t> addresses;
+    for (auto& it : _counts) {
+        const std::vector<void*>& frames = it.second.frames;
+        for (size_t i = 0 ; i < frames.size() ; i++) {
+            addresses.push_back((uintptr_t)(frames[i]) - (i > 0 ? 1 : 0));
+        }
+    }
+    resolve_addresses(addresses);
+    std::unordered_map<void*, std::string> names;
+    auto resolve = [&](void * address, bool caller) -> const std::string& {
+        auto found = names.find(address);
+        if (found != names.end()) { return found->second; }
+        // a caller's frame is a return address, after the call
+        std::string * tmp = lookup_address((uintptr_t)(address) -
+            (caller ? 1 : 0), false);
+        std::string name(*tmp);
+        delete tmp;
+        // semicolons separate the frames, and newlines the stacks
+        std::replace(name.begin(), name.end(), ';', ':');
+        std::replace(name.begin(), name.end(), '\n', ' ');
+        return names.emplace(address, name).first->second;
+    };
+    std::map<std::string, std::map<std::string, size_t>> flat;
+    std::map<std::string, size_t> task_totals;
+    std::map<std::string, size_t> folded;
+    for (auto& it : _counts) {
+        const sample_count& c = it.second;
+        std::string task("(no timer)");
+        if (c.task != nullptr) { task = c.task->get_name(); }
+        std::replace(task.begin(), task.end(), ';', ':');
+        task_totals[task] += c.count;
+        std::string leaf("(unknown)");
+        if (!c.frames.empty()) { leaf = resolve(c.frames[0], false); }
+        flat[task][leaf] += c.count;
+        std::string stack(task);
+        for (size_t i = c.frames.size() ; i > 0 ; i--) {
+            stack.append(";").append(resolve(c.frames[i-1], i > 1));
+        }
+        folded[stack] += c.count;
+    }
+    std::stringstream prefix;
+    prefix << apex_options::output_file_path() << filesystem_separator()
+           << "sample_profile." << node_id;
+    std::ofstream report(prefix.str() + ".txt");
+    report << "Sampling profile: " << _total << " samples, one per "
+           << _period << " us of CPU time";
+    if (_dropped > 0) {
+        report << " (" << _dropped << " dropped)";
+    }
+    report << std::endl;
+    // the busiest tasks first, and their busiest functions
+    std::vector<std::pair<std::string, size_t>> tasks(task_totals.begin(),
+        task_totals.end());
+    auto by_count = [](const std::pair<std::string, size_t>& a,
+        const std::pair<std::string, size_t>& b) {
+            return a.second > b.second;
+        };
+    std::stable_sort(tasks.begin(), tasks.end(), by_count);
+    report << std::fixed << std::setprecision(1);
+    for (auto& task : tasks) {
+        report << std::endl << task.first << ": " << task.second
+               << " samples, " << (100.0 * task.second / _total) << "%"
+               << std::endl;
+        auto& functions = flat[task.first];
+        std::vector<std::pair<std::string, size_t>> sorted(
+            functions.begin(), functions.end());
+        std::stable_sort(sorted.begin(), sorted.end(), by_count);
+        for (auto& f : sorted) {
+            report << std::setw(10) << f.second << std::setw(7)
+                   << (100.0 * f.second / task.second) << "%  "
+                   << f.first << std::endl;
+        }
+    }
+    report.close();
+    std::ofstream stacks(prefix.str() + ".folded");
+    for (auto& it : folded) {
+        stacks << it.first << " " << it.second << std::endl;
+    }
+    stacks.close();
+    if (node_id == 0 && apex_options::use_screen_output()) {
+        std::cout << "APEX: wrote " << _total << " samples to "
+                  << prefix.str() << ".txt" << std::endl;
+    }
+}
+
+}
+
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "event_listener.hpp"
+#include "spsc_ring.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace apex {
+
+/* A statistical profiler, for the code between (or without) timers.  Each
+ * registered thread gets a timer on its own CPU clock, which interrupts it
+ * with SIGPROF every APEX_SAMPLING_PERIOD microseconds of CPU time.  The
+ * signal handler records the interrupted PC, a short call stack and the
+ * current APEX task into a ring buffer that only that thread writes, so it
+ * takes no locks and doesn't allocate.  The rings are drained periodically
+ * (on the timer wheel) into counts per task and call stack, and addresses
+ * are only resolved when the profile is written, at dump. */
+class sampling_listener : public event_listener {
+public:
+    static const size_t max_depth = 32;
+    static const size_t ring_size = 512;
+    /* One sample, as written by the signal handler */
+    class sample {
+    public:
+        task_identifier * task;
+        uint32_t periods; // the timer can expire more than once per signal
+        uint32_t depth;
+        void * frames[max_depth];
+    };
+    /* The samples of one thread */
+    class thread_samples {
+    public:
+        spsc_ring<sample, ring_size> ring;
+        std::atomic<size_t> dropped;
+        void * timer; // the POSIX timer_t
+        uintptr_t stack_low; // the bounds of the thread's stack
+        uintptr_t stack_high;
+        bool armed;
+        bool exited;
+        thread_samples(void) : dropped(0), timer(nullptr), stack_low(0),
+            stack_high(0), armed(false), exited(false) {}
+    };
+private:
+    /* Samples with the same task and call stack */
+    class sample_count {
+    public:
+        task_identifier * task;
+        std::vector<void*> frames;
+        size_t count;
+    };
+    int _period; // microseconds
+    int _depth;
+    bool _active;
+    uint64_t _drain_timer;
+    std::mutex _threads_mutex;
+    std::vector<thread_samples*> _threads;
+    // only one thread drains the rings at a time, and owns the counts
+    std::mutex _drain_mutex;
+    std::unordered_map<std::string, sample_count> _counts;
+    size_t _total;
+    size_t _dropped;
+    void arm(void);
+    void disarm(thread_samples * samples);
+    void drain(void);
+    void write_profile(int node_id);
+public:
+    sampling_listener(void);
+    ~sampling_listener(void) {};
+    listener_mask subscriptions(void) const {
+        return APEX_LISTEN(LISTEN_STARTUP) | APEX_LISTEN(LISTEN_PRE_SHUTDOWN) |
+            APEX_LISTEN(LISTEN_DUMP) | APEX_LISTEN(LISTEN_RESET) |
+            APEX_LISTEN(LISTEN_NEW_THREAD) | APEX_LISTEN(LISTEN_EXIT_THREAD);
+    }
+    void on_startup(startup_event_data &data);
+    void on_pre_shutdown(void);
+    void on_shutdown(shutdown_event_data &data) { APEX_UNUSED(data); };
+    void on_dump(dump_event_data &data);
+    void on_reset(task_identifier * id);
+    void on_new_node(node_event_data &data) { APEX_UNUSED(data); };
+    void on_new_thread(new_thread_event_data &data);
+    void on_exit_thread(event_data &data);
+    bool on_start(std::shared_ptr<task_wrapper> &tt_ptr) {
+        APEX_UNUSED(tt_ptr);
+        return true;
+    };
+    void on_stop(std::shared_ptr<profiler> &p) { APEX_UNUSED(p); };
+    void on_yield(std::shared_ptr<profiler> &p) { APEX_UNUSED(p); };
+    bool on_resume(std::shared_ptr<task_wrapper> &tt_ptr) {
+        APEX_UNUSED(tt_ptr);
+        return true;
+    };
+    void on_task_complete(std::shared_ptr<task_wrapper> &tt_ptr) {
+        APEX_UNUSED(tt_ptr);
+    };
+    void on_sample_value(sample_value_event_data &data) { APEX_UNUSED(data); };
+    void on_periodic(periodic_event_data &data) { APEX_UNUSED(data); };
+    void on_custom_event(custom_event_data &data) { APEX_UNUSED(data); };
+    void on_send(message_event_data &data) { APEX_UNUSED(data); };
+    void on_recv(message_event_data &data) { APEX_UNUSED(data); };
+    void set_node_id(int node_id, int node_count) {
+        APEX_UNUSED(node_id);
+        APEX_UNUSED(node_count);
+    };
+};
+
+}
+
@@ -72,6 +72,15 @@ public:
         } else {
             neighbor_index = current_index + delta;
         }
+        set_neighbor_value();
+/*      std::cout << "scope: " << scope
+                  << " quarter: " << quarter
+                  << " delta: " << delta
+                  << " current_index: " << delta
+                  << " neighbor_index: " << delta
+                  << std::endl; */
+    }
+    void set_neighbor_value() {
         if (vtype == VariableType::doubletype) {
             *((double*)(value)) = dvalues[neighbor_index];
         }
@@ -81,12 +90,6 @@ public:
         else {
             *((const char**)(value)) = svalues[neighbor_index].c_str();
         }
-/*      std::cout << "scope: " << scope
-                  << " quarter: " << quarter
-                  << " delta: " << delta
-                  << " current_index: " << delta
-                  << " neighbor_index: " << delta
-                  << std::endl; */
     }
     void choose_neighbor() { current_index = neighbor_index; }
     void save_best() { best_index = current_index; }
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "apex_types.h"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace apex {
+
+/* Per-thread pools of fixed-size blocks, for the small objects that are
+ * created and destroyed for every timer: task_wrapper, profiler and the
+ * shared_ptr control blocks around them.  Blocks are carved out of larger
+ * slabs and recycled through a free list, so the global allocator is only
+ * called when a pool has to grow.
+ *
+ * A block can be released on a different thread than the one that
+ * allocated it (i.e. the task_wrapper of an asynchronous task).  Those
+ * blocks are pushed on the owning pool's lock-free "remote" list, and the
+ * owner takes them all back the next time its own free list is empty.
+ * When a thread exits, its pool is parked and adopted by the next new
+ * thread, so the memory is never lost.  The slabs are never returned to
+ * the system. */
+template<size_t Size>
+class slab_pool {
+private:
+    /* Every block starts with a header, so a block can find its way back
+     * to the pool it came from.  16 bytes, to keep the payload aligned. */
+    struct alignas(16) header {
+        slab_pool * owner;
+        header * next;
+    };
+    static constexpr size_t payload_size = (Size + 15) & ~(size_t)15;
+    static constexpr size_t block_size = sizeof(header) + payload_size;
+    static constexpr size_t blocks_per_slab = 128;
+    header * free_list;
+    std::atomic<header*> remote_list;
+    slab_pool(void) : free_list(nullptr), remote_list(nullptr) {}
+    void grow(void) {
+        char * slab = static_cast<char*>(
+            ::operator new(block_size * blocks_per_slab));
+        for (size_t i = 0 ; i < blocks_per_slab ; i++) {
+            header * h = reinterpret_cast<header*>(slab + (i * block_size));
+            h->owner = this;
+            h->next = free_list;
+            free_list = h;
+        }
+    }
+    void * allocate(void) {
+        if (free_list == nullptr) {
+            // take back everything other threads have released
+            free_list = remote_list.exchange(nullptr,
+                std::memory_order_acquire);
+            if (free_list == nullptr) {
+                grow();
+            }
+        }
+        header * h = free_list;
+        free_list = h->next;
+        return h + 1;
+    }
+    void release_local(header * h) {
+        h->next = free_list;
+        free_list = h;
+    }
+    void release_remote(header * h) {
+        header * old = remote_list.load(std::memory_order_relaxed);
+        do {
+            h->next = old;
+        } while (!remote_list.compare_exchange_weak(old, h,
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+    /* The pools of exited threads, waiting to be adopted.  Allocated on
+     * the heap so they are never destroyed at shutdown. */
+    static std::mutex& parked_mutex(void) {
+        static std::mutex * mtx = new std::mutex();
+        return *mtx;
+    }
+    static std::vector<slab_pool*>& parked(void) {
+        static std::vector<slab_pool*> * pools = new std::vector<slab_pool*>();
+        return *pools;
+    }
+    static slab_pool*& current(void) {
+        static APEX_NATIVE_TLS slab_pool * _pool = nullptr;
+        return _pool;
+    }
+    static bool& exited(void) {
+        static APEX_NATIVE_TLS bool _exited = false;
+        return _exited;
+    }
+    /* Parks the thread's pool at thread exit.  After that, the thread
+     * falls back to the global allocator. */
+    struct exit_hook {
+        ~exit_hook(void) {
+            slab_pool * p = current();
+            current() = nullptr;
+            exited() = true;
+            if (p != nullptr) {
+                std::unique_lock<std::mutex> l(parked_mutex());
+                parked().push_back(p);
+            }
+        }
+    };
+    static slab_pool * local(void) {
+        slab_pool * p = current();
+        if (p == nullptr && !exited()) {
+            {
+                std::unique_lock<std::mutex> l(parked_mutex());
+                if (parked().size() > 0) {
+                    p = parked().back();
+                    parked().pop_back();
+                }
+            }
+            if (p == nullptr) {
+                p = new slab_pool();
+            }
+            current() = p;
+            static thread_local exit_hook hook;
+            APEX_UNUSED(hook);
+        }
+        return p;
+    }
+public:
+    /* Disable the copy and assign methods. */
+    slab_pool(slab_pool const&) = delete;
+    void operator=(slab_pool const&) = delete;
+    static void * allocate_block(void) {
+        slab_pool * p = local();
+        if (p == nullptr) {
+            // this thread is exiting, use the global allocator
+            header * h = static_cast<header*>(::operator new(block_size));
+            h->owner = nullptr;
+            return h + 1;
+        }
+        return p->allocate();
+    }
+    static void release_block(void * ptr) {
+        header * h = static_cast<header*>(ptr) - 1;
+        if (h->owner == nullptr) {
+            ::operator delete(h);
+        } else if (h->owner == current()) {
+            h->owner->release_local(h);
+        } else {
+            h->owner->release_remote(h);
+        }
+    }
+};
+
+/* An allocator for std::allocate_shared, so the object and its control
+ * block both come from a slab_pool.  Arrays go to the global allocator. */
+template<typename T>
+class pool_allocator {
+public:
+    typedef T value_type;
+    static_assert(alignof(T) <= 16, "pool_allocator only aligns to 16 bytes");
+    pool_allocator(void) noexcept {}
+    template<typename U>
+    pool_allocator(const pool_allocator<U>&) noexcept {}
+    T * allocate(size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(slab_pool<sizeof(T)>::allocate_block());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T * p, size_t n) {
+        if (n == 1) {
+            slab_pool<sizeof(T)>::release_block(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const pool_allocator<T>&, const pool_allocator<U>&) {
+    return false;
+}
+
+}
+
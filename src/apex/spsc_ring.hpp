@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace apex {
+
+/* A bounded, single-producer/single-consumer ring buffer of trivially
+ * copyable records.  The producer only writes its own tail (and reads the
+ * consumer's head when it thinks the ring is full), so a push is a copy
+ * into local memory and one release store.  Only one thread may consume
+ * at a time - the caller is responsible for that. */
+template<typename T, size_t Capacity>
+class spsc_ring {
+    static_assert((Capacity & (Capacity - 1)) == 0,
+        "spsc_ring capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value,
+        "spsc_ring records must be trivially copyable");
+private:
+    static constexpr size_t mask = Capacity - 1;
+    // keep the producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> _tail;
+    size_t _cached_head;
+    alignas(64) std::atomic<size_t> _head;
+    std::unique_ptr<T[]> _buffer;
+public:
+    static constexpr size_t capacity = Capacity;
+    spsc_ring(void) : _tail(0), _cached_head(0), _head(0),
+        _buffer(new T[Capacity]) {}
+    /* Disable the copy and assign methods. */
+    spsc_ring(spsc_ring const&) = delete;
+    void operator=(spsc_ring const&) = delete;
+    /* Producer: returns false if the ring is full. */
+    bool try_push(const T& record) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head == Capacity) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head == Capacity) {
+                return false;
+            }
+        }
+        _buffer[tail & mask] = record;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    /* Producer: the number of records waiting, as of the last push. */
+    size_t size_approx(void) const {
+        return _tail.load(std::memory_order_relaxed) -
+            _head.load(std::memory_order_relaxed);
+    }
+    /* Consumer: pass every waiting record to the function, in order, then
+     * release the space.  Returns the number of records consumed. */
+    template<typename Function>
+    size_t consume_all(Function f) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        for (size_t i = head ; i != tail ; i++) {
+            f(_buffer[i & mask]);
+        }
+        _head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+    /* Consumer: pass all waiting records to the function at once, as (at
+     * most) two contiguous spans, because the ring can wrap around.  The
+     * space is released after the function returns. */
+    template<typename Function>
+    size_t consume_bulk(Function f) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t tail = _tail.load(std::memory_order_acquire);
+        size_t n = tail - head;
+        if (n == 0) { return 0; }
+        size_t first = head & mask;
+        size_t n1 = (n < Capacity - first) ? n : Capacity - first;
+        f(&_buffer[first], n1, &_buffer[0], n - n1);
+        _head.store(tail, std::memory_order_release);
+        return n;
+    }
+};
+
+}
+
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "profiler.hpp"
+#include "task_identifier.hpp"
+#include "dependency_tree.hpp"
+#include <cstdint>
+#include <type_traits>
+
+namespace apex {
+
+/* Everything the profiler_listener needs to know about a stopped timer
+ * (or a counter sample) to update the profiles.  Unlike a profiler
+ * object, it has no reference counted pointers or containers, so it
+ * can be copied into a queue with a plain memory copy. */
+struct stop_record {
+    task_identifier * task_id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t thread_id;
+    double elapsed;    // nanoseconds for timers, the value for counters
+    double inclusive;
+    double allocations;
+    double frees;
+    double bytes_allocated;
+    double bytes_freed;
+    double counters[8]; // PAPI counter deltas
+    dependency::Node * tree_node; // for tasktree/hatchet output
+    reset_type is_reset;
+    bool is_counter;
+    bool is_resume;
+    double normalized_timestamp(void) const {
+        if(is_counter) {
+            return our_clock::now_ns() - profiler::get_global_start();
+        } else {
+            return start_ns - profiler::get_global_start();
+        }
+    }
+};
+
+static_assert(std::is_trivially_copyable<stop_record>::value,
+    "stop_record has to be trivially copyable");
+
+}
+
@@ -245,6 +245,54 @@ std::mutex bfd_mutex;
       return *task_id_addr_map;
   }
 
+  /* The table of interned names and addresses.  Ids are handed out in
+   * order, so they are dense and can be used as array indices. */
+  class task_id_intern_table {
+  public:
+      std::mutex mtx;
+      std::unordered_map<std::string, uint32_t> names;
+      std::unordered_map<uint64_t, uint32_t> addresses;
+      uint32_t next_id;
+      task_id_intern_table() : next_id(1) {
+          // the empty name and the null address are the empty identifier
+          names[""] = 0;
+          addresses[APEX_NULL_FUNCTION_ADDRESS] = 0;
+      }
+  };
+
+  static task_id_intern_table& get_intern_table(void) {
+      /* By allocating this table on the heap, it won't get destroyed at
+       * shutdown, when task identifiers might still be created. */
+      static task_id_intern_table * table = new task_id_intern_table();
+      return *table;
+  }
+
+  /* These are only called when constructing a task_identifier, which
+   * get_task_id() caches per thread, so the lock is not on the hot path. */
+  uint32_t task_identifier::intern(apex_function_address a) {
+      auto& table = get_intern_table();
+      std::unique_lock<std::mutex> l(table.mtx);
+      auto got = table.addresses.find(a);
+      if (got != table.addresses.end()) {
+          return got->second;
+      }
+      uint32_t tmp = table.next_id++;
+      table.addresses[a] = tmp;
+      return tmp;
+  }
+
+  uint32_t task_identifier::intern(const std::string& n) {
+      auto& table = get_intern_table();
+      std::unique_lock<std::mutex> l(table.mtx);
+      auto got = table.names.find(n);
+      if (got != table.names.end()) {
+          return got->second;
+      }
+      uint32_t tmp = table.next_id++;
+      table.names[n] = tmp;
+      return tmp;
+  }
+
   task_identifier * task_identifier::get_task_id (apex_function_address a) {
       auto& task_id_addr_map = get_task_id_addr_map();
       apex_addr_map::const_iterator got = task_id_addr_map.find (a);
@@ -42,24 +42,33 @@ private:
   // create a task ID for every one - use a pool of them.
   static apex_name_map& get_task_id_name_map(void);
   static apex_addr_map& get_task_id_addr_map(void);
+  // every distinct name or address is interned once, into a dense id.
+  static uint32_t intern(apex_function_address a);
+  static uint32_t intern(const std::string& n);
 public:
   apex_function_address address;
   std::string name;
   std::string _resolved_name;
   bool has_name;
+  // The interned id for this name or address. Hashing and equality use
+  // only this value, the strings are only needed for output.
+  // Id 0 is reserved for the empty identifier.
+  uint32_t id;
   task_identifier(void) :
-      address(0L), name(""), _resolved_name(""), has_name(false) {};
+      address(0L), name(""), _resolved_name(""), has_name(false), id(0) {};
   task_identifier(apex_function_address a) :
-      address(a), name(""), _resolved_name(""), has_name(false) {};
+      address(a), name(""), _resolved_name(""), has_name(false),
+      id(intern(a)) {};
   task_identifier(const std::string& n) :
-      address(0L), name(n), _resolved_name(""), has_name(true) {};
+      address(0L), name(n), _resolved_name(""), has_name(true),
+      id(intern(n)) {};
   // The copy constructor doesn't copy the resolved name.  That's because
   // it would be too expensive to lock control to it, since it can be
   // updated by another thread. Therefore, leave it unresolved, no one will
   // ask for the resolved name until program exit, or in policies.
   task_identifier(const task_identifier& rhs) :
       address(rhs.address), name(rhs.name),
-      _resolved_name(""), has_name(rhs.has_name) { };
+      _resolved_name(""), has_name(rhs.has_name), id(rhs.id) { };
   task_identifier& operator=(const task_identifier& rhs) = default;
 
   static task_identifier * get_task_id (apex_function_address a);
@@ -76,7 +85,7 @@ public:
   // requried for using this class as a key in an unordered map.
   // the hash function is defined below.
   bool operator==(const task_identifier &other) const {
-    return (address == other.address && name.compare(other.name) == 0);
+    return (id == other.id);
   }
   // required for using this class as a key in a set
   bool operator< (const task_identifier &right) const {
@@ -110,10 +119,8 @@ namespace std {
   {
     std::size_t operator()(const apex::task_identifier& k) const
     {
-      std::size_t h1 = std::hash<std::size_t>()(k.address);
-      std::size_t h2 = std::hash<std::string>()(k.name);
-      std::size_t h3 = h1 ^ (h2 << 1);
-      return h3; // instead of boost::hash_combine
+      // the interned id is unique, no need to hash the name
+      return std::hash<uint32_t>()(k.id);
     }
   };
 
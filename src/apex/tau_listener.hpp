@@ -25,6 +25,13 @@ public:
   ~tau_listener (void) { };
   static bool initialize_tau(int argc, char** avgv);
   inline static bool initialized(void) { return _initialized; }
+  listener_mask subscriptions(void) const {
+    return APEX_LISTEN(LISTEN_SHUTDOWN) | APEX_LISTEN(LISTEN_DUMP) |
+        APEX_LISTEN(LISTEN_NEW_NODE) | APEX_LISTEN(LISTEN_NEW_THREAD) |
+        APEX_LISTEN(LISTEN_START) | APEX_LISTEN(LISTEN_STOP) |
+        APEX_LISTEN(LISTEN_YIELD) | APEX_LISTEN(LISTEN_RESUME) |
+        APEX_LISTEN(LISTEN_SAMPLE_VALUE);
+  }
   void on_startup(startup_event_data &data);
   void on_dump(dump_event_data &data);
   void on_reset(task_identifier * id)
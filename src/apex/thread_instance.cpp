@@ -41,6 +41,9 @@ APEX_NATIVE_TLS uint64_t my_task_id = 0;
 
 namespace apex {
 
+APEX_NATIVE_TLS std::atomic<task_identifier*>
+    thread_instance::_current_task{nullptr};
+
 /*
 // Global static pointer used to ensure a single instance of the class.
 APEX_NATIVE_TLS thread_instance * thread_instance::_instance(nullptr);
@@ -247,6 +250,7 @@ string thread_instance::map_addr_to_name(apex_function_address function_address)
 
 void thread_instance::set_current_profiler(profiler * the_profiler) {
     instance().current_profilers.push_back(the_profiler);
+    update_current_task();
     //printf("%lu pushing %s\n", get_id(), the_profiler->get_task_id()->get_short_name().c_str());
 }
 
@@ -348,6 +352,7 @@ void thread_instance::clear_current_profiler(profiler * the_profiler,
             the_stack.pop_back();
             // this is a serious problem...
             if (the_stack.empty()) {
+                update_current_task();
                 // unless...we happen to be exiting.  Bets are off.
                 if (apex_options::suspend() == true) { return; }
                 // if we've already cleared the stack on this thread, we're fine
@@ -366,6 +371,7 @@ void thread_instance::clear_current_profiler(profiler * the_profiler,
     }
     // pop this timer off the stack.
     the_stack.pop_back();
+    update_current_task();
 }
 
 profiler * thread_instance::get_current_profiler(void) {
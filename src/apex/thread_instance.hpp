@@ -124,6 +124,14 @@ private:
   // map from function address to name - unique to all threads to avoid locking
   std::map<apex_function_address, std::string> _function_map;
   std::vector<profiler*> current_profilers;
+  /* The task of the profiler on top of the stack, for the signal handler
+   * of the sampling profiler - which can't safely look at the stack. */
+  static APEX_NATIVE_TLS std::atomic<task_identifier*> _current_task;
+  static void update_current_task(void) {
+    auto& the_stack = instance().current_profilers;
+    _current_task.store(the_stack.empty() ? nullptr :
+        the_stack.back()->get_task_id(), std::memory_order_relaxed);
+  }
   uint64_t _get_guid(void) {
       // start at 1, because 0 means nullptr which means "no parent"
       _task_count++;
@@ -160,6 +168,11 @@ public:
         bool save_children, std::shared_ptr<task_wrapper> &tt_ptr);
   static void clear_current_profiler() {
     instance().current_profilers.pop_back();
+    update_current_task();
+  }
+  /* Safe to call from a signal handler */
+  static task_identifier * get_current_task(void) {
+    return _current_task.load(std::memory_order_relaxed);
   }
   static const char * program_path(void);
   static bool is_worker() { return instance()._is_worker; }
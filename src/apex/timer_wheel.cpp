@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "timer_wheel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "apex_options.hpp"
+#include "thread_instance.hpp"
+#include "utils.hpp"
+
+namespace apex {
+
+timer_wheel& timer_wheel::instance(void) {
+    /* Never destroyed, so that a timer that is still running at exit
+     * doesn't have to be joined during static destruction. */
+    static timer_wheel * the_wheel = new timer_wheel();
+    return *the_wheel;
+}
+
+timer_wheel::timer_wheel(void) :
+    tick(std::max(apex_options::timer_slack(), 1)),
+    slots(num_slots), next_id(1), current(0), executing(0),
+    running(false) {
+    current = now();
+}
+
+uint64_t timer_wheel::now(void) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() / tick;
+}
+
+void timer_wheel::insert(std::shared_ptr<timer> t) {
+    // never schedule behind the slots we have already processed
+    t->expires = std::max(t->expires, current);
+    slots[t->expires % num_slots].push_back(t);
+}
+
+void timer_wheel::unlink(const std::shared_ptr<timer>& t) {
+    slots[t->expires % num_slots].remove(t);
+}
+
+uint64_t timer_wheel::add(uint64_t period, callback f, uint64_t delay) {
+    std::unique_lock<std::mutex> lk(mtx);
+    uint64_t id = next_id++;
+    std::shared_ptr<timer> t = std::make_shared<timer>(id, to_ticks(period),
+        now() + (delay == 0 ? 0 : to_ticks(delay)), f);
+    timers.insert(std::make_pair(id, t));
+    insert(t);
+    if (!running) {
+        // the previous thread ran out of timers, and has exited (or will).
+        if (worker.joinable()) { worker.join(); }
+        running = true;
+        worker = std::thread(&timer_wheel::run, this);
+        worker_id = worker.get_id();
+    } else {
+        cv.notify_all();
+    }
+    return id;
+}
+
+void timer_wheel::set_period(uint64_t id, uint64_t period) {
+    std::unique_lock<std::mutex> lk(mtx);
+    auto t = timers.find(id);
+    if (t == timers.end()) { return; }
+    t->second->period = to_ticks(period);
+    // a running timer is rescheduled with the new period when it returns
+    if (executing != id) {
+        unlink(t->second);
+        t->second->expires = now() + t->second->period;
+        insert(t->second);
+        cv.notify_all();
+    }
+}
+
+void timer_wheel::remove(uint64_t id) {
+    std::unique_lock<std::mutex> lk(mtx);
+    auto t = timers.find(id);
+    if (t == timers.end()) { return; }
+    t->second->removed = true;
+    unlink(t->second);
+    timers.erase(t);
+    if (executing == id && std::this_thread::get_id() != worker_id) {
+        done_cv.wait(lk, [&]{ return executing != id; });
+    }
+    cv.notify_all();
+}
+
+size_t timer_wheel::size(void) {
+    std::unique_lock<std::mutex> lk(mtx);
+    return timers.size();
+}
+
+/* The first tick with a timer that expires on it */
+uint64_t timer_wheel::next_expiry(void) {
+    for (uint64_t i = current ; i < current + num_slots ; i++) {
+        for (auto& t : slots[i % num_slots]) {
+            if (t->expires == i) { return i; }
+        }
+    }
+    // nothing in this turn of the wheel, so check them all
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (auto& t : timers) {
+        next = std::min(next, t.second->expires);
+    }
+    return next;
+}
+
+void timer_wheel::run(void) {
+    // make sure APEX knows this is not a worker thread
+    thread_instance::instance(false).set_worker(false);
+    if (apex_options::pin_apex_threads()) {
+        set_thread_affinity();
+    }
+    std::unique_lock<std::mutex> lk(mtx);
+    while (!timers.empty()) {
+        uint64_t t = now();
+        if (t >= current) {
+            // collect everything that has expired since we last looked
+            std::vector<std::shared_ptr<timer>> due;
+            uint64_t count = std::min<uint64_t>(t - current + 1, num_slots);
+            for (uint64_t i = 0 ; i < count ; i++) {
+                auto& slot = slots[(current + i) % num_slots];
+                for (auto it = slot.begin() ; it != slot.end() ; ) {
+                    if ((*it)->expires <= t) {
+                        due.push_back(*it);
+                        it = slot.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+            current = t + 1;
+            for (auto& d : due) {
+                if (d->removed) { continue; }
+                executing = d->id;
+                lk.unlock();
+                d->func();
+                lk.lock();
+                executing = 0;
+                done_cv.notify_all();
+                if (d->removed) { continue; }
+                // keep the phase, unless we have fallen behind
+                d->expires += d->period;
+                if (d->expires <= t) { d->expires = t + d->period; }
+                insert(d);
+            }
+            continue;
+        }
+        uint64_t next = next_expiry();
+        if (next == std::numeric_limits<uint64_t>::max()) { break; }
+        cv.wait_until(lk, std::chrono::steady_clock::time_point(
+            std::chrono::microseconds(next * tick)));
+    }
+    running = false;
+}
+
+}
+
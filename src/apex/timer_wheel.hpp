@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <list>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace apex {
+
+/* Runs all of the periodic activities of APEX (the policy handlers, the
+ * concurrency handler, the /proc reader) on one background thread, instead
+ * of one thread each.  The timers are kept in a hashed timing wheel with
+ * one slot per tick, and their deadlines are rounded up to whole ticks -
+ * so timers that expire within the same tick (APEX_TIMER_SLACK) share one
+ * wakeup of the thread.  The thread sleeps until the next deadline, and it
+ * exits when there are no timers left. */
+class timer_wheel {
+public:
+    typedef std::function<void(void)> callback;
+    static timer_wheel& instance(void);
+    /* Call f every period microseconds, starting after delay microseconds.
+     * Returns the id of the timer, which is never zero. */
+    uint64_t add(uint64_t period, callback f, uint64_t delay);
+    uint64_t add(uint64_t period, callback f) {
+        return add(period, f, period);
+    }
+    void set_period(uint64_t id, uint64_t period);
+    /* Stop a timer.  If its callback is running on the timer thread, wait
+     * for it to finish - unless the callback is the one stopping it. */
+    void remove(uint64_t id);
+    size_t size(void);
+private:
+    class timer {
+    public:
+        uint64_t id;
+        uint64_t period; // in ticks
+        uint64_t expires; // in ticks
+        callback func;
+        bool removed;
+        timer(uint64_t _id, uint64_t _period, uint64_t _expires,
+            callback _func) : id(_id), period(_period), expires(_expires),
+            func(_func), removed(false) {}
+    };
+    static const size_t num_slots = 512;
+    const uint64_t tick; // in microseconds
+    std::vector<std::list<std::shared_ptr<timer>>> slots;
+    std::unordered_map<uint64_t, std::shared_ptr<timer>> timers;
+    uint64_t next_id;
+    uint64_t current; // the next tick to process
+    uint64_t executing; // the id of the running callback, or zero
+    std::mutex mtx;
+    std::condition_variable cv; // wakes the timer thread
+    std::condition_variable done_cv; // a callback finished
+    std::thread worker;
+    std::thread::id worker_id;
+    bool running;
+    timer_wheel(void);
+    uint64_t now(void) const;
+    uint64_t to_ticks(uint64_t microseconds) const {
+        uint64_t ticks = (microseconds + tick - 1) / tick;
+        return ticks > 0 ? ticks : 1;
+    }
+    void insert(std::shared_ptr<timer> t);
+    void unlink(const std::shared_ptr<timer>& t);
+    uint64_t next_expiry(void);
+    void run(void);
+};
+
+}
+
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/* The binary trace event log, written by the trace_event_listener when
+ * APEX_TRACE_EVENT_BINARY is set, and converted to Chrome/Perfetto JSON
+ * offline by apex_trace_convert.
+ *
+ * The file is a file_header followed by a sequence of records.  Each
+ * record starts with a kind byte.  Strings (timer, counter, category and
+ * thread names) are written once, as a string_header followed by the
+ * characters, and referred to by their id after that.  Because each thread
+ * writes to its own buffer, a string can appear later in the file than the
+ * first event that uses it - readers have to collect the strings first.
+ * The records are in host byte order. */
+
+namespace apex {
+namespace binary_trace {
+
+constexpr char magic[8] = {'A','P','E','X','T','R','C','E'};
+constexpr uint32_t version = 1;
+
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_id;
+};
+
+enum kind : uint8_t {
+    string_def = 1,
+    trace_begin,       // ts
+    trace_end,         // ts
+    thread_name,       // tid, name
+    thread_sort_index, // tid, id = sort index
+    begin,             // tid, name, cat, ts, id = GUID, id2 = parent GUID
+    end,               // tid, name, cat, ts
+    complete,          // tid, name, cat, ts, value = duration, id, id2
+    counter,           // name, cat, ts, value
+    flow_start,        // tid, name -> name2, cat, ts, id = flow id
+    flow_step,         // tid, name -> name2, cat, ts, id = flow id
+    flow_end           // tid, name -> name2, cat, ts, id = flow id
+};
+
+struct string_header {
+    uint8_t kind;
+    uint8_t unused[3];
+    uint32_t id;
+    uint32_t length;
+};
+
+struct event {
+    uint8_t kind;
+    uint8_t unused[3];
+    uint32_t name;  // string id
+    uint32_t name2; // string id, the target of a flow event
+    uint32_t cat;   // string id
+    uint64_t tid;
+    uint64_t id;
+    uint64_t id2;
+    double ts;      // microseconds
+    double value;
+};
+
+static_assert(std::is_trivially_copyable<event>::value,
+    "binary trace events have to be trivially copyable");
+
+/* The records are handed to the file writer in chunks of about this
+ * size, so they can be compressed in parallel. */
+constexpr size_t chunk_size = 16 * 1024 * 1024;
+
+inline void append_string(std::string& out, uint32_t id,
+    const std::string& s) {
+    string_header h;
+    memset(&h, 0, sizeof(string_header));
+    h.kind = string_def;
+    h.id = id;
+    h.length = (uint32_t)s.size();
+    out.append(reinterpret_cast<const char*>(&h), sizeof(string_header));
+    out.append(s);
+}
+
+/* One thread's records, waiting to be flushed.  The mutex is only
+ * contended while the buffer is being flushed.  Every record added is
+ * counted in the listener's total, for the flushing and backpressure. */
+class buffer {
+private:
+    void reserve(size_t bytes) {
+        if (data.size() + bytes > chunk_size && data.size() > 0) {
+            full.push_back(std::move(data));
+            data = std::string();
+        }
+        buffered->fetch_add(bytes, std::memory_order_relaxed);
+    }
+public:
+    std::mutex mtx;
+    std::vector<std::string> full; // complete chunks
+    std::string data;              // the current chunk
+    std::atomic<size_t> * buffered;
+    /* task_identifier id -> string id, so a timer name is only
+     * interned once per thread. */
+    std::vector<uint32_t> task_names;
+    buffer(std::atomic<size_t> * total) : buffered(total) {}
+    void append(const event& e) {
+        std::unique_lock<std::mutex> l(mtx);
+        reserve(sizeof(event));
+        data.append(reinterpret_cast<const char*>(&e), sizeof(event));
+    }
+    void append_string(uint32_t id, const std::string& s) {
+        std::unique_lock<std::mutex> l(mtx);
+        reserve(sizeof(string_header) + s.size());
+        binary_trace::append_string(data, id, s);
+    }
+};
+
+} // namespace binary_trace
+} // namespace apex
+
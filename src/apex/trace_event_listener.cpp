@@ -9,9 +9,11 @@
 #include "trace_event_listener.hpp"
 #include "thread_instance.hpp"
 #include "apex.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <cstring>
 #include <iomanip>
 #include <future>
 #include <thread>
@@ -23,7 +25,12 @@ namespace apex {
 bool trace_event_listener::_initialized(false);
 
 trace_event_listener::trace_event_listener (void) : _terminate(false),
-    num_events(0), _end_time(0.0) {
+    _binary(apex_options::trace_event_binary()), _cat_cpu(0), _cat_gpu(0),
+    _cat_flow(0), _writer(nullptr), _flush_requested(false),
+    _flusher_running(false), _flusher_stop(false), _flush_pending(false),
+    _buffered_bytes(0),
+    _buffer_limit((size_t)(apex_options::trace_event_buffer_size()) << 20),
+    _end_time(0.0) {
     _initialized = true;
     // set up our swappable buffer to prevent blocking at flush time
     trace = new std::stringstream();
@@ -35,9 +42,21 @@ trace_event_listener::~trace_event_listener (void) {
         close_trace();
         _terminate = true;
     }
+    delete _writer;
     delete trace;
 }
 
+/* A zeroed binary record, so the unused fields compress well */
+static binary_trace::event make_event(binary_trace::kind k, uint64_t tid,
+    double ts) {
+    binary_trace::event e;
+    memset(&e, 0, sizeof(binary_trace::event));
+    e.kind = k;
+    e.tid = tid;
+    e.ts = ts;
+    return e;
+}
+
 void trace_event_listener::end_trace_time(void) {
     if (_end_time == 0.0) {
         _end_time = profiler::now_us();
@@ -48,6 +67,15 @@ void trace_event_listener::on_startup(startup_event_data &data) {
     APEX_UNUSED(data);
     saved_node_id = apex::instance()->get_node_id();
     reversed_node_id = ((uint64_t)(simple_reverse((uint32_t)saved_node_id))) << 32;
+    start_flusher();
+    if (_binary) {
+        binary_trace::buffer& b = get_binary_buffer();
+        _cat_cpu = string_id(b, "CPU");
+        _cat_gpu = string_id(b, "GPU");
+        _cat_flow = string_id(b, "ControlFlow");
+        b.append(make_event(binary_trace::trace_begin, 0, profiler::now_us()));
+        return;
+    }
     std::stringstream ss;
     ss.precision(3);
     ss << fixed
@@ -105,7 +133,9 @@ void trace_event_listener::on_exit_thread(event_data &data) {
 
 inline void trace_event_listener::_common_start(std::shared_ptr<task_wrapper> &tt_ptr) {
     static APEX_NATIVE_TLS long unsigned int tid = get_thread_id_metadata();
-    if (!_terminate) {
+    if (!_terminate && _binary) {
+        binary_start(tt_ptr, tid);
+    } else if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -163,6 +193,10 @@ long unsigned int trace_event_listener::get_thread_id_metadata() {
 long unsigned int trace_event_listener::get_thread_id_metadata_internal() {
     int tid = thread_instance::get_id();
     saved_node_id = apex::instance()->get_node_id();
+    if (_binary) {
+        binary_thread_metadata(tid, "CPU Thread " + std::to_string(tid), tid);
+        return tid;
+    }
     std::stringstream ss;
     ss.precision(3);
     ss << fixed
@@ -203,7 +237,9 @@ inline void trace_event_listener::_common_stop(std::shared_ptr<profiler> &p) {
     // But don't worry, the thread metadata will have been written at the
     // event start.
     long unsigned int _tid = (p->tt_ptr->explicit_trace_start ? p->thread_id : tid);
-    if (!_terminate) {
+    if (!_terminate && _binary) {
+        binary_stop(p, _tid);
+    } else if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -272,6 +308,88 @@ inline void trace_event_listener::_common_stop(std::shared_ptr<profiler> &p) {
     return;
 }
 
+void trace_event_listener::binary_start(std::shared_ptr<task_wrapper> &tt_ptr,
+    uint64_t tid) {
+    binary_trace::buffer& b = get_binary_buffer();
+    auto e = make_event(binary_trace::begin, tid, tt_ptr->prof->get_start_us());
+    e.name = task_name_id(b, tt_ptr->get_task_id());
+    e.cat = _cat_cpu;
+    e.id = tt_ptr->prof->guid;
+    if (tt_ptr->parent != nullptr) {
+        e.id2 = tt_ptr->parent->guid;
+    }
+    b.append(e);
+#if APEX_HAVE_PAPI
+    int i = 0;
+    for (auto metric :
+        apex::instance()->the_profiler_listener->get_metric_names()) {
+        auto c = make_event(binary_trace::counter, tid, e.ts);
+        c.name = string_id(b, metric);
+        c.cat = _cat_cpu;
+        c.value = tt_ptr->prof->papi_start_values[i++];
+        b.append(c);
+    }
+#endif
+}
+
+void trace_event_listener::binary_flow(binary_trace::buffer& b,
+    binary_trace::kind k, double ts, uint32_t cat, uint64_t id, uint64_t tid,
+    uint32_t parent_name, uint32_t child_name) {
+    auto e = make_event(k, tid, ts);
+    e.name = parent_name;
+    e.name2 = child_name;
+    e.cat = cat;
+    e.id = id;
+    b.append(e);
+}
+
+void trace_event_listener::binary_stop(std::shared_ptr<profiler> &p,
+    uint64_t tid) {
+    binary_trace::buffer& b = get_binary_buffer();
+    uint32_t name = task_name_id(b, p->get_task_id());
+    // if the parent tid is not the same, create a flow event BEFORE the single event
+    if (p->tt_ptr->parent != nullptr
+#ifndef APEX_HAVE_HPX // ...except for HPX - make the flow event regardless
+        && p->tt_ptr->parent->thread_id != tid
+#endif
+        ) {
+        uint64_t flow_id = reversed_node_id + get_flow_id();
+        uint32_t parent = task_name_id(b, p->tt_ptr->parent->task_id);
+        binary_flow(b, binary_trace::flow_start,
+            p->tt_ptr->parent->get_flow_us()+0.25, _cat_flow, flow_id,
+            p->tt_ptr->parent->thread_id, parent, name);
+        binary_flow(b, binary_trace::flow_end, p->get_start_us()-0.25,
+            _cat_flow, flow_id, tid, parent, name);
+    }
+    if (p->tt_ptr->explicit_trace_start) {
+        auto e = make_event(binary_trace::end, tid, p->get_stop_us());
+        e.name = name;
+        e.cat = _cat_cpu;
+        b.append(e);
+    } else {
+        auto e = make_event(binary_trace::complete, tid, p->get_start_us());
+        e.name = name;
+        e.cat = _cat_cpu;
+        e.value = p->get_stop_us() - p->get_start_us();
+        e.id = p->guid;
+        if (p->tt_ptr->parent != nullptr) {
+            e.id2 = p->tt_ptr->parent->guid;
+        }
+        b.append(e);
+    }
+#if APEX_HAVE_PAPI
+    int i = 0;
+    for (auto metric :
+        apex::instance()->the_profiler_listener->get_metric_names()) {
+        auto c = make_event(binary_trace::counter, tid, p->get_stop_us());
+        c.name = string_id(b, metric);
+        c.cat = _cat_cpu;
+        c.value = p->papi_stop_values[i++];
+        b.append(c);
+    }
+#endif
+}
+
 void trace_event_listener::on_stop(std::shared_ptr<profiler> &p) {
     return _common_stop(p);
 }
@@ -281,7 +399,14 @@ void trace_event_listener::on_yield(std::shared_ptr<profiler> &p) {
 }
 
 void trace_event_listener::on_sample_value(sample_value_event_data &data) {
-    if (!_terminate) {
+    if (!_terminate && _binary) {
+        binary_trace::buffer& b = get_binary_buffer();
+        auto e = make_event(binary_trace::counter, 0, profiler::now_us());
+        e.name = string_id(b, *(data.counter_name));
+        e.cat = _cat_cpu;
+        e.value = data.counter_value;
+        b.append(e);
+    } else if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -328,6 +453,10 @@ std::string trace_event_listener::make_tid (base_thread_node &node) {
     if (vthread_map.count(node) == 0) {
         uint32_t id_shifted = node.sortable_tid();
         vthread_map.insert(std::pair<base_thread_node, size_t>(node,id_shifted));
+        if (_binary) {
+            binary_thread_metadata(id_shifted, node.name(), id_shifted);
+            return std::to_string(id_shifted);
+        }
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -356,7 +485,40 @@ std::string trace_event_listener::make_tid (base_thread_node &node) {
 
 void trace_event_listener::on_async_event(base_thread_node &node,
     std::shared_ptr<profiler> &p, const async_event_data& data) {
-    if (!_terminate) {
+    if (!_terminate && _binary) {
+        uint64_t tid = std::stoul(make_tid(node));
+        binary_trace::buffer& b = get_binary_buffer();
+        auto e = make_event(binary_trace::complete, tid, p->get_start_us());
+        e.name = task_name_id(b, p->get_task_id());
+        e.cat = _cat_gpu;
+        e.value = p->get_stop_us() - p->get_start_us();
+        e.id = p->guid;
+        if (p->tt_ptr != nullptr && p->tt_ptr->parent != nullptr) {
+            e.id2 = p->tt_ptr->parent->guid;
+        }
+        b.append(e);
+        if (data.flow) {
+            uint64_t flow_id = reversed_node_id + get_flow_id();
+            uint32_t cat = string_id(b, data.cat);
+            uint32_t parent = string_id(b, data.name);
+            if (data.reverse_flow) {
+                double begin_ts = (p->get_stop_us() + p->get_start_us()) * 0.5;
+                double end_ts = std::min(p->get_stop_us(), data.parent_ts_stop);
+                binary_flow(b, binary_trace::flow_start, begin_ts, cat, flow_id,
+                    tid, parent, e.name);
+                binary_flow(b, binary_trace::flow_step, end_ts, cat, flow_id,
+                    data.parent_tid, parent, e.name);
+            } else {
+                double begin_ts = std::min(p->get_start_us(),
+                    ((data.parent_ts_stop + data.parent_ts_start) * 0.5));
+                double end_ts = p->get_start_us();
+                binary_flow(b, binary_trace::flow_start, begin_ts, cat, flow_id,
+                    data.parent_tid, parent, e.name);
+                binary_flow(b, binary_trace::flow_step, end_ts, cat, flow_id,
+                    tid, parent, e.name);
+            }
+        }
+    } else if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -395,7 +557,15 @@ void trace_event_listener::on_async_event(base_thread_node &node,
 
 void trace_event_listener::on_async_metric(base_thread_node &node,
     std::shared_ptr<profiler> &p) {
-    if (!_terminate) {
+    if (!_terminate && _binary) {
+        make_tid(node);
+        binary_trace::buffer& b = get_binary_buffer();
+        auto e = make_event(binary_trace::counter, 0, p->get_stop_us());
+        e.name = task_name_id(b, p->get_task_id());
+        e.cat = _cat_gpu;
+        e.value = p->value;
+        b.append(e);
+    } else if (!_terminate) {
         std::stringstream ss;
         ss.precision(3);
         ss << fixed;
@@ -465,124 +635,261 @@ void trace_event_listener::write_to_trace(std::stringstream& events) {
     static APEX_NATIVE_TLS std::mutex * mtx = get_thread_mutex(index);
     static APEX_NATIVE_TLS std::stringstream * strm = get_thread_stream(index);
     mtx->lock();
+    // count the bytes before the writer can see (and subtract) them
+    _buffered_bytes.fetch_add((size_t)(events.tellp()),
+        std::memory_order_relaxed);
     (*strm) << events.rdbuf();
     mtx->unlock();
 }
 
-std::string trace_event_listener::get_file_name() {
+void trace_event_listener::binary_thread_metadata(uint64_t tid,
+    const std::string& name, uint64_t sort_index) {
+    binary_trace::buffer& b = get_binary_buffer();
+    auto e = make_event(binary_trace::thread_name, tid, 0.0);
+    e.name = string_id(b, name);
+    b.append(e);
+    e = make_event(binary_trace::thread_sort_index, tid, 0.0);
+    e.id = sort_index;
+    b.append(e);
+}
+
+binary_trace::buffer& trace_event_listener::get_binary_buffer(void) {
+    static APEX_NATIVE_TLS binary_trace::buffer * b = make_binary_buffer();
+    return *b;
+}
+
+binary_trace::buffer* trace_event_listener::make_binary_buffer(void) {
+    // never deleted, other threads may flush it after this thread exits
+    binary_trace::buffer * b = new binary_trace::buffer(&_buffered_bytes);
+    std::unique_lock<std::mutex> l(_vthread_mutex);
+    binary_buffers.push_back(b);
+    return b;
+}
+
+/* Intern a string for the binary trace.  The first time a string is seen,
+ * its definition is written to the calling thread's buffer. */
+uint32_t trace_event_listener::string_id(binary_trace::buffer& b,
+    const std::string& s) {
+    std::unique_lock<std::mutex> l(_string_mutex);
+    auto it = string_ids.find(s);
+    if (it != string_ids.end()) {
+        return it->second;
+    }
+    uint32_t id = (uint32_t)(string_ids.size()) + 1;
+    string_ids.insert(std::pair<std::string, uint32_t>(s, id));
+    b.append_string(id, s);
+    return id;
+}
+
+/* Timer names are cached per thread, by task_identifier id, so the
+ * string table is only locked the first time a thread sees a timer. */
+uint32_t trace_event_listener::task_name_id(binary_trace::buffer& b,
+    task_identifier * id) {
+    if (id->id >= b.task_names.size()) {
+        b.task_names.resize(id->id + 1, 0);
+    }
+    if (b.task_names[id->id] == 0) {
+        b.task_names[id->id] = string_id(b, id->get_name());
+    }
+    return b.task_names[id->id];
+}
+
+std::string trace_event_listener::binary_header(void) {
+    binary_trace::file_header header;
+    memcpy(header.magic, binary_trace::magic, sizeof(header.magic));
+    header.version = binary_trace::version;
+    header.node_id = (uint32_t)saved_node_id;
+    std::string out(reinterpret_cast<const char*>(&header),
+        sizeof(binary_trace::file_header));
+    /* Every file gets all the strings so far, so a rotated file can
+     * be converted on its own. */
+    std::unique_lock<std::mutex> l(_string_mutex);
+    for (auto& s : string_ids) {
+        binary_trace::append_string(out, s.second, s.first);
+    }
+    return out;
+}
+
+std::string trace_event_listener::json_footer(double ts) {
+    std::stringstream ss;
+    ss.precision(3);
+    ss << fixed;
+    ss << "{\"name\":\"APEX Trace End\""
+       << ", \"ph\":\"R\",\"pid\":"
+       << saved_node_id << ",\"tid\":0,\"ts\":"
+       << fixed << ts << "}\n";
+    ss << "]\n";
+    ss << "}\n" << std::endl;
+    return ss.str();
+}
+
+trace_file_writer * trace_event_listener::make_writer(void) {
     saved_node_id = apex::instance()->get_node_id();
     std::stringstream ss;
     ss << apex_options::output_file_path() << "/";
-    ss << "trace_events." << saved_node_id << ".json";
+    ss << "trace_events." << saved_node_id;
+    std::string suffix(_binary ? ".bin" : ".json");
+    bool compress = false;
 #ifdef APEX_HAVE_ZLIB
-    ss << ".gz";
+    suffix += ".gz";
+    compress = true;
 #endif
-    std::string tmp{ss.str()};
-    return tmp;
+    trace_file_writer::section_function header;
+    trace_file_writer::section_function footer;
+    if (_binary) {
+        header = [this](){ return binary_header(); };
+        footer = [](){ return std::string(); };
+    } else {
+        header = [](){ return std::string("{\n\"traceEvents\": [\n"); };
+        footer = [this](){ return json_footer(profiler::now_us()); };
+    }
+    return new trace_file_writer(ss.str(), suffix, compress,
+        apex_options::trace_event_compression_threads(), _buffer_limit,
+        (size_t)(apex_options::trace_event_max_file_size()) << 20,
+        apex_options::trace_event_max_files(), header, footer);
 }
 
-#ifdef APEX_HAVE_ZLIB
-io::gzofstream& trace_event_listener::get_trace_file() {
-    static io::gzofstream _trace_file(get_file_name());
-    // automatically opens
-    static bool header{false};
-    if (!header) {
-        header = true;
-        _trace_file << fixed << "{\n";
-        //_trace_file << "\"displayTimeUnit\": \"us\",\n";
-        _trace_file << "\"traceEvents\": [\n";
-    }
-    return _trace_file;
-}
+/* Drain the buffers into the file writer. */
+void trace_event_listener::flush_buffers(void) {
+    _flush_pending = false;
+    if (_writer == nullptr) {
+        _writer = make_writer();
+    }
+    size_t drained = 0;
+    if (_binary) {
+        std::vector<binary_trace::buffer*> buffers;
+        _vthread_mutex.lock();
+        buffers = binary_buffers;
+        _vthread_mutex.unlock();
+        std::vector<std::string> chunks;
+        std::string data;
+        for (auto b : buffers) {
+            // swap the buffers, so the thread isn't blocked by the write
+            b->mtx.lock();
+            chunks.swap(b->full);
+            data.swap(b->data);
+            b->mtx.unlock();
+            for (auto& chunk : chunks) {
+                drained += chunk.size();
+                _writer->write(std::move(chunk));
+            }
+            chunks.clear();
+            drained += data.size();
+            _writer->write(std::move(data));
+            data = std::string();
+        }
+    } else {
+#ifdef SERIAL
+        _vthread_mutex.lock();
+        std::string data(trace->str());
+        trace->str("");
+        _vthread_mutex.unlock();
 #else
-std::ofstream& trace_event_listener::get_trace_file() {
-    static std::ofstream _trace_file;
-    if (!_trace_file.is_open()) {
-        _trace_file.open(get_file_name());
-        _trace_file << fixed << "{\n";
-        //_trace_file << "\"displayTimeUnit\": \"ms\",\n";
-        _trace_file << "\"traceEvents\": [\n";
+        _vthread_mutex.lock();
+        size_t count = streams.size();
+        _vthread_mutex.unlock();
+        std::stringstream ss;
+        for (size_t index = 0 ; index < count ; index++) {
+            std::mutex * mtx = get_thread_mutex(index);
+            std::stringstream * strm = get_thread_stream(index);
+            mtx->lock();
+            ss << strm->rdbuf();
+            strm->str("");
+            mtx->unlock();
+        }
+        std::string data(ss.str());
+#endif
+        drained = data.size();
+        // split at event boundaries, so the chunks can be compressed in parallel
+        size_t pos = 0;
+        while (data.size() - pos > binary_trace::chunk_size) {
+            size_t end = data.find('\n', pos + binary_trace::chunk_size);
+            if (end == std::string::npos) { break; }
+            _writer->write(data.substr(pos, end + 1 - pos));
+            pos = end + 1;
+        }
+        _writer->write(pos == 0 ? std::move(data) : data.substr(pos));
     }
-    return _trace_file;
+    _buffered_bytes -= drained;
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    _space_cv.notify_all();
 }
-#endif
 
-void trace_event_listener::flush_trace(trace_event_listener* listener) {
-    static atomic<bool> flushing{false};
-    // don't track memory in this new thread/function.
+void trace_event_listener::flusher_loop(void) {
+    // don't track memory in this thread.
     in_apex prevent_memory_tracking;
-    while (flushing) {} // wait for asynchronous flushing, if it's happening
-    flushing = true;
-    auto& trace_file = listener->get_trace_file();
-#ifdef SERIAL
-    // flush the trace
-    listener->_vthread_mutex.lock();
-    trace_file << listener->trace->rdbuf();
-    // reset the buffer
-    listener->trace->str("");
-    listener->_vthread_mutex.unlock();
-    /*
-    // save the stringstream pointer
-    std::stringstream* tmp = listener->trace;
-    // make to new stringstream
-    listener->trace = new std::stringstream{};
-    // unlock and continue
-    listener->_vthread_mutex.unlock();
-    // flush the old stream to disk
-    trace_file << tmp->rdbuf();
-    // delete the flushed stringstream
-    delete tmp;
-    */
-#else
-    listener->_vthread_mutex.lock();
-    size_t count = listener->streams.size();
-    listener->_vthread_mutex.unlock();
-    std::stringstream ss;
-    for (size_t index = 0 ; index < count ; index++) {
-        auto p2 = scoped_timer("APEX: " + to_string(index) + " thread flush");
-        std::mutex * mtx = listener->get_thread_mutex(index);
-        std::stringstream * strm = listener->get_thread_stream(index);
-        mtx->lock();
-        ss << strm->rdbuf();
-        strm->str("");
-        mtx->unlock();
-    }
-    // flush the trace
-    trace_file << ss.rdbuf() << std::flush;
-#endif
-    // flush the trace
-    trace_file << std::flush;
-    flushing = false;
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    while (true) {
+        _flush_cv.wait_for(lock, std::chrono::seconds(1),
+            [this]{ return _flush_requested || _flusher_stop; });
+        bool stop = _flusher_stop;
+        _flush_requested = false;
+        lock.unlock();
+        flush_buffers();
+        lock.lock();
+        if (stop) { break; }
+    }
+}
+
+void trace_event_listener::start_flusher(void) {
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    if (_flusher_running) { return; }
+    _flusher_running = true;
+    _flusher = std::thread(&trace_event_listener::flusher_loop, this);
+}
+
+void trace_event_listener::stop_flusher(void) {
+    {
+        std::unique_lock<std::mutex> lock(_flush_mutex);
+        if (!_flusher_running) { return; }
+        _flusher_stop = true;
+        _flush_cv.notify_one();
+    }
+    _flusher.join();
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    _flusher_running = false;
+    // release anyone still waiting for space
+    _space_cv.notify_all();
+}
+
+void trace_event_listener::request_flush(void) {
+    std::unique_lock<std::mutex> lock(_flush_mutex);
+    _flush_requested = true;
+    _flush_cv.notify_one();
 }
 
 void trace_event_listener::flush_trace_if_necessary(bool force) {
-    auto tmp = ++num_events;
-    /* flush after every 100k events */
-    if (tmp % 1000000 == 0 || force) {
-        //flush_trace(this);
-        //std::async(std::launch::async, flush_trace, this);
-        //std::cout << "Flushing APEX trace..." << std::endl;
-        std::thread(flush_trace, this).detach();
+    if (_terminate) { return; }
+    size_t buffered = _buffered_bytes.load(std::memory_order_relaxed);
+    /* wake the flusher when a chunk's worth of data is waiting, or half
+     * the buffer if that is smaller */
+    if ((force || buffered >= std::min(binary_trace::chunk_size,
+        _buffer_limit / 2)) &&
+        !_flush_pending.exchange(true)) {
+        request_flush();
+    }
+    /* if the flusher can't keep up, wait for it */
+    if (buffered > _buffer_limit) {
+        std::unique_lock<std::mutex> lock(_flush_mutex);
+        _space_cv.wait(lock, [this]{
+            return _buffered_bytes <= _buffer_limit ||
+                !_flusher_running || _flusher_stop;
+        });
     }
 }
 
 void trace_event_listener::close_trace(void) {
     static bool closed{false};
     if (closed) return;
-    auto& trace_file = get_trace_file();
-    std::stringstream ss;
-    ss.precision(3);
-    ss << fixed;
-    ss << "{\"name\":\"APEX Trace End\""
-       << ", \"ph\":\"R\",\"pid\":"
-       << saved_node_id << ",\"tid\":0,\"ts\":"
-       << fixed << _end_time << "}\n";
-    ss << "]\n";
-    ss << "}\n" << std::endl;
-    write_to_trace(ss);
-    flush_trace(this);
+    if (_binary) {
+        get_binary_buffer().append(
+            make_event(binary_trace::trace_end, 0, _end_time));
+    }
+    stop_flusher();
+    // whatever is left, if the flusher never ran
+    flush_buffers();
+    _writer->close(_binary ? std::string() : json_footer(_end_time));
     //printf("Closing trace...\n"); fflush(stdout);
-    trace_file.close();
     closed = true;
 }
 
@@ -10,16 +10,16 @@
 
 #include "event_listener.hpp"
 #include "async_thread_node.hpp"
+#include "trace_event_binary.hpp"
+#include "trace_file_writer.hpp"
+#include <condition_variable>
 #include <memory>
 #include <sstream>
-#ifdef APEX_HAVE_ZLIB
-#include "gzstream.hpp"
-#else
-#include <fstream>
-#endif
+#include <thread>
 #include <map>
 #include <atomic>
-#include <map>
+#include <unordered_map>
+#include <vector>
 
 namespace apex {
 
@@ -30,6 +30,14 @@ public:
   	~trace_event_listener (void);
   	static bool initialize_tau(int argc, char** avgv);
   	inline static bool initialized(void) { return _initialized; }
+  	listener_mask subscriptions(void) const {
+  	    return APEX_LISTEN(LISTEN_STARTUP) |
+  	        APEX_LISTEN(LISTEN_PRE_SHUTDOWN) |
+  	        APEX_LISTEN(LISTEN_SHUTDOWN) | APEX_LISTEN(LISTEN_DUMP) |
+  	        APEX_LISTEN(LISTEN_START) | APEX_LISTEN(LISTEN_STOP) |
+  	        APEX_LISTEN(LISTEN_YIELD) | APEX_LISTEN(LISTEN_RESUME) |
+  	        APEX_LISTEN(LISTEN_SAMPLE_VALUE);
+  	}
   	void on_startup(startup_event_data &data);
   	void on_dump(dump_event_data &data);
   	void on_reset(task_identifier * id)
@@ -61,7 +69,6 @@ public:
 private:
   	void _init(void);
   	bool _terminate;
-    static void flush_trace(trace_event_listener* listener);
     void close_trace(void);
     void flush_trace_if_necessary(bool force = false);
   	void _common_start(std::shared_ptr<task_wrapper> &tt_ptr);
@@ -74,15 +81,49 @@ private:
     std::mutex * get_thread_mutex(size_t index);
     std::stringstream * get_thread_stream(size_t index);
     void write_to_trace(std::stringstream& events);
+    /* The binary event log, when APEX_TRACE_EVENT_BINARY is set */
+    bool _binary;
+    binary_trace::buffer& get_binary_buffer(void);
+    binary_trace::buffer* make_binary_buffer(void);
+    uint32_t string_id(binary_trace::buffer& b, const std::string& s);
+    uint32_t task_name_id(binary_trace::buffer& b, task_identifier * id);
+    void binary_thread_metadata(uint64_t tid, const std::string& name,
+        uint64_t sort_index);
+    void binary_start(std::shared_ptr<task_wrapper> &tt_ptr, uint64_t tid);
+    void binary_stop(std::shared_ptr<profiler> &p, uint64_t tid);
+    void binary_flow(binary_trace::buffer& b, binary_trace::kind k,
+        double ts, uint32_t cat, uint64_t id, uint64_t tid,
+        uint32_t parent_name, uint32_t child_name);
+    std::vector<binary_trace::buffer*> binary_buffers;
+    std::mutex _string_mutex;
+    std::unordered_map<std::string, uint32_t> string_ids;
+    uint32_t _cat_cpu;
+    uint32_t _cat_gpu;
+    uint32_t _cat_flow;
     int saved_node_id;
     uint64_t reversed_node_id;
-    std::atomic<size_t> num_events;
-    std::string get_file_name();
-#ifdef APEX_HAVE_ZLIB
-  	io::gzofstream& get_trace_file();
-#else
-  	std::ofstream& get_trace_file();
-#endif
+    /* One persistent thread drains the buffers into the file writer,
+     * when enough data is buffered, at a dump, or once a second. */
+    void start_flusher(void);
+    void stop_flusher(void);
+    void flusher_loop(void);
+    void request_flush(void);
+    void flush_buffers(void);
+    trace_file_writer * make_writer(void);
+    std::string binary_header(void);
+    std::string json_footer(double ts);
+    trace_file_writer * _writer;
+    std::thread _flusher;
+    std::mutex _flush_mutex;
+    std::condition_variable _flush_cv;
+    std::condition_variable _space_cv;
+    bool _flush_requested;
+    bool _flusher_running;
+    bool _flusher_stop;
+    std::atomic<bool> _flush_pending;
+    /* bytes of trace data waiting in the buffers */
+    std::atomic<size_t> _buffered_bytes;
+    size_t _buffer_limit;
   	std::stringstream* trace;
     std::map<size_t, std::mutex*> mutexes;
     std::map<size_t, std::stringstream*> streams;
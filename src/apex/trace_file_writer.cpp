@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "trace_file_writer.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#ifdef APEX_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace apex {
+
+trace_file_writer::trace_file_writer(const std::string& prefix,
+    const std::string& suffix, bool compress, uint32_t threads,
+    size_t max_buffered, size_t max_file_size, size_t max_files,
+    section_function header, section_function footer) :
+    _prefix(prefix), _suffix(suffix), _compress(compress),
+    _max_buffered(max_buffered), _max_file_size(max_file_size),
+    _max_files(max_files), _header(header), _footer(footer),
+    _pool(threads > 0 ? threads : 1), _next_seq(0), _write_seq(0),
+    _buffered(0), _writing(false), _closed(false), _open_failed(false),
+    _file(nullptr), _file_index(0), _file_bytes(0), _header_bytes(0) {
+    _pool.Start();
+}
+
+trace_file_writer::~trace_file_writer(void) {
+    close("");
+}
+
+std::string trace_file_writer::file_name(size_t index) {
+    if (_max_file_size == 0) {
+        return _prefix + _suffix;
+    }
+    return _prefix + "." + std::to_string(index) + _suffix;
+}
+
+void trace_file_writer::write(std::string&& chunk) {
+    if (chunk.size() == 0) { return; }
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_closed) { return; }
+    // wait for the earlier chunks to be written, if there are too many
+    _cv.wait(lock, [this, &chunk]{
+        return _buffered == 0 || _buffered + chunk.size() <= _max_buffered;
+    });
+    uint64_t seq = _next_seq++;
+    _buffered += chunk.size();
+    lock.unlock();
+    std::string * data = new std::string(std::move(chunk));
+    _pool.QueueJob([this, seq, data](){ compress_job(seq, data); });
+}
+
+void trace_file_writer::compress_job(uint64_t seq, std::string * chunk) {
+    // don't track memory in the pool threads
+    in_apex prevent_memory_tracking;
+    result r;
+    r.raw_size = chunk->size();
+    if (_compress) {
+        r.data = compress(*chunk);
+    } else {
+        r.data = std::move(*chunk);
+    }
+    delete chunk;
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.insert(std::pair<uint64_t, result>(seq, std::move(r)));
+    write_results(lock);
+}
+
+/* Write the finished chunks, in order.  Only one thread writes at a time,
+ * the others leave their results for it. */
+void trace_file_writer::write_results(std::unique_lock<std::mutex>& lock) {
+    if (_writing) { return; }
+    _writing = true;
+    auto it = _done.find(_write_seq);
+    while (it != _done.end()) {
+        result r(std::move(it->second));
+        _done.erase(it);
+        lock.unlock();
+        write_to_file(r.data);
+        lock.lock();
+        _write_seq++;
+        _buffered -= r.raw_size;
+        _cv.notify_all();
+        it = _done.find(_write_seq);
+    }
+    _writing = false;
+}
+
+void trace_file_writer::write_to_file(const std::string& data) {
+    if (_file == nullptr) {
+        open_file();
+    } else if (_max_file_size > 0 && _file_bytes > _header_bytes &&
+        _file_bytes + data.size() > _max_file_size) {
+        // rotate
+        std::string footer(_compress ? compress(_footer()) : _footer());
+        fwrite(footer.data(), 1, footer.size(), _file);
+        fclose(_file);
+        _file = nullptr;
+        _file_index++;
+        open_file();
+    }
+    if (_file != nullptr) {
+        fwrite(data.data(), 1, data.size(), _file);
+        _file_bytes += data.size();
+    }
+}
+
+void trace_file_writer::open_file(void) {
+    if (_open_failed) { return; }
+    // keep only the most recent files
+    if (_max_file_size > 0 && _max_files > 0 && _file_index >= _max_files) {
+        std::remove(file_name(_file_index - _max_files).c_str());
+    }
+    std::string name(file_name(_file_index));
+    _file = fopen(name.c_str(), "wb");
+    if (_file == nullptr) {
+        std::cerr << "APEX: Unable to open trace file " << name << ": "
+                  << strerror(errno) << std::endl;
+        _open_failed = true;
+        return;
+    }
+    std::string header(_compress ? compress(_header()) : _header());
+    fwrite(header.data(), 1, header.size(), _file);
+    _file_bytes = _header_bytes = header.size();
+}
+
+void trace_file_writer::close(const std::string& last) {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_closed) { return; }
+    }
+    write(std::string(last));
+    std::unique_lock<std::mutex> lock(_mutex);
+    _closed = true;
+    _cv.wait(lock, [this]{ return _write_seq == _next_seq; });
+    // nothing is being written now
+    if (_file == nullptr) {
+        open_file();
+    }
+    if (_file != nullptr) {
+        fclose(_file);
+        _file = nullptr;
+    }
+    lock.unlock();
+    _pool.Stop();
+}
+
+/* Compress the data as one complete gzip member. */
+std::string trace_file_writer::compress(const std::string& data) {
+#ifdef APEX_HAVE_ZLIB
+    z_stream zs;
+    memset(&zs, 0, sizeof(z_stream));
+    // 15 + 16: a 32k window, with a gzip header and trailer
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+        std::cerr << "APEX: Unable to compress the trace" << std::endl;
+        return std::string();
+    }
+    std::string out(deflateBound(&zs, (uLong)data.size()), '\0');
+    // zlib counts in 32 bits, so feed it at most 1GB at a time
+    const size_t step = (size_t)1 << 30;
+    size_t in_pos = 0;
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        size_t n = std::min(data.size() - in_pos, step);
+        size_t out_pos = (size_t)zs.total_out;
+        zs.next_in = (Bytef*)(data.data() + in_pos);
+        zs.avail_in = (uInt)n;
+        zs.next_out = (Bytef*)(&out[0] + out_pos);
+        zs.avail_out = (uInt)std::min(out.size() - out_pos, step);
+        ret = deflate(&zs, in_pos + n == data.size() ? Z_FINISH : Z_NO_FLUSH);
+        in_pos += n - zs.avail_in;
+    }
+    if (ret != Z_STREAM_END) {
+        std::cerr << "APEX: Unable to compress the trace" << std::endl;
+    }
+    out.resize((size_t)zs.total_out);
+    deflateEnd(&zs);
+    return out;
+#else
+    return data;
+#endif
+}
+
+} // namespace apex
+
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include "threadpool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace apex {
+
+/* Writes a trace as a sequence of chunks.  Each chunk is compressed on a
+ * pool of threads as an independent gzip member (concatenated members are
+ * a valid gzip file), and the members are written in order.
+ *
+ * write() blocks while more than max_buffered bytes are waiting to be
+ * compressed and written, so a slow filesystem slows the tracing down
+ * instead of exhausting memory.  When max_file_size is set, the output
+ * is rotated: every file gets the header and footer sections, and only
+ * the last max_files files are kept.  Chunks are never split across
+ * files, so a chunk should end on a record boundary. */
+class trace_file_writer {
+public:
+    typedef std::function<std::string(void)> section_function;
+    trace_file_writer(const std::string& prefix, const std::string& suffix,
+        bool compress, uint32_t threads, size_t max_buffered,
+        size_t max_file_size, size_t max_files,
+        section_function header, section_function footer);
+    ~trace_file_writer(void);
+    /* Disable the copy and assign methods. */
+    trace_file_writer(trace_file_writer const&) = delete;
+    void operator=(trace_file_writer const&) = delete;
+    void write(std::string&& chunk);
+    /* Write the last chunk (instead of the footer), wait for everything
+     * to be written, and close the file. */
+    void close(const std::string& last);
+private:
+    struct result {
+        std::string data;
+        size_t raw_size;
+    };
+    void compress_job(uint64_t seq, std::string * chunk);
+    std::string compress(const std::string& data);
+    void write_results(std::unique_lock<std::mutex>& lock);
+    void write_to_file(const std::string& data);
+    void open_file(void);
+    std::string file_name(size_t index);
+    const std::string _prefix;
+    const std::string _suffix;
+    const bool _compress;
+    const size_t _max_buffered;
+    const size_t _max_file_size;
+    const size_t _max_files;
+    section_function _header;
+    section_function _footer;
+    treemerge::ThreadPool _pool;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::map<uint64_t, result> _done;
+    uint64_t _next_seq;    // the next chunk to be submitted
+    uint64_t _write_seq;   // the next chunk to be written
+    size_t _buffered;      // bytes submitted, but not written yet
+    bool _writing;         // one thread at a time writes the results
+    bool _closed;
+    bool _open_failed;
+    FILE * _file;
+    size_t _file_index;
+    size_t _file_bytes;
+    size_t _header_bytes;
+};
+
+} // namespace apex
+
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#include "tuning_database.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+namespace apex {
+
+namespace {
+
+const char * header = "# APEX tuning database, version 1";
+
+/* Fields are separated by tabs, so escape the tabs, newlines and
+   backslashes in the names and values. */
+std::string escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size());
+    for (char c : in) {
+        switch (c) {
+            case '\t': out.append("\\t"); break;
+            case '\n': out.append("\\n"); break;
+            case '\\': out.append("\\\\"); break;
+            default: out.push_back(c); break;
+        }
+    }
+    return out;
+}
+
+std::vector<std::string> split(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string field;
+    for (size_t i = 0 ; i < line.size() ; i++) {
+        char c = line[i];
+        if (c == '\t') {
+            fields.push_back(field);
+            field.clear();
+        } else if (c == '\\' && i + 1 < line.size()) {
+            c = line[++i];
+            field.push_back(c == 't' ? '\t' : (c == 'n' ? '\n' : c));
+        } else {
+            field.push_back(c);
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+/* How different are two inputs?  Numeric values are compared relative to
+   their size, anything else either matches or it doesn't. */
+double distance(const tuning_database::input& a,
+    const tuning_database::input& b) {
+    if (a.is_numeric && b.is_numeric) {
+        double scale = std::max(std::max(std::fabs(a.number),
+            std::fabs(b.number)), std::numeric_limits<double>::min());
+        return std::fabs(a.number - b.number) / scale;
+    }
+    return (a.value == b.value) ? 0.0 : 1.0;
+}
+
+}
+
+/* The region, and the names of its inputs - only contexts with the same
+   signature are neighbors. */
+std::string tuning_database::context::signature(void) const {
+    std::string s(region);
+    for (auto& i : inputs) {
+        s.push_back('\x1f');
+        s.append(i.name);
+    }
+    return s;
+}
+
+std::string tuning_database::context::key(void) const {
+    std::string s(signature());
+    for (auto& i : inputs) {
+        s.push_back('\x1e');
+        s.append(i.value);
+    }
+    return s;
+}
+
+tuning_database::tuning_database(const std::string& _filename) :
+    filename(_filename), fingerprint(machine_fingerprint()),
+    foreign(false) { }
+
+tuning_database::tuning_database(const std::string& _filename,
+    const std::string& _fingerprint) :
+    filename(_filename), fingerprint(_fingerprint), foreign(false) { }
+
+std::string tuning_database::machine_fingerprint(void) {
+    std::string model("unknown");
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                model = line.substr(line.find_first_not_of(" \t",
+                    colon + 1));
+            }
+            break;
+        }
+    }
+    std::stringstream ss;
+    ss << model << " x" << std::thread::hardware_concurrency();
+    return ss.str();
+}
+
+void tuning_database::insert(record&& r) {
+    std::string key(r.fingerprint + '\x1d' + r.ctx.key());
+    auto existing = records.find(key);
+    if (existing == records.end()) {
+        by_signature[r.fingerprint + '\x1d' + r.ctx.signature()].
+            push_back(key);
+        records.insert(std::make_pair(key, std::move(r)));
+    } else if (replaces(r, existing->second)) {
+        existing->second = std::move(r);
+    }
+}
+
+bool tuning_database::parse(const std::string& line, record& r) {
+    std::vector<std::string> fields(split(line));
+    if (fields.size() < 6) { return false; }
+    size_t f = 0;
+    r.fingerprint = fields[f++];
+    r.ctx.region = fields[f++];
+    r.converged = (fields[f++] == "1");
+    r.timestamp = strtoull(fields[f++].c_str(), nullptr, 10);
+    size_t num_inputs = strtoul(fields[f++].c_str(), nullptr, 10);
+    if (fields.size() < f + (num_inputs * 3) + 1) { return false; }
+    for (size_t i = 0 ; i < num_inputs ; i++, f += 3) {
+        if (fields[f+2].empty()) {
+            r.ctx.inputs.emplace_back(fields[f], fields[f+1]);
+        } else {
+            r.ctx.inputs.emplace_back(fields[f], fields[f+1],
+                strtod(fields[f+2].c_str(), nullptr));
+        }
+    }
+    size_t num_outputs = strtoul(fields[f++].c_str(), nullptr, 10);
+    if (fields.size() < f + (num_outputs * 2)) { return false; }
+    for (size_t i = 0 ; i < num_outputs ; i++, f += 2) {
+        r.outputs[fields[f]] = fields[f+1];
+    }
+    return true;
+}
+
+std::string tuning_database::format(const record& r) {
+    std::stringstream ss;
+    ss.precision(17);
+    ss << escape(r.fingerprint) << '\t' << escape(r.ctx.region) << '\t'
+       << (r.converged ? 1 : 0) << '\t' << r.timestamp << '\t'
+       << r.ctx.inputs.size();
+    for (auto& i : r.ctx.inputs) {
+        ss << '\t' << escape(i.name) << '\t' << escape(i.value) << '\t';
+        if (i.is_numeric) { ss << i.number; }
+    }
+    ss << '\t' << r.outputs.size();
+    for (auto& o : r.outputs) {
+        ss << '\t' << escape(o.first) << '\t' << escape(o.second);
+    }
+    return ss.str();
+}
+
+bool tuning_database::read(void) {
+    std::ifstream in(filename);
+    if (!in.good()) { return false; }
+    std::string line;
+    size_t lineno = 0;
+    while (std::getline(in, line)) {
+        lineno++;
+        /* Don't parse (and later replace) some other file, like the YAML
+         * cache of older versions. */
+        if (lineno == 1 && line != header) {
+            if (!foreign) {
+                std::cerr << "APEX: " << filename << " is not an APEX "
+                          << "tuning database, so it won't be read or "
+                          << "written." << std::endl;
+            }
+            foreign = true;
+            return false;
+        }
+        if (line.empty() || line[0] == '#') { continue; }
+        record r;
+        if (!parse(line, r)) {
+            std::cerr << "APEX: Ignoring malformed line " << lineno
+                      << " of tuning database " << filename << std::endl;
+            continue;
+        }
+        insert(std::move(r));
+    }
+    return true;
+}
+
+const tuning_database::record* tuning_database::find(const context& ctx) const {
+    auto r = records.find(fingerprint + '\x1d' + ctx.key());
+    if (r == records.end()) { return nullptr; }
+    return &(r->second);
+}
+
+const tuning_database::record* tuning_database::nearest(
+    const context& ctx) const {
+    auto keys = by_signature.find(fingerprint + '\x1d' + ctx.signature());
+    if (keys == by_signature.end()) { return nullptr; }
+    const record* best = nullptr;
+    double best_distance = std::numeric_limits<double>::max();
+    for (auto& key : keys->second) {
+        const record& r = records.find(key)->second;
+        double d = 0.0;
+        for (size_t i = 0 ; i < ctx.inputs.size() ; i++) {
+            d += distance(ctx.inputs[i], r.ctx.inputs[i]);
+        }
+        if (best == nullptr || (r.converged && !best->converged) ||
+            (r.converged == best->converged && d < best_distance)) {
+            best = &r;
+            best_distance = d;
+        }
+    }
+    return best;
+}
+
+void tuning_database::update(const context& ctx,
+    const std::map<std::string, std::string>& outputs, bool converged) {
+    record r;
+    r.fingerprint = fingerprint;
+    r.ctx = ctx;
+    r.outputs = outputs;
+    r.converged = converged;
+    r.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string key(fingerprint + '\x1d' + ctx.key());
+    // ours is the newest, so it wins unless we lose a converged result
+    auto existing = records.find(key);
+    if (existing != records.end() && !replaces(r, existing->second)) {
+        return;
+    }
+    updated.push_back(key);
+    insert(std::move(r));
+}
+
+bool tuning_database::write(void) {
+    if (updated.empty()) { return true; }
+    /* Hold the lock while merging, so that concurrent jobs take turns. */
+    std::string lockname(filename + ".lock");
+    int fd = open(lockname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        std::cerr << "APEX: Unable to lock tuning database " << lockname
+                  << std::endl;
+        if (fd >= 0) { close(fd); }
+        return false;
+    }
+    // re-read the file, in case other jobs updated it since we read it.
+    std::vector<record> ours;
+    for (auto& key : updated) {
+        auto r = records.find(key);
+        if (r != records.end()) { ours.push_back(r->second); }
+    }
+    records.clear();
+    by_signature.clear();
+    read();
+    if (foreign) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return false;
+    }
+    for (auto& r : ours) { insert(std::move(r)); }
+    // sort the results, so the file doesn't change for no reason
+    std::vector<std::string> lines;
+    lines.reserve(records.size());
+    for (auto& r : records) { lines.push_back(format(r.second)); }
+    std::sort(lines.begin(), lines.end());
+    char host[256] = {0};
+    gethostname(host, sizeof(host) - 1);
+    std::stringstream tmpname;
+    tmpname << filename << ".tmp." << host << "." << getpid();
+    std::ofstream out(tmpname.str(), std::ios::out | std::ios::trunc);
+    out << header << std::endl;
+    for (auto& line : lines) { out << line << std::endl; }
+    out.close();
+    bool success = !out.fail();
+    // the rename is atomic, so readers see the old file or the new one.
+    if (!success || std::rename(tmpname.str().c_str(),
+        filename.c_str()) != 0) {
+        std::cerr << "APEX: Unable to write tuning database " << filename
+                  << std::endl;
+        std::remove(tmpname.str().c_str());
+        success = false;
+    } else {
+        updated.clear();
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return success;
+}
+
+}
+
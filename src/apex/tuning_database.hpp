@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+
+namespace apex {
+
+/* A database of tuning results that is shared between runs, and between
+ * the ranks of a run.  Each result is keyed by the machine it was tuned on,
+ * the region that was tuned, and the values of the region's input
+ * variables.  A run can reuse the converged results of a previous run
+ * directly, and start its searches from the nearest context that has been
+ * tuned before.
+ *
+ * The database is one text file, with one result per line.  Writers lock
+ * it, merge their results with the ones that are already there, and
+ * rename the merged file into place - so concurrent jobs don't lose each
+ * other's results, and readers never see a partial file. */
+class tuning_database {
+public:
+    /* One input variable of a tuned context.  The value is what has to
+     * match exactly (numeric values can be binned by the caller), and
+     * the number is used to find the nearest context. */
+    class input {
+    public:
+        std::string name;
+        std::string value;
+        double number;
+        bool is_numeric;
+        input(const std::string& _name, const std::string& _value) :
+            name(_name), value(_value), number(0.0), is_numeric(false) {}
+        input(const std::string& _name, const std::string& _value,
+            double _number) : name(_name), value(_value), number(_number),
+            is_numeric(true) {}
+    };
+    class context {
+    public:
+        std::string region;
+        std::vector<input> inputs; // sorted by name
+        std::string signature(void) const;
+        std::string key(void) const;
+    };
+    class record {
+    public:
+        std::string fingerprint;
+        context ctx;
+        std::map<std::string, std::string> outputs;
+        bool converged;
+        uint64_t timestamp;
+        record() : converged(false), timestamp(0) {}
+    };
+    tuning_database(const std::string& filename);
+    tuning_database(const std::string& filename,
+        const std::string& fingerprint);
+    /* Read the database, if it exists.  A file that isn't a database is
+     * left alone: it isn't read, and write() won't replace it. */
+    bool read(void);
+    /* The result for exactly this context, or nullptr */
+    const record* find(const context& ctx) const;
+    /* The result for the closest context of the same region and inputs,
+     * or nullptr.  Converged results are preferred. */
+    const record* nearest(const context& ctx) const;
+    /* Add or replace the result for a context on this machine */
+    void update(const context& ctx,
+        const std::map<std::string, std::string>& outputs, bool converged);
+    /* Merge our updates into the file on disk */
+    bool write(void);
+    size_t size(void) const { return records.size(); }
+    const std::string& get_fingerprint(void) const { return fingerprint; }
+    /* The processor model and number of hardware threads */
+    static std::string machine_fingerprint(void);
+private:
+    std::string filename;
+    std::string fingerprint;
+    // the results, by fingerprint and key
+    std::unordered_map<std::string, record> records;
+    // the keys of the results, by fingerprint and context signature
+    std::unordered_map<std::string, std::vector<std::string>> by_signature;
+    // the keys of the results that we have added or changed
+    std::vector<std::string> updated;
+    // the file is something else, so don't touch it
+    bool foreign;
+    void insert(record&& r);
+    static bool parse(const std::string& line, record& r);
+    static std::string format(const record& r);
+    /* Should a result replace the other result for its context? */
+    static bool replaces(const record& r, const record& other) {
+        if (r.converged != other.converged) { return r.converged; }
+        return r.timestamp >= other.timestamp;
+    }
+};
+
+}
+
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include "apex_types.h"
+
+namespace apex {
+
+/* The number of samples, mean and variance of a candidate's costs */
+class sample_summary {
+public:
+    double n;
+    double mean;
+    double variance;
+    sample_summary() : n(0.0), mean(0.0), variance(0.0) {}
+    sample_summary(const apex_profile& p) : n(p.calls), mean(0.0),
+        variance(0.0) {
+        if (n > 0.0) { mean = p.accumulated / n; }
+        if (n > 1.0) {
+            variance = std::max(0.0,
+                (p.sum_squares - (n * mean * mean)) / (n - 1.0));
+        }
+    }
+    /* The variance of the mean */
+    double error(void) const { return n > 0.0 ? variance / n : 0.0; }
+};
+
+/* Decides how many samples each candidate of a tuning search gets.
+ * With a confidence level of zero, every candidate gets the minimum
+ * number of samples.  Otherwise each candidate is compared to the best
+ * candidate so far with Welch's t-test, and it is sampled until it is
+ * significantly better or worse, until the two are equivalent (the
+ * confidence interval of the difference is within a tolerance of the
+ * best mean), or until the maximum number of samples.  Candidates that
+ * are clearly worse are dropped after a few samples, and close ones get
+ * enough samples that the search doesn't pick a winner by chance. */
+class tuning_window {
+private:
+    double min_samples;
+    double max_samples;
+    double confidence;
+    double tolerance;
+    bool have_best;
+    sample_summary best;
+public:
+    tuning_window(int _min_samples, int _max_samples, double _confidence,
+        double _tolerance = 0.02) :
+        min_samples(std::max(_min_samples, 1)),
+        max_samples(std::max(_max_samples, _min_samples)),
+        confidence(_confidence), tolerance(_tolerance), have_best(false) {}
+    bool adaptive(void) const { return confidence > 0.0; }
+    /* Do we have enough samples of the current candidate? */
+    bool ready(const apex_profile& p) const {
+        if (p.calls < min_samples) { return false; }
+        if (!adaptive() || p.calls >= max_samples) { return true; }
+        sample_summary current(p);
+        if (current.n < 2.0) { return false; }
+        if (!have_best) {
+            // the first candidate is the baseline, so measure it precisely
+            double width = t_quantile(confidence, current.n - 1.0) *
+                std::sqrt(current.error());
+            return width <= tolerance * current.mean;
+        }
+        double se2 = current.error() + best.error();
+        if (se2 <= 0.0) { return true; }
+        double se = std::sqrt(se2);
+        double t = t_quantile(confidence, welch_df(current, best));
+        // significantly different?
+        if (std::fabs(current.mean - best.mean) > t * se) { return true; }
+        // or close enough that it doesn't matter?
+        return t * se <= tolerance * best.mean;
+    }
+    /* The strategy evaluated the current candidate, keep the best one */
+    void evaluated(const apex_profile& p) {
+        sample_summary current(p);
+        if (!have_best || current.mean < best.mean) {
+            best = current;
+            have_best = true;
+        }
+    }
+    /* The degrees of freedom of Welch's t-test */
+    static double welch_df(const sample_summary& a, const sample_summary& b) {
+        double ea = a.error();
+        double eb = b.error();
+        double denominator = 0.0;
+        if (a.n > 1.0) { denominator += (ea * ea) / (a.n - 1.0); }
+        if (b.n > 1.0) { denominator += (eb * eb) / (b.n - 1.0); }
+        if (denominator <= 0.0) { return std::max(a.n + b.n - 2.0, 1.0); }
+        return std::max(((ea + eb) * (ea + eb)) / denominator, 1.0);
+    }
+    /* The quantile of the standard normal distribution (Acklam's
+     * approximation, relative error below 1.2e-9) */
+    static double z_quantile(double p) {
+        static const double a[] = {-3.969683028665376e+01,
+            2.209460984245205e+02, -2.759285104469687e+02,
+            1.383577518672690e+02, -3.066479806614716e+01,
+            2.506628277459239e+00};
+        static const double b[] = {-5.447609879822406e+01,
+            1.615858368580409e+02, -1.556989798598866e+02,
+            6.680131188771972e+01, -1.328068155288572e+01};
+        static const double c[] = {-7.784894002430293e-03,
+            -3.223964580411365e-01, -2.400758277161838e+00,
+            -2.549732539343734e+00, 4.374664141464968e+00,
+            2.938163982698783e+00};
+        static const double d[] = {7.784695709041462e-03,
+            3.224671290700398e-01, 2.445134137142996e+00,
+            3.754408661907416e+00};
+        const double low = 0.02425;
+        if (p <= 0.0) { return -INFINITY; }
+        if (p >= 1.0) { return INFINITY; }
+        if (p < low) {
+            double q = std::sqrt(-2.0 * std::log(p));
+            return (((((c[0]*q+c[1])*q+c[2])*q+c[3])*q+c[4])*q+c[5]) /
+                ((((d[0]*q+d[1])*q+d[2])*q+d[3])*q+1.0);
+        }
+        if (p > 1.0 - low) {
+            return -z_quantile(1.0 - p);
+        }
+        double q = p - 0.5;
+        double r = q * q;
+        return (((((a[0]*r+a[1])*r+a[2])*r+a[3])*r+a[4])*r+a[5])*q /
+            (((((b[0]*r+b[1])*r+b[2])*r+b[3])*r+b[4])*r+1.0);
+    }
+    /* The two-sided critical value of Student's t distribution, from the
+     * normal one with the Cornish-Fisher expansion */
+    static double t_quantile(double confidence, double df) {
+        double z = z_quantile(0.5 + (confidence / 2.0));
+        double z3 = z * z * z;
+        double z5 = z3 * z * z;
+        return z + ((z3 + z) / (4.0 * df)) +
+            ((5.0 * z5 + 16.0 * z3 + 3.0 * z) / (96.0 * df * df));
+    }
+};
+
+}
+
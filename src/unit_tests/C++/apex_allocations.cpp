@@ -0,0 +1,73 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "apex_api.hpp"
+
+/* Count the calls to the global allocator, so we can see how many
+ * allocations each start/stop pair costs. */
+std::atomic<size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations++;
+    void * p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr) { throw std::bad_alloc(); }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    free(p);
+}
+
+const size_t iterations = 100000;
+
+void timers(const std::string& name) {
+    for (size_t i = 0 ; i < iterations ; i++) {
+        apex::profiler* p = apex::start(name);
+        apex::stop(p);
+    }
+}
+
+void tasks(const std::string& name) {
+    for (size_t i = 0 ; i < iterations ; i++) {
+        auto task = apex::new_task(name);
+        apex::start(task);
+        apex::stop(task);
+    }
+}
+
+void report(const char * label, size_t before) {
+    size_t after = allocations;
+    std::cout << label << ": " << (double)(after - before) / iterations
+              << " allocations per start/stop" << std::endl;
+}
+
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex allocations unit test", 0, 1);
+    apex::profiler* p = apex::start("main");
+    std::string timer_name("timer");
+    std::string task_name("task");
+    /* warm up, so the timers and the pools exist */
+    apex::stop(apex::start(timer_name));
+    auto task = apex::new_task(task_name);
+    apex::start(task);
+    apex::stop(task);
+    size_t before = allocations;
+    timers(timer_name);
+    report("profiler", before);
+    before = allocations;
+    tasks(task_name);
+    report("task_wrapper", before);
+    apex::stop(p);
+    apex::finalize();
+    apex::cleanup();
+    return 0;
+}
+
@@ -0,0 +1,41 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "apex_api.hpp"
+#include "apex_clock.hpp"
+
+/* Report the cost of reading the clock, for each clock source. */
+
+const size_t iterations = 10000000;
+
+void measure(const char * label) {
+    uint64_t check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0 ; i < iterations ; i++) {
+        check += apex::our_clock::now_ns();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << label << ": " << ns / iterations << " ns per call"
+              << (check == 0 ? "!" : "") << std::endl;
+}
+
+int main (int argc, char** argv) {
+    APEX_UNUSED(argc);
+    APEX_UNUSED(argv);
+    apex::init("apex clock overhead unit test", 0, 1);
+    if (apex::our_clock::set_source("chrono", false)) {
+        measure("chrono");
+    }
+    if (apex::our_clock::set_source("tsc", false)) {
+        uint64_t tsc = apex::our_clock::now_ns();
+        uint64_t chrono = apex::our_clock::chrono_now_ns();
+        measure("tsc");
+        std::cout << "tsc - chrono: " << (int64_t)(tsc - chrono)
+                  << " ns" << std::endl;
+    }
+    apex::finalize();
+    apex::cleanup();
+    return 0;
+}
+
@@ -0,0 +1,56 @@
+#include "apex_api.hpp"
+#include "event_filter.hpp"
+#include <string>
+#include <iostream>
+
+using namespace apex;
+using namespace std;
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  /* The filter file is set by the test environment, because APEX reads
+   * it at startup:
+   * exclude: "^MPI_", "(foo)\\1" and "[bad" (an error, which is skipped)
+   * include: "solve", "MPI_" and "foo" */
+  init("apex_event_filter unit test", 0, 1);
+  int failed = 0;
+  if (!event_filter::instance().have_filter) {
+    cout << "Test failed: no filter read." << endl;
+    failed++;
+  }
+  if (!event_filter::exclude("MPI_Send") ||
+      !event_filter::exclude("foofoo") ||
+      !event_filter::exclude("main")) {
+    cout << "Test failed: event not excluded." << endl;
+    failed++;
+  }
+  if (event_filter::exclude("linear_solve") ||
+      event_filter::exclude("the MPI_Send")) {
+    cout << "Test failed: event not included." << endl;
+    failed++;
+  }
+  // the decision is remembered
+  if (!event_filter::exclude("MPI_Send") ||
+      event_filter::exclude("linear_solve")) {
+    cout << "Test failed: cached decision changed." << endl;
+    failed++;
+  }
+  profiler * p = start("MPI_Recv");
+  if (p != profiler::get_disabled_profiler()) {
+    cout << "Test failed: excluded event measured." << endl;
+    failed++;
+  }
+  p = start("linear_solve");
+  if (p == nullptr || p == profiler::get_disabled_profiler()) {
+    cout << "Test failed: included event not measured." << endl;
+    failed++;
+  }
+  stop(p);
+  finalize();
+  if (failed == 0) {
+    cout << "Test passed." << endl;
+  }
+  cleanup();
+  return failed;
+}
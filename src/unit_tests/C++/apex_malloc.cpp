@@ -1,5 +1,9 @@
 #include <stdlib.h>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
 #include "apex_api.hpp"
 
 void bar(char* data) {
@@ -53,6 +57,52 @@ void test_all(void) {
   test_leak();
 }
 
+/* Check the last heap snapshot for a site that is still live */
+int check_heap_snapshot(size_t live_bytes) {
+  bool pprof{std::string(apex::apex_options::heap_snapshot_format()) == "pprof"};
+  std::string last;
+  for (size_t i = 0 ; ; i++) {
+    std::stringstream name;
+    name << apex::apex_options::output_file_path() << "/heap_snapshot.0."
+         << i << (pprof ? ".heap" : ".folded");
+    if (!std::ifstream(name.str()).good()) { break; }
+    last = name.str();
+  }
+  if (last.empty()) {
+    std::cout << "Test failed: no heap snapshot written." << std::endl;
+    return 1;
+  }
+  std::ifstream snapshot(last);
+  std::string line;
+  std::stringstream site;
+  if (pprof) {
+    long long totals[4];
+    std::getline(snapshot, line);
+    if (sscanf(line.c_str(), "heap profile: %lld: %lld [%lld: %lld] @ heap",
+        &totals[0], &totals[1], &totals[2], &totals[3]) != 4 ||
+        totals[1] < (long long)(live_bytes)) {
+      std::cout << "Test failed: bad heap profile header: " << line << std::endl;
+      return 1;
+    }
+    // every allocation's stack is captured, so the count is exact
+    site << "1: " << live_bytes << " [1: " << live_bytes << "] @ ";
+  } else {
+    site << "malloc " << live_bytes;
+  }
+  bool found{false};
+  while (std::getline(snapshot, line)) {
+    if (pprof && line.rfind(site.str(), 0) == 0) { found = true; }
+    if (!pprof && line.size() > site.str().size() &&
+        line.compare(line.size() - site.str().size(), std::string::npos,
+        site.str()) == 0) { found = true; }
+  }
+  if (!found) {
+    std::cout << "Test failed: live allocation not in " << last << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 void apex_enable_memory_wrapper(void);
 void apex_disable_memory_wrapper(void);
 
@@ -65,9 +115,38 @@ int main (int argc, char** argv) {
   test_all();
   apex::enable_memory_wrapper();
   test_all();
+  // still live when the last heap snapshot is written
+  const size_t live_bytes{4242};
+  char * live = (char*)(malloc(live_bytes));
   apex::disable_memory_wrapper();
   apex::finalize();
+  // the leak is reported, with the call stack that leads to it
+  std::ifstream report("memory_report.0.txt");
+  std::string line;
+  bool leaked{false};
+  size_t frames{0};
+  while (std::getline(report, line) && frames == 0) {
+    if (line.rfind("42 bytes leaked", 0) == 0 &&
+        line.find("with backtrace") != std::string::npos) {
+      leaked = true;
+      // the allocator, then the frames
+      std::getline(report, line);
+      while (std::getline(report, line) && line.rfind("\t", 0) == 0) {
+        frames++;
+      }
+    }
+  }
+  if (apex::apex_options::heap_snapshot_period() > 0 &&
+      check_heap_snapshot(live_bytes) != 0) {
+    return 1;
+  }
+  free(live);
   apex::cleanup();
+  if (!leaked || frames == 0) {
+    std::cout << "Test failed: leak not reported with its backtrace." << std::endl;
+    return 1;
+  }
+  std::cout << "Test passed." << std::endl;
   return 0;
 }
 
@@ -0,0 +1,61 @@
+#include "apex_api.hpp"
+#include <pthread.h>
+#include <unistd.h>
+#include <iostream>
+
+using namespace apex;
+using namespace std;
+
+apex_counter_handle total;
+
+void* someThread(void* tmp)
+{
+  int* tid = (int*)tmp;
+  char name[32];
+  snprintf(name, 32, "worker-thread#%d", *tid);
+  register_thread(name);
+  char counter[64];
+  snprintf(counter, 64, "/threadqueue{locality#0/%s}/length", name);
+  apex_counter_handle mine = register_counter(counter);
+  profiler* p = start((apex_function_address)someThread);
+  for (int i = 0 ; i < 10 ; i++) {
+    sample_value(total, 2.0);
+    sample_value(mine, (double)i);
+  }
+  stop(p);
+  exit_thread();
+  return NULL;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  init("apex::register_counter unit test", 0, 1);
+  cout << "APEX Version : " << version() << endl;
+  total = register_counter("/threadqueue{locality#0/total}/length");
+  // registering the same name again gives the same handle
+  if (register_counter("/threadqueue{locality#0/total}/length") != total) {
+    cout << "Test failed: different handles for the same counter." << endl;
+    return 1;
+  }
+  profiler* p = start("main");
+  pthread_t thread[2];
+  int tid = 0;
+  pthread_create(&(thread[0]), NULL, someThread, &tid);
+  int tid2 = 1;
+  pthread_create(&(thread[1]), NULL, someThread, &tid2);
+  pthread_join(thread[0], NULL);
+  pthread_join(thread[1], NULL);
+  stop(p);
+  finalize();
+  apex_profile * profile =
+    get_profile("/threadqueue{locality#0/total}/length");
+  if (profile) {
+    std::cout << "Value Reported : " << profile->calls << std::endl;
+    if (profile->calls <= 20) {  // might be less, some samples might have been missed
+        std::cout << "Test passed." << std::endl;
+    }
+  }
+  cleanup();
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include "apex_api.hpp"
+#include <thread>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+using namespace apex;
+using namespace std;
+
+volatile double sink;
+
+/* Keep the CPU busy for a while, without any timers */
+double busy(void) {
+  double x = 1.0;
+  for (long i = 0 ; i < 200000000 ; i++) { x = x * 1.0000001 + 1e-9; }
+  return x;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  /* The sampling period is set by the test environment, because APEX
+   * reads it at startup. */
+  init("apex_sampling_profiler unit test", 0, 1);
+  profiler * p = start("main busy loop");
+  sink = busy();
+  stop(p);
+  vector<thread> threads;
+  for (int i = 0 ; i < 2 ; i++) {
+    threads.push_back(thread([]() {
+      register_thread("sampled thread");
+      profiler * p = start("thread busy loop");
+      sink = busy();
+      stop(p);
+      exit_thread();
+    }));
+  }
+  for (auto& t : threads) { t.join(); }
+  finalize();
+  int failed = 0;
+#if defined(__linux__)
+  // the samples are attributed to the timers that were running
+  ifstream profile("./sample_profile.0.txt");
+  if (!profile.good()) {
+    cout << "Test failed: no profile written." << endl;
+    failed++;
+  }
+  bool main_loop = false;
+  bool thread_loop = false;
+  string line;
+  while (getline(profile, line)) {
+    if (line.rfind("main busy loop: ", 0) == 0) { main_loop = true; }
+    if (line.rfind("thread busy loop: ", 0) == 0) { thread_loop = true; }
+  }
+  if (!main_loop || !thread_loop) {
+    cout << "Test failed: busy loops not sampled." << endl;
+    failed++;
+  }
+#endif
+  if (failed == 0) {
+    cout << "Test passed." << endl;
+  }
+  cleanup();
+  return failed;
+}
@@ -0,0 +1,80 @@
+#include "apex_api.hpp"
+#include "address_resolution.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace apex;
+using namespace std;
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  /* The cache is enabled by the test environment, because APEX reads the
+   * option at startup. */
+  init("apex_symbol_cache unit test", 0, 1);
+  // the symbols of an object are only used while it hasn't changed
+  const string object("./apex_symbol_cache.object");
+  {
+    ofstream out(object);
+    out << "not really an object" << endl;
+  }
+  string filename(address_resolution::cache_filename());
+  std::remove(filename.c_str());
+  {
+    address_resolution * ar = address_resolution::instance();
+    write_lock_type l(address_resolution::_bfd_mutex);
+    ApexBfdInfo info;
+    info.lineno = 42;
+    info.filename = "apex_symbol_cache.cpp";
+    info.funcname = "foo";
+    info.demangled = strdup("foo(int)");
+    ar->add_cached(object, 0x1234, info);
+  }
+  address_resolution::save_symbol_cache();
+  // damaged lines are skipped, and the lines after them still read
+  {
+    ofstream out(filename, ios::app);
+    out << "zz12\t4\tbad.cpp\tbad\tbad()" << endl;
+    out << "ff\tabc\tbad.cpp\tbad\tbad()" << endl;
+    out << "fffffffffffffffffffffffff\t1\tbad.cpp\tbad\tbad()" << endl;
+    out << "ee\t1\tbad.cpp" << endl;
+    out << "beef\t7\tbar.cpp\tbar\tbar()" << endl;
+  }
+  // a new instance reads the file again (finalizing doesn't rewrite it)
+  finalize();
+  address_resolution::delete_instance();
+  int failed = 0;
+  {
+    address_resolution * ar = address_resolution::instance();
+    write_lock_type l(address_resolution::_bfd_mutex);
+    ApexBfdInfo info;
+    if (!ar->find_cached(object, 0x1234, info) || info.lineno != 42 ||
+        strcmp(info.filename, "apex_symbol_cache.cpp") != 0 ||
+        strcmp(info.funcname, "foo") != 0 ||
+        strcmp(info.demangled, "foo(int)") != 0) {
+      cout << "Test failed: cached symbol lost." << endl;
+      failed++;
+    }
+    ApexBfdInfo after;
+    if (!ar->find_cached(object, 0xbeef, after) || after.lineno != 7) {
+      cout << "Test failed: symbol after the damaged lines lost." << endl;
+      failed++;
+    }
+    ApexBfdInfo bad;
+    if (ar->find_cached(object, 0xff, bad) ||
+        ar->find_cached(object, 0xee, bad)) {
+      cout << "Test failed: read a damaged line." << endl;
+      failed++;
+    }
+  }
+  std::remove(filename.c_str());
+  std::remove(object.c_str());
+  if (failed == 0) {
+    cout << "Test passed." << endl;
+  }
+  cleanup();
+  return failed;
+}
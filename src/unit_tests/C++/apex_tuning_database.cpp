@@ -0,0 +1,140 @@
+#include "apex_api.hpp"
+#include "tuning_database.hpp"
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+
+using namespace apex;
+using namespace std;
+
+tuning_database::context make_context(const string& region, long size) {
+  tuning_database::context ctx;
+  ctx.region = region;
+  ctx.inputs.emplace_back("layout", "right");
+  ctx.inputs.emplace_back("size", to_string(size), (double)size);
+  return ctx;
+}
+
+map<string, string> make_outputs(long team_size) {
+  map<string, string> outputs;
+  outputs["team_size"] = to_string(team_size);
+  outputs["schedule"] = "dynamic\twith a tab";
+  return outputs;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  char filename[64];
+  snprintf(filename, 64, "./apex_tuning_database_%d.db", getpid());
+  std::remove(filename);
+  int failed = 0;
+  {
+    tuning_database db(filename, "test machine");
+    if (db.read()) {
+      cout << "Test failed: read a missing database." << endl;
+      failed++;
+    }
+    db.update(make_context("parallel_for", 1000), make_outputs(32), true);
+    db.update(make_context("parallel_for", 8000), make_outputs(64), false);
+    db.update(make_context("parallel_reduce", 1000), make_outputs(128), true);
+    if (!db.write()) {
+      cout << "Test failed: couldn't write the database." << endl;
+      failed++;
+    }
+  }
+  {
+    // the results survive the round trip
+    tuning_database db(filename, "test machine");
+    if (!db.read() || db.size() != 3) {
+      cout << "Test failed: wrong number of results read." << endl;
+      failed++;
+    }
+    auto r = db.find(make_context("parallel_for", 1000));
+    if (r == nullptr || !r->converged ||
+        r->outputs.at("team_size") != "32" ||
+        r->outputs.at("schedule") != "dynamic\twith a tab") {
+      cout << "Test failed: wrong result found." << endl;
+      failed++;
+    }
+    if (db.find(make_context("parallel_for", 2000)) != nullptr) {
+      cout << "Test failed: found a context that wasn't tuned." << endl;
+      failed++;
+    }
+    // the nearest context prefers converged results
+    r = db.nearest(make_context("parallel_for", 7000));
+    if (r == nullptr || r->outputs.at("team_size") != "32") {
+      cout << "Test failed: nearest result isn't the converged one." << endl;
+      failed++;
+    }
+    if (db.nearest(make_context("parallel_scan", 1000)) != nullptr) {
+      cout << "Test failed: nearest result is of another region." << endl;
+      failed++;
+    }
+    // another machine doesn't see our results
+    tuning_database other(filename, "other machine");
+    other.read();
+    if (other.find(make_context("parallel_for", 1000)) != nullptr) {
+      cout << "Test failed: found a result of another machine." << endl;
+      failed++;
+    }
+    // a result that hasn't converged doesn't replace one that has
+    db.update(make_context("parallel_for", 1000), make_outputs(16), false);
+    r = db.find(make_context("parallel_for", 1000));
+    if (r->outputs.at("team_size") != "32") {
+      cout << "Test failed: replaced a converged result." << endl;
+      failed++;
+    }
+  }
+  {
+    // concurrent writers don't lose each other's results
+    vector<thread> writers;
+    for (long i = 0 ; i < 8 ; i++) {
+      writers.push_back(thread([&filename, i]() {
+        tuning_database db(filename, "test machine");
+        db.read();
+        db.update(make_context("writer", i), make_outputs(i), true);
+        db.write();
+      }));
+    }
+    for (auto& w : writers) { w.join(); }
+    tuning_database db(filename, "test machine");
+    db.read();
+    if (db.size() != 11) {
+      cout << "Test failed: lost the results of concurrent writers." << endl;
+      failed++;
+    }
+  }
+  {
+    // another file (like the YAML cache of older versions) is left alone
+    const char * yaml = "Input_Variables:\n  - id: 1\n";
+    {
+      ofstream out(filename, ios::trunc);
+      out << yaml;
+    }
+    tuning_database db(filename, "test machine");
+    db.update(make_context("parallel_for", 1000), make_outputs(32), true);
+    if (db.read() || db.write()) {
+      cout << "Test failed: used a file that isn't a database." << endl;
+      failed++;
+    }
+    ifstream in(filename);
+    stringstream contents;
+    contents << in.rdbuf();
+    if (contents.str() != yaml) {
+      cout << "Test failed: replaced a file that isn't a database." << endl;
+      failed++;
+    }
+  }
+  std::remove(filename);
+  std::remove((string(filename) + ".lock").c_str());
+  if (failed == 0) {
+    cout << "Test passed." << endl;
+  }
+  return failed;
+}
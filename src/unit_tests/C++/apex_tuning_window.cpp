@@ -0,0 +1,75 @@
+#include "apex_api.hpp"
+#include "tuning_window.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+using namespace apex;
+using namespace std;
+
+/* A profile of n samples with the given mean and standard deviation */
+apex_profile make_profile(double n, double mean, double sd) {
+  apex_profile p;
+  memset(&p, 0, sizeof(apex_profile));
+  p.calls = n;
+  p.accumulated = n * mean;
+  p.sum_squares = ((n - 1.0) * sd * sd) + (n * mean * mean);
+  p.minimum = mean - sd;
+  return p;
+}
+
+int main (int argc, char** argv) {
+  APEX_UNUSED(argc);
+  APEX_UNUSED(argv);
+  // the critical values of the t distribution, from the tables
+  if (fabs(tuning_window::z_quantile(0.975) - 1.959964) > 1e-6 ||
+      fabs(tuning_window::t_quantile(0.95, 1e6) - 1.959964) > 1e-4 ||
+      fabs(tuning_window::t_quantile(0.95, 10.0) - 2.228) > 0.01 ||
+      fabs(tuning_window::t_quantile(0.99, 30.0) - 2.750) > 0.01) {
+    cout << "Test failed: wrong t quantile." << endl;
+    return 1;
+  }
+  // without a confidence level, every candidate gets the minimum samples
+  tuning_window fixed(5, 50, 0.0);
+  if (fixed.adaptive() || fixed.ready(make_profile(4, 100.0, 50.0)) ||
+      !fixed.ready(make_profile(5, 100.0, 50.0))) {
+    cout << "Test failed: fixed window." << endl;
+    return 1;
+  }
+  tuning_window window(5, 50, 0.95);
+  // the baseline is measured until its mean is precise
+  if (window.ready(make_profile(3, 100.0, 1.0)) ||
+      window.ready(make_profile(5, 100.0, 10.0)) ||
+      !window.ready(make_profile(5, 100.0, 1.0))) {
+    cout << "Test failed: baseline window." << endl;
+    return 1;
+  }
+  window.evaluated(make_profile(20, 100.0, 1.0));
+  // significantly better or worse candidates are decided quickly
+  if (!window.ready(make_profile(5, 80.0, 1.0)) ||
+      !window.ready(make_profile(5, 120.0, 1.0))) {
+    cout << "Test failed: better or worse candidate." << endl;
+    return 1;
+  }
+  // a candidate within the tolerance of the best is equivalent
+  if (!window.ready(make_profile(30, 100.1, 1.0))) {
+    cout << "Test failed: equivalent candidate." << endl;
+    return 1;
+  }
+  // a noisy candidate is sampled until the maximum window
+  if (window.ready(make_profile(5, 101.0, 10.0)) ||
+      window.ready(make_profile(49, 101.0, 30.0)) ||
+      !window.ready(make_profile(50, 101.0, 30.0))) {
+    cout << "Test failed: maximum window." << endl;
+    return 1;
+  }
+  // a better candidate becomes the one to beat
+  window.evaluated(make_profile(5, 80.0, 1.0));
+  if (!window.ready(make_profile(5, 100.0, 1.0)) ||
+      window.ready(make_profile(5, 81.0, 10.0))) {
+    cout << "Test failed: new best candidate." << endl;
+    return 1;
+  }
+  cout << "Test passed." << endl;
+  return 0;
+}
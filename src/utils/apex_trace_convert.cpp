@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2014-2021 Kevin Huck
+ * Copyright (c) 2014-2021 University of Oregon
+ *
+ * Distributed under the Boost Software License, Version 1.0. (See accompanying
+ * file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+ */
+
+/* Converts the binary event log written with APEX_TRACE_EVENT_BINARY=1
+ * (trace_events.<rank>.bin) to the Chrome/Perfetto JSON trace format. */
+
+#include "trace_event_binary.hpp"
+#ifdef APEX_HAVE_ZLIB
+#include "gzstream.hpp"
+#endif
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace apex;
+using namespace std;
+
+/* Read the next record.  Returns false at the end of the file, or if the
+ * file is truncated. */
+static bool read_record(istream& in, binary_trace::event& e,
+    uint32_t& string_id, string& str) {
+    int k = in.peek();
+    if (k == EOF) {
+        return false;
+    }
+    if (k == binary_trace::string_def) {
+        binary_trace::string_header h;
+        if (!in.read(reinterpret_cast<char*>(&h), sizeof(h))) {
+            return false;
+        }
+        str.resize(h.length);
+        if (h.length > 0 && !in.read(&str[0], h.length)) {
+            return false;
+        }
+        e.kind = binary_trace::string_def;
+        string_id = h.id;
+        return true;
+    }
+    if (k < binary_trace::string_def || k > binary_trace::flow_end) {
+        cerr << "Unknown record type " << k << ", the trace is corrupt."
+             << endl;
+        return false;
+    }
+    return (bool)in.read(reinterpret_cast<char*>(&e), sizeof(e));
+}
+
+static bool ends_with(const string& s, const string& suffix) {
+    return s.size() > suffix.size() &&
+        s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool open_trace(unique_ptr<istream>& stream, const string& filename,
+    binary_trace::file_header& header) {
+#ifdef APEX_HAVE_ZLIB
+    if (ends_with(filename, ".gz")) {
+        stream.reset(new io::gzifstream(filename));
+    } else
+#endif
+    {
+        stream.reset(new ifstream(filename, ios::in | ios::binary));
+    }
+    istream& in = *stream;
+    if (!in.good()) {
+        cerr << "Unable to open " << filename << endl;
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, binary_trace::magic, sizeof(header.magic)) != 0) {
+        cerr << filename << " is not an APEX binary trace." << endl;
+        return false;
+    }
+    if (header.version != binary_trace::version) {
+        cerr << filename << " has version " << header.version
+             << ", expected " << binary_trace::version << endl;
+        return false;
+    }
+    return true;
+}
+
+/* The strings are escaped here, instead of at run time. */
+static void write_escaped(ostream& out, const vector<string>& strings,
+    uint32_t id) {
+    if (id < strings.size()) {
+        for (char c : strings[id]) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if ((unsigned char)c < 0x20) {
+                out << "\\u" << hex << setw(4) << setfill('0') << (int)c
+                    << dec << setfill(' ');
+            } else {
+                out << c;
+            }
+        }
+    }
+}
+
+static void write_string(ostream& out, const vector<string>& strings,
+    uint32_t id) {
+    out << '"';
+    write_escaped(out, strings, id);
+    out << '"';
+}
+
+static void write_flow(ostream& out, const binary_trace::event& e,
+    const vector<string>& strings, uint32_t pid, char ph) {
+    out << "{\"ts\":" << e.ts << ",\"ph\":\"" << ph << "\",\"cat\":";
+    write_string(out, strings, e.cat);
+    out << ",\"id\":" << e.id << ",\"pid\":" << pid << ",\"tid\":" << e.tid
+        << ",\"name\":\"";
+    // "parent -> child", without the enclosing quotes
+    write_escaped(out, strings, e.name);
+    out << " -> ";
+    write_escaped(out, strings, e.name2);
+    out << "\"},\n";
+}
+
+static void write_event(ostream& out, const binary_trace::event& e,
+    const vector<string>& strings, uint32_t pid) {
+    switch (e.kind) {
+        case binary_trace::trace_begin:
+            out << "{\"name\":\"APEX Trace Begin\",\"ph\":\"R\",\"pid\":"
+                << pid << ",\"tid\":0,\"ts\":" << e.ts << "},\n";
+            out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"args\":{\"name\":\"Process " << pid << "\"}},\n";
+            out << "{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":"
+                << pid << ",\"args\":{\"sort_index\":\"" << setw(8)
+                << setfill('0') << pid << setfill(' ') << "\"}},\n";
+            break;
+        case binary_trace::thread_name:
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << e.tid << ",\"args\":{\"name\":";
+            write_string(out, strings, e.name);
+            out << "}},\n";
+            break;
+        case binary_trace::thread_sort_index:
+            out << "{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":"
+                << pid << ",\"tid\":" << e.tid << ",\"args\":{\"sort_index\":"
+                << e.id << "}},\n";
+            break;
+        case binary_trace::begin:
+        case binary_trace::end:
+        case binary_trace::complete:
+            out << "{\"name\":";
+            write_string(out, strings, e.name);
+            out << ",\"cat\":";
+            write_string(out, strings, e.cat);
+            out << ",\"ph\":\"" << (e.kind == binary_trace::begin ? 'B' :
+                (e.kind == binary_trace::end ? 'E' : 'X'))
+                << "\",\"pid\":" << pid << ",\"tid\":" << e.tid
+                << ",\"ts\":" << e.ts;
+            if (e.kind == binary_trace::complete) {
+                out << ",\"dur\":" << e.value;
+            }
+            if (e.kind != binary_trace::end) {
+                out << ",\"args\":{\"GUID\":" << e.id << ",\"Parent GUID\":"
+                    << e.id2 << "}";
+            }
+            out << "},\n";
+            break;
+        case binary_trace::counter:
+            out << "{\"name\":";
+            write_string(out, strings, e.name);
+            out << ",\"cat\":";
+            write_string(out, strings, e.cat);
+            out << ",\"ph\":\"C\",\"pid\":" << pid << ",\"ts\":" << e.ts
+                << ",\"args\":{\"value\":" << e.value << "}},\n";
+            break;
+        case binary_trace::flow_start:
+            write_flow(out, e, strings, pid, 's');
+            break;
+        case binary_trace::flow_step:
+            write_flow(out, e, strings, pid, 't');
+            break;
+        case binary_trace::flow_end:
+            write_flow(out, e, strings, pid, 'f');
+            break;
+        default:
+            break;
+    }
+}
+
+static string default_output_name(const string& input) {
+    string base(input);
+    if (ends_with(base, ".gz")) {
+        base = base.substr(0, base.size() - 3);
+    }
+    if (ends_with(base, ".bin")) {
+        base = base.substr(0, base.size() - 4);
+    }
+#ifdef APEX_HAVE_ZLIB
+    return base + ".json.gz";
+#else
+    return base + ".json";
+#endif
+}
+
+int main (int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: " << argv[0]
+             << " trace_events.<rank>.bin[.gz] [output]" << endl;
+        cerr << "  The output is compressed if the name ends in .gz"
+             << endl;
+        return 1;
+    }
+    string output_name(argc == 3 ? argv[2] : default_output_name(argv[1]));
+    binary_trace::file_header header;
+    binary_trace::event e;
+    uint32_t id;
+    string str;
+    /* The first pass collects the strings, because a thread can use a
+     * string that was defined in another thread's (later) buffer. */
+    vector<string> strings;
+    {
+        unique_ptr<istream> in;
+        if (!open_trace(in, argv[1], header)) { return 1; }
+        while (read_record(*in, e, id, str)) {
+            if (e.kind == binary_trace::string_def) {
+                if (id >= strings.size()) { strings.resize(id + 1); }
+                strings[id] = str;
+            }
+        }
+    }
+    unique_ptr<istream> in;
+    if (!open_trace(in, argv[1], header)) { return 1; }
+    unique_ptr<ostream> out;
+#ifdef APEX_HAVE_ZLIB
+    if (ends_with(output_name, ".gz")) {
+        out.reset(new io::gzofstream(output_name));
+    } else
+#endif
+    {
+        out.reset(new ofstream(output_name));
+    }
+    if (!out->good()) {
+        cerr << "Unable to open " << output_name << endl;
+        return 1;
+    }
+    *out << fixed << setprecision(3) << "{\n\"traceEvents\": [\n";
+    /* The end marker closes the array, so it is always written last.  If
+     * the trace was cut short, use the last timestamp we saw. */
+    double end_ts = 0.0;
+    bool have_end = false;
+    size_t count = 0;
+    while (read_record(*in, e, id, str)) {
+        if (e.kind == binary_trace::string_def) { continue; }
+        if (e.kind == binary_trace::trace_end) {
+            end_ts = e.ts;
+            have_end = true;
+            continue;
+        }
+        if (!have_end && e.ts > end_ts) { end_ts = e.ts; }
+        write_event(*out, e, strings, header.node_id);
+        count++;
+    }
+    *out << "{\"name\":\"APEX Trace End\", \"ph\":\"R\",\"pid\":"
+         << header.node_id << ",\"tid\":0,\"ts\":" << end_ts << "}\n";
+    *out << "]\n}\n" << flush;
+    cout << "Wrote " << count << " events to " << output_name << endl;
+    return 0;
+}
+